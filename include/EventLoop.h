@@ -0,0 +1,104 @@
+#ifndef EVENT_LOOP_H
+#define EVENT_LOOP_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <functional>
+#include <unordered_set>
+#include <netinet/in.h>
+#include "HttpParser.h"
+
+// Non-blocking epoll reactor served by a fixed pool of worker threads.
+//
+// All workers wait on one shared epoll instance. Every client socket is
+// registered with EPOLLONESHOT, so at most one worker owns a connection at a
+// time and no per-connection locking is needed. Idle connections cost one
+// Connection object and one epoll registration - never a thread.
+//
+// Connections are persistent (HTTP/1.1 keep-alive): pipelined requests are
+// answered in order on the same socket, and a periodic sweep closes sockets
+// that stay idle longer than idleTimeoutSeconds.
+class EventLoop {
+public:
+    // Handler output is a complete response without a Connection header;
+    // the loop adds Connection/Keep-Alive itself. The request's views point
+    // into the connection buffer and die when the handler returns; the
+    // returned view only has to stay valid until the next call on the same
+    // thread.
+    using RequestHandler = std::function<std::string_view(const HttpRequest& request)>;
+    using AcceptHandler = std::function<void(const sockaddr_in& clientAddr)>;
+
+    struct Config {
+        int workerThreads;              // <= 0 uses one thread per core
+        int idleTimeoutSeconds;         // Close keep-alive sockets idle this long
+        int maxRequestsPerConnection;   // 0 = unlimited
+
+        Config() : workerThreads(0), idleTimeoutSeconds(15), maxRequestsPerConnection(1000) {}
+    };
+
+    EventLoop(int listenSocket, const Config& config,
+              RequestHandler onRequest, AcceptHandler onAccept);
+    ~EventLoop();
+
+    bool start();
+    void stop();
+
+    int getWorkerCount() const { return config.workerThreads; }
+
+private:
+    enum FlushResult { FLUSH_DONE, FLUSH_BLOCKED, FLUSH_FAILED };
+
+    struct Connection {
+        int fd;
+        std::vector<char> in;   // Receive buffer; bytes [inStart, inEnd) are unparsed
+        size_t inStart;
+        size_t inEnd;
+        HttpParser parser;      // State of the request starting at inStart
+        std::string out;        // Response bytes waiting to be sent
+        size_t outOffset;
+        int requestsServed;
+        bool closeAfterWrite;   // Last response said "Connection: close"
+        bool peerClosed;        // Client half-closed its side
+        bool writeFailed;       // A direct write hit a socket error
+        std::atomic<long long> lastActiveMs;
+
+        explicit Connection(int socketFd)
+            : fd(socketFd), inStart(0), inEnd(0), outOffset(0), requestsServed(0),
+              closeAfterWrite(false), peerClosed(false), writeFailed(false), lastActiveMs(0) {}
+    };
+
+    int listenSocket;
+    int epollFd;
+    int wakeFd;                 // eventfd used to wake workers on stop()
+    int timerFd;                // Periodic idle-connection sweep
+    Config config;
+    std::atomic<bool> running;
+    std::vector<std::thread> workers;
+
+    RequestHandler onRequest;
+    AcceptHandler onAccept;
+
+    // Live connections, only touched on accept/close and by the idle sweep
+    std::unordered_set<Connection*> connections;
+    std::mutex connectionsMutex;
+
+    void workerLoop();
+    void acceptConnections();
+    void sweepIdleConnections();
+    void handleReadable(Connection* conn);
+    void serviceConnection(Connection* conn);
+    bool processRequests(Connection* conn);
+    void queueResponse(Connection* conn, std::string_view response, bool keepAlive);
+    size_t connectionHeader(Connection* conn, bool keepAlive, char* buffer, size_t size);
+    void queueError(Connection* conn, int status);
+    FlushResult flushOutput(Connection* conn);
+    void rearm(Connection* conn, unsigned int events);
+    void closeConnection(Connection* conn);
+    static long long nowMs();
+};
+
+#endif // EVENT_LOOP_H
@@ -2,77 +2,105 @@
 #define FLIGHT_SERVER_H
 
 #include <string>
+#include <string_view>
 #include <vector>
 #include <unordered_map>
 #include <thread>
 #include <mutex>
+#include <shared_mutex>
+#include <atomic>
+#include <memory>
+#include "EventLoop.h"
+#include "JsonWriter.h"
+#include "Router.h"
+#include "SeatInventory.h"
+#include "Btree.h"
+#include "Hashmap.h"
+#include "Flight_graph.h"
 
 // Forward declarations
 struct Flight;
 struct Passenger;
-struct Route;
 
 class FlightServer {
 private:
     int serverPort;
     int serverSocket;
-    bool isRunning;
+    EventLoop::Config loopConfig;
+    std::atomic<bool> isRunning;
+    std::unique_ptr<EventLoop> eventLoop;
+    Router router;              // Built once in the constructor, read-only after
     
     // Data structures
-    std::vector<Flight> flights;
-    std::unordered_map<std::string, Passenger> passengers;  // HashMap simulation
-    std::vector<Route> routes;
-    std::mutex dataMutex;
+    HashMap<std::string, Flight> flights;       // Flight number -> flight
+    BTree<int, std::string> departures;            // Departure minute -> flight number, for time windows; latches its own nodes
+    HashMap<std::string, Passenger> passengers; // PNR -> passenger
+    std::shared_mutex passengersMutex;  // Guards the map; seat/check-in fields follow the flight's seat lock
+    FlightGraph routeGraph;         // Built once in the constructor, read-only after
+    std::shared_mutex dataMutex;    // Shared by read-only endpoints, exclusive for writes
+    
+    // Per-flight seats. Entries are added/removed only under an exclusive
+    // dataMutex and live behind unique_ptr, so they never move under readers.
+    // Lock order: dataMutex, passengersMutex, then a flight's seat lock.
+    std::unordered_map<std::string, std::unique_ptr<SeatInventory>> seatInventories;
     
     // Server stats
     struct ServerStats {
-        int connectionsHandled;
-        int requestsProcessed;
+        std::atomic<int> connectionsHandled;
+        std::atomic<int> requestsProcessed;
         std::string startTime;
     } stats;
     
     // Helper methods
-    std::string extractRequestBody(const std::string& request);
     long long timeToUnix(const std::string& timeStr);
-    std::string createJSONResponse(int status, const std::string& message, const std::string& data);
-    std::string createJSONResponse(int status, const std::string& jsonData);
-    std::string flightToJSON(const Flight& flight);
+    std::string_view createJSONResponse(int status, const char* message, JsonWriter& json);
+    std::string_view createJSONResponse(int status, const char* message, std::string_view data);
+    void writeFlight(JsonWriter& json, const Flight& flight, bool detailed);
+    bool indexDeparture(Flight& flight, int minutes);
     std::string passengerToJSON(const Passenger& passenger);
     
-    // Request handlers
-    std::string handleRequest(const std::string& request);
-    void handleClient(int clientSocket);
+    // Request handlers. Responses are views into the calling thread's
+    // JsonWriter buffer and stay valid until that thread builds the next one.
+    std::string_view handleRequest(const HttpRequest& request);
+    void setupRoutes();
     
     // API endpoints
-    std::string handleHealth();
-    std::string handleGetFlights();
-    std::string handleSearchFlight(const std::string& flightNumber);
-    std::string handleGetFlightsByTime(const std::string& start, const std::string& end);
-    std::string handleAddFlight(const std::string& request);
-    std::string handleUpdateFlight(const std::string& flightNumber, const std::string& request);
-    std::string handleDeleteFlight(const std::string& flightNumber);
-    std::string handleGetPassenger(const std::string& pnr);
-    std::string handleGetBooking(const std::string& pnr);
-    std::string handleGetAllPassengers();
-    std::string handleGetAllBookings();
-    std::string handleCancelBooking(const std::string& pnr);
-    std::string handleCheckIn(const std::string& pnr, const std::string& request);
-    std::string handleCreateBooking(const std::string& request);
-    std::string handleAssignGate(const std::string& request);
-    std::string handleGetGates();
-    std::string handleGetAvailableGates(int min, int max);
-    std::string handleGetShortestRoute(const std::string& from, const std::string& to);
-    std::string handleGetSeatMap(const std::string& flightNumber);
-    std::string handleGetStats();
+    std::string_view handleHealth();
+    std::string_view handleGetFlights();
+    std::string_view handleSearchFlight(const std::string& flightNumber);
+    std::string_view handleGetFlightsByTime(const std::string& start, const std::string& end, int limit);
+    std::string_view handleAddFlight(std::string_view body);
+    std::string_view handleUpdateFlight(const std::string& flightNumber, std::string_view body);
+    std::string_view handleDeleteFlight(const std::string& flightNumber);
+    std::string_view handleGetPassenger(const std::string& pnr);
+    std::string_view handleGetBooking(const std::string& pnr);
+    std::string_view handleGetAllPassengers();
+    std::string_view handleGetAllBookings();
+    std::string_view handleCancelBooking(const std::string& pnr);
+    std::string_view handleCheckIn(const std::string& pnr, std::string_view body);
+    std::string_view handleCreateBooking(std::string_view body);
+    std::string_view handleAssignGate(std::string_view body);
+    std::string_view handleGetGates();
+    std::string_view handleGetAvailableGates(int min, int max);
+    enum RouteCriterion { SHORTEST_ROUTE, CHEAPEST_ROUTE, FASTEST_ROUTE };
+    std::string_view handleFindRoute(const std::string& from, const std::string& to, RouteCriterion criterion);
+    std::string_view handleGetSeatMap(const std::string& flightNumber);
+    std::string_view handleGetStats();
     int countCheckedInPassengers() const;
+    SeatInventory* findInventory(const std::string& flightId) const;
+    void readSeatState(const Passenger& passenger, std::string& seat, bool& checkedIn) const;
     
 public:
-    FlightServer(int port = 8080);
+    // workers <= 0 sizes the event loop pool to the number of cores
+    FlightServer(int port = 8080, int workers = 0);
     ~FlightServer();
     
     bool start();
     void stop();
     void printStats() const;
+    
+    // Keep-alive tuning; takes effect on the next start()
+    void setKeepAlive(int idleTimeoutSeconds, int maxRequestsPerConnection);
     void initializeData();
 };
 
@@ -0,0 +1,86 @@
+#ifndef HTTP_PARSER_H
+#define HTTP_PARSER_H
+
+#include <string_view>
+#include <cstddef>
+#include <cstdint>
+
+// A parsed HTTP request. Every field is a view into the connection's receive
+// buffer, so it is only valid until the handler returns.
+struct HttpRequest {
+    static const int MAX_HEADERS = 32;
+
+    std::string_view method;
+    std::string_view target;    // Path plus query string, as sent
+    std::string_view path;
+    std::string_view query;     // Without the leading '?'
+    std::string_view version;
+    std::string_view body;      // De-chunked when Transfer-Encoding: chunked
+    bool keepAlive;
+
+    std::string_view headerNames[MAX_HEADERS];
+    std::string_view headerValues[MAX_HEADERS];
+    int headerCount;
+
+    HttpRequest() : keepAlive(false), headerCount(0) {}
+
+    // Case-insensitive header lookup; empty view when absent
+    std::string_view header(std::string_view name) const;
+};
+
+// Incremental HTTP/1.x request parser.
+//
+// The parser is fed the same growing byte range on every read and resumes
+// where it stopped, so a request that arrives in many TCP segments is scanned
+// once. Nothing is copied out of the buffer: Content-Length bodies are plain
+// slices, and chunked bodies are compacted in place so the decoded body is
+// one contiguous slice as well. Positions are kept relative to the start of
+// the request, so the caller may move unconsumed bytes between calls.
+class HttpParser {
+public:
+    enum Status { NEED_MORE, COMPLETE, FAILED };
+
+    static const size_t MAX_HEADER_BYTES = 64 * 1024;
+    static const size_t MAX_BODY_BYTES = 32 * 1024 * 1024;
+
+    HttpParser();
+
+    // data points at the first byte of the current request. On COMPLETE the
+    // request is filled in and consumedBytes() says how much to drop; call
+    // reset() before parsing the next request.
+    Status parse(char* data, size_t length, HttpRequest& request);
+
+    size_t consumedBytes() const { return consumed; }
+    int errorStatus() const { return error; }     // 400, 413, 431 or 501
+    void reset();
+
+private:
+    enum State { HEADERS, BODY, CHUNK_SIZE, CHUNK_DATA, CHUNK_DATA_END, TRAILERS };
+
+    struct Span {
+        uint32_t offset;
+        uint32_t length;
+    };
+
+    State state;
+    size_t scanned;         // Bytes already searched for the header terminator
+    size_t headerLength;    // Request line + headers + blank line
+    size_t bodyLength;      // Content-Length, or decoded chunk bytes so far
+    size_t cursor;          // Read position inside the chunked framing
+    size_t chunkRemaining;
+    size_t consumed;
+    int error;
+    bool keepAlive;
+
+    Span method, target, version;
+    Span headerNames[HttpRequest::MAX_HEADERS];
+    Span headerValues[HttpRequest::MAX_HEADERS];
+    int headerCount;
+
+    Status fail(int status);
+    bool parseHeaders(const char* data);
+    Status parseChunks(char* data, size_t length);
+    void fillRequest(const char* data, HttpRequest& request) const;
+};
+
+#endif // HTTP_PARSER_H
@@ -0,0 +1,64 @@
+#ifndef JSON_READER_H
+#define JSON_READER_H
+
+#include <string_view>
+#include <cstddef>
+#include <cstdint>
+
+// Single-pass JSON tokenizer for request bodies.
+//
+// parse() walks the body once and records a flat token per value (objects
+// and arrays are followed by their children, object members alternate key
+// and value). Every token knows where its subtree ends, so lookups skip
+// whole nested values without rescanning. String tokens are views straight
+// into the body; only strings that contain escapes are decoded, into a
+// scratch buffer sized up front so earlier views never move.
+//
+// Token and scratch storage is thread-local and reused, so only one reader
+// may be live per thread, and its views are valid until the next parse() on
+// the same thread (and, for undecoded strings, as long as the body).
+class JsonReader {
+public:
+    enum Type { NONE, OBJECT, ARRAY, STRING, NUMBER, TRUE_VALUE, FALSE_VALUE, NULL_VALUE };
+
+    static const size_t npos = static_cast<size_t>(-1);
+    static const int MAX_DEPTH = 64;
+
+    JsonReader();
+
+    // An empty or all-whitespace body parses as an empty object
+    bool parse(std::string_view json);
+
+    size_t root() const { return 0; }
+    Type type(size_t index) const;
+
+    // Decoded string contents, or the literal text of a number/true/false.
+    // Empty for containers, null and npos.
+    std::string_view text(size_t index) const;
+
+    // Value of a member of the object at index, or npos
+    size_t find(size_t object, std::string_view name) const;
+    std::string_view text(size_t object, std::string_view name) const {
+        return text(find(object, name));
+    }
+
+    // Child iteration for arrays (values) and objects (keys; the value is
+    // key + 1). Both return npos when there are no more children.
+    size_t firstChild(size_t container) const;
+    size_t nextSibling(size_t container, size_t child) const;
+
+private:
+    const char* pos;
+    const char* end;
+    bool failed;
+
+    size_t addToken(Type type, const char* start, size_t length);
+    bool parseValue(int depth);
+    bool parseString();
+    bool parseNumber();
+    bool parseLiteral(const char* word, size_t length, Type type);
+    void skipWhitespace();
+    size_t next(size_t index) const;
+};
+
+#endif // JSON_READER_H
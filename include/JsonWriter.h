@@ -0,0 +1,75 @@
+#ifndef JSON_WRITER_H
+#define JSON_WRITER_H
+
+#include <string_view>
+#include <cstddef>
+#include <cstdint>
+
+// Append-only JSON writer for HTTP responses.
+//
+// All writers on a thread share one growable thread-local buffer, so after
+// warm-up building a response performs no heap allocation. Numbers go through
+// std::to_chars and strings are escaped as they are copied in. The buffer
+// starts with a reserved gap; finish() renders the status line and headers
+// into that gap directly in front of the body, so the whole response is one
+// contiguous range that can be handed to writev without copying.
+//
+// Only one writer may be live per thread, and the view returned by finish()
+// is valid until the next JsonWriter is constructed on the same thread.
+class JsonWriter {
+public:
+    JsonWriter();
+
+    JsonWriter& beginObject();
+    JsonWriter& endObject();
+    JsonWriter& beginArray();
+    JsonWriter& endArray();
+
+    JsonWriter& key(std::string_view name);
+
+    JsonWriter& value(std::string_view text);
+    JsonWriter& value(const char* text) { return value(std::string_view(text)); }
+    JsonWriter& value(std::string_view first, std::string_view second);  // Concatenated
+    JsonWriter& value(char ch) { return value(std::string_view(&ch, 1)); }
+    JsonWriter& value(bool flag);
+    JsonWriter& value(int number) { return value(static_cast<long long>(number)); }
+    JsonWriter& value(long number) { return value(static_cast<long long>(number)); }
+    JsonWriter& value(long long number);
+    JsonWriter& value(unsigned long number);
+    JsonWriter& value(double number);      // null if not finite
+    JsonWriter& null();
+
+    // Pre-serialized JSON, inserted verbatim
+    JsonWriter& raw(std::string_view json);
+
+    template <typename T>
+    JsonWriter& field(std::string_view name, const T& v) { return key(name).value(v); }
+    JsonWriter& field(std::string_view name, std::string_view first, std::string_view second) {
+        return key(name).value(first, second);
+    }
+
+    std::string_view body() const;
+
+    // Prepend "HTTP/1.1 <status> <reason>", the given header lines (each
+    // ending in CRLF), Content-Length and the blank line. Returns the full
+    // response.
+    std::string_view finish(int status, std::string_view reason, std::string_view headerLines);
+
+private:
+    static const size_t HEADER_RESERVE = 512;
+
+    char* data;
+    size_t length;
+    uint64_t commaBits;     // Bit d set: the container at depth d needs a comma
+    int depth;
+    bool afterKey;
+
+    void reserve(size_t extra);
+    void append(const char* text, size_t count);
+    void append(std::string_view text) { append(text.data(), text.size()); }
+    void appendChar(char ch);
+    void appendEscaped(std::string_view text);
+    void beforeValue();
+};
+
+#endif // JSON_WRITER_H
@@ -0,0 +1,71 @@
+#ifndef ROUTER_H
+#define ROUTER_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <functional>
+#include "HttpParser.h"
+
+// Path and query parameters of a routed request. All views point into the
+// request, so they die with it.
+struct RouteMatch {
+    static const int MAX_PARAMS = 8;
+    static const int MAX_QUERY = 16;
+
+    std::string_view params[MAX_PARAMS];    // ":name" segments, in pattern order
+    int paramCount;
+
+    std::string_view queryNames[MAX_QUERY];
+    std::string_view queryValues[MAX_QUERY];
+    int queryCount;
+
+    RouteMatch() : paramCount(0), queryCount(0) {}
+
+    std::string_view param(int index) const {
+        return index < paramCount ? params[index] : std::string_view();
+    }
+    // First value for name (raw, not percent-decoded), or fallback
+    std::string_view query(std::string_view name, std::string_view fallback = std::string_view()) const;
+};
+
+// Segment trie built once at startup.
+//
+// Patterns are split on '/' into literal segments and ":name" parameters.
+// Matching walks the request path once, doing a binary search among the
+// literal children of each node, so the cost depends on the number of
+// segments in the path rather than on how many routes are registered.
+// Empty segments are ignored, which makes trailing slashes optional.
+class Router {
+public:
+    using Handler = std::function<std::string_view(const HttpRequest& request, const RouteMatch& match)>;
+
+    Router();
+    ~Router();
+
+    // method is "GET", "POST", ... or "*" for any method
+    void add(std::string_view method, std::string_view pattern, Handler handler);
+
+    // Returns the handler for the request, or nullptr when no route matches
+    // its path and method. On success match holds path and query parameters.
+    const Handler* match(const HttpRequest& request, RouteMatch& match) const;
+
+private:
+    enum Method { METHOD_GET, METHOD_POST, METHOD_PUT, METHOD_DELETE, METHOD_PATCH, METHOD_HEAD,
+                  METHOD_OTHER, METHOD_COUNT };
+
+    struct Node {
+        std::vector<std::pair<std::string, std::unique_ptr<Node>>> literals;    // Sorted by segment
+        std::unique_ptr<Node> param;
+        Handler handlers[METHOD_COUNT];
+        Handler anyMethod;
+    };
+
+    std::unique_ptr<Node> rootNode;
+
+    static Method methodIndex(std::string_view method);
+    static void parseQuery(std::string_view query, RouteMatch& match);
+};
+
+#endif // ROUTER_H
@@ -0,0 +1,47 @@
+#ifndef SEAT_INVENTORY_H
+#define SEAT_INVENTORY_H
+
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <atomic>
+#include <mutex>
+#include <cstdint>
+
+// Seats of one flight.
+//
+// Occupancy is a bitmap of atomic words, so claiming, releasing and reading
+// seats never blocks: a claim is a single compare-and-swap on the word that
+// holds the seat. The PNR -> seat bookkeeping (and the seat/check-in fields
+// of the flight's passengers) is guarded by the inventory's own mutex, so
+// traffic on one flight never waits for another.
+class SeatInventory {
+public:
+    static const int SEAT_COUNT = 180;
+    static const int SEATS_PER_ROW = 6;
+
+    SeatInventory();
+
+    bool isTaken(int seat) const;
+    bool claim(int seat);       // False when already taken
+    int claimFirstFree();       // Seat index, or -1 when the flight is full
+    void release(int seat);
+    int availableSeats() const;
+
+    // "12A" <-> seat index; parseSeat returns -1 for anything invalid
+    static int parseSeat(std::string_view label);
+    static std::string seatLabel(int seat);
+
+    std::mutex& mutex() const { return assignmentMutex; }
+    std::unordered_map<std::string, int> assignments;   // PNR -> seat, guarded by mutex()
+
+private:
+    static const int WORD_COUNT = (SEAT_COUNT + 63) / 64;
+
+    std::atomic<uint64_t> words[WORD_COUNT];
+    mutable std::mutex assignmentMutex;
+
+    static uint64_t validBits(int word);
+};
+
+#endif // SEAT_INVENTORY_H
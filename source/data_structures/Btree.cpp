@@ -1,549 +1,361 @@
 #include "Btree.h"
 #include "constants.h"
 #include <iostream>
-#include <iomanip>
 #include <algorithm>
-#include <queue>
+#include <chrono>
 
 using namespace std;
 
-BTree::BTree(const string& filename) 
+BTreeBase::BTreeBase(const string& filename, size_t cache_bytes, size_t node_bytes,
+                     BufferPool::NodeLoader load_node)
     : storage_(new StorageManager(filename)), 
+      pool_(new BufferPool(load_node, cache_bytes, node_bytes)),
       filename_(filename), 
-      root_(nullptr), 
       flight_count_(0),
-      shutdown_flag_(false) {
+      height_(0),
+      commit_policy_(COMMIT_INTERVAL),
+      damaged_(false),
+      op_saves_(0),
+      shutdown_flag_(false),
+      write_stats_{0, 0, 0, 0, 0, 0, 0},
+      commit_interval_ms_(DEFAULT_COMMIT_INTERVAL_MS),
+      commit_requested_(0),
+      commit_done_(0),
+      last_commit_ok_(true),
+      wal_enabled_(true),
+      wal_(nullptr) {
 }
 
-BTree::~BTree() {
-    shutdown();
+// The tree has unpinned its root by now, so the pool frees every node
+BTreeBase::~BTreeBase() {
+    delete pool_;
     delete storage_;
 }
 
-bool BTree::initialize() {
+bool BTreeBase::open() {
     if (!storage_->initialize()) {
         return false;
     }
-    
-    // Start background worker thread
-    worker_thread_ = thread(&BTree::worker_function, this);
-    
-    // Load root node if it exists
-    int root_block = storage_->get_root_block();
-    if (root_block != -1) {
-        root_ = load_node(root_block);
-        
-        // Count flights by traversing
-        auto all_flights = get_all();
-        flight_count_ = all_flights.size();
-        
-        cout << "Loaded B-Tree with " << flight_count_ << " flights" << endl;
-    } else {
-        // Create new root
-        root_ = new Node(storage_->allocate_block(), true);
-        storage_->set_root_block(root_->block_index);
-        save_node(root_, false);
-        flight_count_ = 0;
-        cout << "Created new B-Tree" << endl;
+    if (wal_enabled_ && !recover()) {
+        return false;
+    }
+    if (!storage_->superblock_valid()) {
+        cerr << "Cannot open " << filename_ << " without a valid superblock" << endl;
+        return false;
     }
     
+    // Start background worker thread
+    worker_thread_ = thread(&BTreeBase::worker_function, this);
     return true;
 }
 
-void BTree::shutdown() {
-    shutdown_flag_ = true;
-    queue_cv_.notify_all();
-    
-    if (worker_thread_.joinable()) {
-        worker_thread_.join();
-    }
-    
-    // Sync all remaining dirty nodes
-    lock_guard<mutex> lock(queue_mutex_);
-    while (!dirty_queue_.empty()) {
-        Node* node = dirty_queue_.front();
-        dirty_queue_.pop();
-        
-        char buffer[BLOCK_SIZE];
-        node->serialize(buffer);
-        storage_->write_block(node->block_index, buffer);
-        
-        delete node;
-    }
-    
-    if (root_) {
-        delete root_;
-        root_ = nullptr;
-    }
-    
-    storage_->shutdown();
-    cout << "B-Tree shutdown complete" << endl;
+void BTreeBase::set_commit_policy(CommitPolicy policy, int interval_ms) {
+    commit_policy_ = policy;
+    commit_interval_ms_ = interval_ms;
 }
 
-Node* BTree::load_node(int block_index) {
-    char buffer[BLOCK_SIZE];
-    storage_->read_block(block_index, buffer);
-    
-    Node* node = new Node(block_index);
-    node->deserialize(buffer);
-    return node;
+void BTreeBase::set_direct_io(bool enabled) {
+    storage_->set_direct_io(enabled);
 }
-  int BTree::get_flight_count() const { return flight_count_; }
-void BTree::save_node(Node* node, bool async) {
-    if (async) {
-        lock_guard<mutex> lock(queue_mutex_);
-        dirty_queue_.push(node);
-        queue_cv_.notify_one();
-    } else {
-        char buffer[BLOCK_SIZE];
-        node->serialize(buffer);
-        storage_->write_block(node->block_index, buffer);
-        node->is_dirty = false;
-    }
+
+void BTreeBase::set_memory_mapped(bool enabled) {
+    storage_->set_memory_mapped(enabled);
 }
 
-void BTree::worker_function() {
-    while (!shutdown_flag_) {
-        unique_lock<mutex> lock(queue_mutex_);
-        queue_cv_.wait(lock, [this]() { 
-            return !dirty_queue_.empty() || shutdown_flag_; 
-        });
-        
-        while (!dirty_queue_.empty()) {
-            Node* node = dirty_queue_.front();
-            dirty_queue_.pop();
-            lock.unlock();
-            
-            // Write to disk
-            char buffer[BLOCK_SIZE];
-            node->serialize(buffer);
-            storage_->write_block(node->block_index, buffer);
-            node->is_dirty = false;
-            
-            lock.lock();
-        }
-    }
+void BTreeBase::set_write_ahead_log(bool enabled) {
+    wal_enabled_ = enabled;
 }
 
-// Search with value return
-bool BTree::search(int key, string& value, vector<int>& path) {
-    if (!root_) return false;
+// Redoes every group the log holds on top of the data file, then checkpoints
+// so the log can start empty. Groups are block images, so replaying one the
+// data file already has is harmless.
+bool BTreeBase::recover() {
+    wal_ = new WriteAheadLog(filename_ + ".wal");
+    if (!wal_->open()) {
+        return false;
+    }
     
-    Node* current = root_;
-    path.push_back(current->block_index);
+    vector<char> superblock;
+    int groups = wal_->replay([this, &superblock](const WriteAheadLog::Pages& pages, 
+                                                  const vector<char>& image) {
+        storage_->write_blocks(pages);
+        superblock = image;
+    });
     
-    while (current) {
-        int idx = current->find_key(key);
-        
-        if (idx < current->key_count && current->keys[idx] == key) {
-            value = current->values[idx];
-            return true;
-        }
-        
-        if (current->is_leaf) {
-            break;
-        }
-        
-        if (!current->memory_pointers[idx]) {
-            current->memory_pointers[idx] = load_node(current->disk_pointers[idx]);
+    if (groups > 0) {
+        if (!storage_->install_superblock(superblock)) {
+            cerr << "Log holds no usable superblock: " << filename_ << ".wal" << endl;
+            return false;
         }
-        
-        current = current->memory_pointers[idx];
-        if (current) {
-            path.push_back(current->block_index);
+        if (!storage_->checkpoint(superblock)) {
+            return false;
         }
+        cout << "Replayed " << groups << " commits from " << filename_ << ".wal" << endl;
     }
-    
-    return false;
+    return wal_->reset();
 }
 
-// Insert with key-value pair
-bool BTree::insert(int key, const string& value) {
-    string dummy;
-    vector<int> path;
-    
-    if (search(key, dummy, path)) {
+bool BTreeBase::commit() {
+    unique_lock<mutex> lock(dirty_mutex_);
+    if (!worker_thread_.joinable() || shutdown_flag_) {
         return false;
     }
     
-    if (root_->key_count == M - 1) {
-        Node* new_root = new Node(storage_->allocate_block(), false);
-        new_root->disk_pointers[0] = root_->block_index;
-        new_root->memory_pointers[0] = root_;
-        
-        split_child(new_root, 0, root_);
-        
-        storage_->set_root_block(new_root->block_index);
-        root_ = new_root;
-        save_node(root_, false);
-    }
-    
-    insert_non_full(root_, key, value);
-    flight_count_++;
-    return true;
+    unsigned long ticket = ++commit_requested_;
+    dirty_cv_.notify_one();
+    commit_cv_.wait(lock, [this, ticket]() { return commit_done_ >= ticket; });
+    return last_commit_ok_;
 }
 
-void BTree::insert_non_full(Node* node, int key, const string& value) {
-    if (node->is_leaf) {
-        node->insert_key_value(key, value);
-        save_node(node);
-    } else {
-        int idx = node->find_key(key);
-        
-        if (!node->memory_pointers[idx]) {
-            node->memory_pointers[idx] = load_node(node->disk_pointers[idx]);
-        }
-        
-        Node* child = node->memory_pointers[idx];
-        if (child->key_count == M - 1) {
-            split_child(node, idx, child);
-            if (key > node->keys[idx]) {
-                idx++;
-            }
-        }
-        
-        insert_non_full(node->memory_pointers[idx], key, value);
+void BTreeBase::close() {
+    {
+        lock_guard<mutex> lock(dirty_mutex_);
+        shutdown_flag_ = true;
     }
-}
-
-void BTree::split_child(Node* parent, int index, Node* child) {
-    Node* new_child = new Node(storage_->allocate_block(), child->is_leaf);
-    new_child->key_count = M / 2 - 1;
-    
-    int middle_idx = M / 2 - 1;
+    dirty_cv_.notify_all();
     
-    for (int i = 0; i < new_child->key_count; i++) {
-        new_child->keys[i] = child->keys[i + M / 2];
-        new_child->values[i] = child->values[i + M / 2];
+    // The worker drains the queue before it exits
+    if (worker_thread_.joinable()) {
+        worker_thread_.join();
     }
     
-    if (!child->is_leaf) {
-        for (int i = 0; i <= new_child->key_count; i++) {
-            new_child->disk_pointers[i] = child->disk_pointers[i + M / 2];
-            new_child->memory_pointers[i] = nullptr;
-        }
+    // Everything logged is in the synced data file now
+    storage_->shutdown();
+    if (wal_) {
+        wal_->reset();
+        delete wal_;
+        wal_ = nullptr;
     }
-    
-    child->key_count = M / 2 - 1;
-    
-    parent->insert_key_value(child->keys[middle_idx], child->values[middle_idx], 
-                            new_child->block_index, new_child);
-    
-    save_node(child);
-    save_node(new_child);
-    save_node(parent);
+    cout << "B-Tree shutdown complete" << endl;
+}
+
+NodeBase* BTreeBase::pin(int block_index) {
+    NodeBase* node = pool_->pin(block_index);
+    op_pins_.push_back(node);
+    return node;
 }
 
-// Range query for flights between time ranges
-vector<pair<int, string>> BTree::range_query(int low, int high) {
-    vector<pair<int, string>> result;
-    if (root_) {
-        auto load_func = [this](int block_index) -> Node* {
-            return this->load_node(block_index);
-        };
-        root_->range_query(low, high, result, load_func);
+NodeBase* BTreeBase::pin_new(NodeBase* node) {
+    pool_->pin_new(node);
+    op_pins_.push_back(node);
+    return node;
+}
+
+// Held to the end of the operation, and pinned until then so the node
+// stays in the pool while its snapshot is still the operation's own
+void BTreeBase::latch(NodeBase* node) {
+    if (find(op_latches_.begin(), op_latches_.end(), node) != op_latches_.end()) {
+        return;
     }
-    return result;
+    node->latch.lock();
+    pool_->pin(node);
+    op_latches_.push_back(node);
 }
 
-// Get all flights (in-order traversal)
-vector<pair<int, string>> BTree::get_all()  {
-    vector<pair<int, string>> result;
-    inorder_traversal(root_, result);
-    return result;
+// Discarding marks the node obsolete, which fails any reader holding it
+void BTreeBase::free_node(NodeBase* node) {
+    storage_->deallocate_block(node->block_index);
+    pool_->discard(node);
 }
 
-void BTree::inorder_traversal(Node* node, vector<pair<int, string>>& result)  {
-    if (!node) return;
-    
-    int i;
-    for (i = 0; i < node->key_count; i++) {
-        if (!node->is_leaf) {
-            if (!node->memory_pointers[i]) {
-                node->memory_pointers[i] = load_node(node->disk_pointers[i]);
-            }
-            inorder_traversal(node->memory_pointers[i], result);
-        }
-        result.push_back({node->keys[i], node->values[i]});
+void BTreeBase::release_pins() {
+    for (NodeBase* node : op_latches_) {
+        node->latch.unlock();
+        pool_->unpin(node);
     }
-    
-    if (!node->is_leaf) {
-        if (!node->memory_pointers[i]) {
-            node->memory_pointers[i] = load_node(node->disk_pointers[i]);
-        }
-        inorder_traversal(node->memory_pointers[i], result);
+    op_latches_.clear();
+    for (NodeBase* node : op_pins_) {
+        pool_->unpin(node);
     }
+    op_pins_.clear();
 }
 
-// Remove operation
-bool BTree::remove(int key) {
-    string dummy;
-    vector<int> path;
-    if (!search(key, dummy, path)) {
-        return false;
+int BTreeBase::get_flight_count() const { return flight_count_; }
+
+bool BTreeBase::damaged() const { return damaged_; }
+
+// The block is left as found, for whatever can still read it
+void BTreeBase::mark_damaged(int block_index) {
+    cerr << "Block " << block_index << " of " << filename_ << " is damaged; the tree is read-only now" << endl;
+    damaged_ = true;
+}
+
+BufferPool::Stats BTreeBase::cache_stats() const {
+    return pool_->stats();
+}
+
+// Snapshots the node rather than queueing the node itself: the tree keeps
+// changing (and merges free nodes) while the writer catches up. Only the
+// latest snapshot of a block is kept, so a leaf saved on every insert of a
+// burst is written once.
+char* BTreeBase::stage_block(int block_index) {
+    vector<char>& buffer = op_dirty_[block_index];
+    buffer.resize(BLOCK_SIZE);
+    op_saves_++;
+    return buffer.data();
+}
+
+// Publishes the operation's saves to the writer in one step, along with the
+// superblock they go with
+void BTreeBase::end_operation() {
+    if (op_dirty_.empty()) {
+        return;
     }
+    storage_->set_tree_stats(flight_count_, height_);
+    vector<char> superblock = wal_ ? storage_->superblock_image() : vector<char>();
     
-    remove_key(root_, key);
-    flight_count_--;
-    
-    if (root_->key_count == 0 && !root_->is_leaf) {
-        Node* old_root = root_;
-        root_ = load_node(root_->disk_pointers[0]);
-        storage_->set_root_block(root_->block_index);
-        storage_->deallocate_block(old_root->block_index);
-        delete old_root;
+    lock_guard<mutex> lock(dirty_mutex_);
+    for (auto& block : op_dirty_) {
+        dirty_blocks_[block.first].swap(block.second);
     }
-    
-    return true;
+    dirty_superblock_.swap(superblock);
+    write_stats_.saves += op_saves_;
+    op_dirty_.clear();
+    op_saves_ = 0;
+    dirty_cv_.notify_one();
 }
 
-void BTree::remove_key(Node* node, int key) {
-    int idx = node->find_key(key);
-    
-    if (idx < node->key_count && node->keys[idx] == key) {
-        if (node->is_leaf) {
-            remove_from_leaf(node, idx);
-        } else {
-            remove_from_non_leaf(node, idx);
-        }
-    } else {
-        if (node->is_leaf) {
-            return;
+void BTreeBase::worker_function() {
+    unique_lock<mutex> lock(dirty_mutex_);
+    auto commit_waiting = [this]() { return commit_requested_ != commit_done_; };
+    while (true) {
+        dirty_cv_.wait(lock, [this, &commit_waiting]() { 
+            return !dirty_blocks_.empty() || commit_waiting() || shutdown_flag_; 
+        });
+        if (dirty_blocks_.empty() && !commit_waiting()) {
+            break;  // Shutting down and fully drained
         }
         
-        if (!node->memory_pointers[idx]) {
-            node->memory_pointers[idx] = load_node(node->disk_pointers[idx]);
-        }
+        // Let a burst of saves land on the same blocks before taking them,
+        // unless someone is blocked on a commit
+        int delay_ms = commit_policy_ == COMMIT_INTERVAL ? commit_interval_ms_ : WRITE_BACK_DELAY_MS;
+        dirty_cv_.wait_for(lock, chrono::milliseconds(delay_ms), [this, &commit_waiting]() {
+            return shutdown_flag_ || commit_waiting();
+        });
         
-        Node* child = node->memory_pointers[idx];
+        bool sync = wal_ || commit_policy_ != COMMIT_ON_SHUTDOWN || commit_waiting();
+        unsigned long covered = commit_requested_;
         
-        if (child->key_count < M / 2) {
-            if (idx > 0) {
-                if (!node->memory_pointers[idx - 1]) {
-                    node->memory_pointers[idx - 1] = load_node(node->disk_pointers[idx - 1]);
-                }
-                Node* left_sibling = node->memory_pointers[idx - 1];
-                
-                if (left_sibling->key_count >= M / 2) {
-                    borrow_from_left(node, idx);
-                } else {
-                    merge_children(node, idx - 1);
-                    idx = idx - 1;
-                }
-            } else if (idx < node->key_count) {
-                if (!node->memory_pointers[idx + 1]) {
-                    node->memory_pointers[idx + 1] = load_node(node->disk_pointers[idx + 1]);
-                }
-                Node* right_sibling = node->memory_pointers[idx + 1];
-                
-                if (right_sibling->key_count >= M / 2) {
-                    borrow_from_right(node, idx);
-                } else {
-                    merge_children(node, idx);
-                }
-            }
+        // flushing_ stays readable to load_node until the batch is on disk.
+        // Its pages are summed outside the lock and sealed under it, so no
+        // reader sees one half sealed.
+        flushing_.swap(dirty_blocks_);
+        vector<char> superblock;
+        superblock.swap(dirty_superblock_);
+        lock.unlock();
+        
+        vector<uint32_t> checksums;
+        checksums.reserve(flushing_.size());
+        for (const auto& block : flushing_) {
+            checksums.push_back(seal_checksum(block.second.data()));
+        }
+        lock.lock();
+        auto checksum = checksums.begin();
+        for (auto& block : flushing_) {
+            seal_page(block.second.data(), *checksum++);
         }
+        lock.unlock();
         
-        remove_key(node->memory_pointers[idx], key);
-    }
-}
-
-void BTree::remove_from_leaf(Node* node, int index) {
-    node->remove_key(index);
-    save_node(node);
-}
-
-void BTree::remove_from_non_leaf(Node* node, int index) {
-    int key = node->keys[index];
-    
-    if (!node->memory_pointers[index]) {
-        node->memory_pointers[index] = load_node(node->disk_pointers[index]);
-    }
-    Node* left_child = node->memory_pointers[index];
-    
-    if (left_child->key_count >= M / 2) {
-        int pred = find_predecessor(node, index);
-        node->keys[index] = pred;
-        remove_key(left_child, pred);
-    } else {
-        if (!node->memory_pointers[index + 1]) {
-            node->memory_pointers[index + 1] = load_node(node->disk_pointers[index + 1]);
+        vector<pair<int, const char*>> writes;
+        writes.reserve(flushing_.size());
+        for (const auto& block : flushing_) {
+            writes.emplace_back(block.first, block.second.data());
         }
-        Node* right_child = node->memory_pointers[index + 1];
         
-        if (right_child->key_count >= M / 2) {
-            int succ = find_successor(node, index);
-            node->keys[index] = succ;
-            remove_key(right_child, succ);
-        } else {
-            merge_children(node, index);
-            remove_key(left_child, key);
+        auto start = chrono::steady_clock::now();
+        bool checkpointed = false;
+        bool ok = write_batch(writes, superblock, sync, checkpointed);
+        long long micros = chrono::duration_cast<chrono::microseconds>(
+            chrono::steady_clock::now() - start).count();
+        
+        lock.lock();
+        write_stats_.block_writes += flushing_.size();
+        write_stats_.batches++;
+        write_stats_.checkpoints += checkpointed;
+        flushing_.clear();
+        if (sync) {
+            write_stats_.commits++;
+            write_stats_.commit_micros += micros;
+            write_stats_.max_commit_micros = max(write_stats_.max_commit_micros, micros);
+            last_commit_ok_ = ok;
+            commit_done_ = covered;
+            commit_cv_.notify_all();
         }
     }
 }
 
-int BTree::find_predecessor(Node* node, int index) {
-    Node* current = node->memory_pointers[index];
-    while (!current->is_leaf) {
-        int last_idx = current->key_count;
-        if (!current->memory_pointers[last_idx]) {
-            current->memory_pointers[last_idx] = load_node(current->disk_pointers[last_idx]);
+// Blocks evicted from the pool may still be waiting for the writer, so the
+// newest snapshot wins over the file. A block saved by the running operation
+// is never read: its node stays pinned until the operation is published.
+void BTreeBase::read_block(int block_index, const function<void(const char*, bool)>& read) {
+    {
+        lock_guard<mutex> lock(dirty_mutex_);
+        for (const map<int, vector<char>>* pending : {&dirty_blocks_, &flushing_}) {
+            auto it = pending->find(block_index);
+            if (it != pending->end()) {
+                read(it->second.data(), false);
+                return;
+            }
         }
-        current = current->memory_pointers[last_idx];
     }
-    return current->keys[current->key_count - 1];
+    storage_->visit_block(block_index, [&read](const char* data) { read(data, true); });
 }
 
-int BTree::find_successor(Node* node, int index) {
-    Node* current = node->memory_pointers[index + 1];
-    while (!current->is_leaf) {
-        if (!current->memory_pointers[0]) {
-            current->memory_pointers[0] = load_node(current->disk_pointers[0]);
-        }
-        current = current->memory_pointers[0];
+// Without the log a synced batch is a plain commit. With it the batch is
+// logged and the log synced before any page reaches the data file, and the
+// data file is only synced when the log has grown enough to checkpoint.
+bool BTreeBase::write_batch(const vector<pair<int, const char*>>& writes, const vector<char>& superblock,
+                            bool sync, bool& checkpointed) {
+    if (!wal_) {
+        return sync ? storage_->commit(writes) : storage_->write_blocks(writes);
     }
-    return current->keys[0];
-}
-
-void BTree::merge_children(Node* parent, int index) {
-    Node* left_child = parent->memory_pointers[index];
-    Node* right_child = parent->memory_pointers[index + 1];
-    
-    left_child->keys[left_child->key_count] = parent->keys[index];
-    left_child->values[left_child->key_count] = parent->values[index];
-    left_child->key_count++;
     
-    for (int i = 0; i < right_child->key_count; i++) {
-        left_child->keys[left_child->key_count + i] = right_child->keys[i];
-        left_child->values[left_child->key_count + i] = right_child->values[i];
-    }
+    bool logged = superblock.empty() || wal_->append_group(writes, superblock);
+    logged = wal_->sync() && logged;
+    bool written = storage_->write_blocks(writes);
     
-    if (!left_child->is_leaf) {
-        for (int i = 0; i <= right_child->key_count; i++) {
-            left_child->disk_pointers[left_child->key_count + i] = right_child->disk_pointers[i];
-            left_child->memory_pointers[left_child->key_count + i] = right_child->memory_pointers[i];
-        }
+    if (logged && written && !superblock.empty() && wal_->size() >= WAL_CHECKPOINT_BYTES) {
+        checkpointed = storage_->checkpoint(superblock) && wal_->reset();
+        written = checkpointed;
     }
-    
-    left_child->key_count += right_child->key_count;
-    
-    parent->remove_key(index);
-    
-    parent->disk_pointers[index + 1] = -1;
-    parent->memory_pointers[index + 1] = nullptr;
-    
-    storage_->deallocate_block(right_child->block_index);
-    delete right_child;
-    
-    save_node(left_child);
-    save_node(parent);
+    return logged && written;
 }
 
-void BTree::borrow_from_left(Node* parent, int index) {
-    Node* child = parent->memory_pointers[index];
-    Node* left_sibling = parent->memory_pointers[index - 1];
-    
-    for (int i = child->key_count; i > 0; i--) {
-        child->keys[i] = child->keys[i - 1];
-        child->values[i] = child->values[i - 1];
-    }
-    if (!child->is_leaf) {
-        for (int i = child->key_count + 1; i > 0; i--) {
-            child->disk_pointers[i] = child->disk_pointers[i - 1];
-            child->memory_pointers[i] = child->memory_pointers[i - 1];
-        }
-    }
-    
-    child->keys[0] = parent->keys[index - 1];
-    child->values[0] = parent->values[index - 1];
-    if (!child->is_leaf) {
-        child->disk_pointers[0] = left_sibling->disk_pointers[left_sibling->key_count];
-        child->memory_pointers[0] = left_sibling->memory_pointers[left_sibling->key_count];
-    }
-    
-    child->key_count++;
-    
-    parent->keys[index - 1] = left_sibling->keys[left_sibling->key_count - 1];
-    parent->values[index - 1] = left_sibling->values[left_sibling->key_count - 1];
-    left_sibling->key_count--;
-    
-    save_node(child);
-    save_node(left_sibling);
-    save_node(parent);
+BTreeBase::WriteStats BTreeBase::write_stats() {
+    lock_guard<mutex> lock(dirty_mutex_);
+    return write_stats_;
 }
 
-void BTree::borrow_from_right(Node* parent, int index) {
-    Node* child = parent->memory_pointers[index];
-    Node* right_sibling = parent->memory_pointers[index + 1];
-    
-    child->keys[child->key_count] = parent->keys[index];
-    child->values[child->key_count] = parent->values[index];
-    if (!child->is_leaf) {
-        child->disk_pointers[child->key_count + 1] = right_sibling->disk_pointers[0];
-        child->memory_pointers[child->key_count + 1] = right_sibling->memory_pointers[0];
-    }
-    
-    child->key_count++;
-    
-    parent->keys[index] = right_sibling->keys[0];
-    parent->values[index] = right_sibling->values[0];
-    
-    for (int i = 0; i < right_sibling->key_count - 1; i++) {
-        right_sibling->keys[i] = right_sibling->keys[i + 1];
-        right_sibling->values[i] = right_sibling->values[i + 1];
-    }
-    if (!right_sibling->is_leaf) {
-        for (int i = 0; i < right_sibling->key_count; i++) {
-            right_sibling->disk_pointers[i] = right_sibling->disk_pointers[i + 1];
-            right_sibling->memory_pointers[i] = right_sibling->memory_pointers[i + 1];
-        }
-    }
-    
-    right_sibling->key_count--;
-    
-    save_node(child);
-    save_node(right_sibling);
-    save_node(parent);
+// The new blocks are on disk; only the superblock is left. Logging it first
+// covers a torn superblock write, and a replay of older groups only touches
+// the blocks of the old, now free, root.
+bool BTreeBase::publish_bulk_load(size_t block_writes, size_t batches) {
+    storage_->set_tree_stats(flight_count_, height_);
+    {
+        lock_guard<mutex> lock(dirty_mutex_);
+        write_stats_.block_writes += block_writes;
+        write_stats_.batches += batches;
+    }
+    
+    vector<char> superblock = storage_->superblock_image();
+    bool ok = !wal_ || (wal_->append_group({}, superblock) && wal_->sync());
+    ok = ok && storage_->checkpoint(superblock);
+    return ok && (!wal_ || wal_->reset());
 }
 
-void BTree::print_tree() {
-    if (!root_) {
-        cout << "Tree is empty" << endl;
-        return;
-    }
-    
-    queue<Node*> q;
-    q.push(root_);
-    int level = 0;
-    
-    while (!q.empty()) {
-        int level_size = q.size();
-        cout << "Level " << level << ": ";
-        
-        for (int i = 0; i < level_size; i++) {
-            Node* current = q.front();
-            q.pop();
-            
-            cout << "[Block " << current->block_index << ": ";
-            for (int j = 0; j < current->key_count; j++) {
-                cout << current->keys[j] << "(" << current->values[j] << ")";
-                if (j < current->key_count - 1) cout << ",";
-            }
-            cout << "] ";
-            
-            if (!current->is_leaf) {
-                for (int j = 0; j <= current->key_count; j++) {
-                    if (current->disk_pointers[j] != -1) {
-                        if (!current->memory_pointers[j]) {
-                            current->memory_pointers[j] = load_node(current->disk_pointers[j]);
-                        }
-                        q.push(current->memory_pointers[j]);
-                    }
-                }
-            }
-        }
-        
-        cout << endl;
-        level++;
-    }
-}
\ No newline at end of file
+// A freed block can be allocated again right away, so a node the pool holds
+// for it goes too
+void BTreeBase::free_block(int block_index) {
+    storage_->deallocate_block(block_index);
+    pool_->drop(block_index);
+}
+
+// A bulk-loaded level splits its units evenly over its nodes: a leaf's units
+// are its entries, an internal node's its children. Between order/2 and
+// order units a node is legal anywhere but the root.
+long BTreeBase::bulk_level_nodes(long units, int target_units, int order) {
+    long fewest = (units + order - 1) / order;
+    long most = max(units / (order / 2), 1L);
+    long nodes = (units + target_units / 2) / target_units;
+    return max(fewest, min(nodes, most));
+}
@@ -2,78 +2,1483 @@
 #define BTREE_H
 
 #include "node.h"
+#include "codec.h"
 #include "storage_manager.h"
+#include "buffer_pool.h"
+#include "write_ahead_log.h"
+#include "external_sort.h"
 #include <vector>
 #include <memory>
 #include <queue>
+#include <map>
 #include <mutex>
 #include <thread>
+#include <atomic>
 #include <condition_variable>
 #include <string>
 #include <functional>
 #include <utility>
+#include <iterator>
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <type_traits>
 
 using namespace std;
 
-class BTree {
+// When the writer makes changes durable (one fdatasync per commit). With
+// the write-ahead log on, every batch is logged and synced before its pages
+// reach the data file, so the policy only decides how often batches are cut.
+enum CommitPolicy {
+    COMMIT_PER_OPERATION,   // insert/remove return once their changes are on disk
+    COMMIT_INTERVAL,        // the writer commits at most every commit interval
+    COMMIT_ON_SHUTDOWN      // batches go to the page cache; synced only at shutdown
+};
+
+// Everything about a tree that doesn't depend on its key and value types:
+// the file, the node cache, the write-ahead log, and the writer thread that
+// commits the blocks operations serialize. BTree builds on it.
+class BTreeBase {
 public:
-    BTree(const string& filename);
+    // Set before initialize; the writer thread reads it unlocked
+    void set_commit_policy(CommitPolicy policy, int interval_ms = DEFAULT_COMMIT_INTERVAL_MS);
+    void set_direct_io(bool enabled);   // O_DIRECT file access, also before initialize
+    void set_memory_mapped(bool enabled);   // mmap the file, also before initialize
+    void set_write_ahead_log(bool enabled); // Crash recovery through <file>.wal (on by default)
+
+    // Makes every change so far durable and returns once it is. False if the
+    // tree isn't running or the commit failed.
+    bool commit();
+
+    int get_flight_count() const;
+
+    // True once a block failed its checksum or bounds checks on loading. Its
+    // node reads as an empty leaf, and the tree refuses changes from then on.
+    bool damaged() const;
+
+    // Statistics
+    struct WriteStats {
+        size_t saves;           // save_node calls
+        size_t block_writes;    // Blocks the writer actually wrote
+        size_t batches;
+        size_t commits;         // Batches made durable with fdatasync
+        long long commit_micros;        // Total time spent committing
+        long long max_commit_micros;
+        size_t checkpoints;     // Times the log was folded into the data file
+    };
+    BufferPool::Stats cache_stats() const;
+    WriteStats write_stats();
+
+protected:
+    BTreeBase(const string& filename, size_t cache_bytes, size_t node_bytes, BufferPool::NodeLoader load_node);
+    ~BTreeBase();
+
+    StorageManager* storage_;  // Changed from unique_ptr to raw pointer
+    BufferPool* pool_;
+    string filename_;
+    atomic<int> flight_count_;
+    atomic<int> height_;       // Levels, a lone leaf root being 1
+    vector<NodeBase*> op_pins_;    // Nodes pinned by the running operation
+    vector<NodeBase*> op_latches_; // Nodes it changes, locked against readers
+    CommitPolicy commit_policy_;
+    atomic<bool> damaged_;
+
+    // Readers run alongside everything, but writers take turns: an operation
+    // stages its blocks and the superblock as one batch for the log
+    mutex write_mutex_;
+
+    bool open();    // Storage, log replay and the writer thread
+    void close();   // Drains the writer and leaves the file synced
+
+    // Nodes from pin/pin_new stay pinned until the public operation that
+    // asked for them calls release_pins, and nodes it latches stay locked
+    // until then. Writers latch a node before changing it; a new node needs
+    // no latch until something links to it.
+    NodeBase* pin(int block_index);
+    NodeBase* pin_new(NodeBase* node);
+    void latch(NodeBase* node);
+    void free_node(NodeBase* node);
+    void release_pins();
+
+    // save_node serializes into the block stage_block hands out, and
+    // load_node reads through read_block, which prefers snapshots the
+    // writer hasn't written yet. read learns whether the block came from
+    // the file, sealed, or is a snapshot that may not be yet.
+    char* stage_block(int block_index);
+    void read_block(int block_index, const function<void(const char*, bool sealed)>& read);
+    void end_operation();
+    void mark_damaged(int block_index);
+
+    // Bulk loading writes its blocks itself; this publishes the superblock
+    // that makes them the tree
+    bool publish_bulk_load(size_t block_writes, size_t batches);
+    void free_block(int block_index);   // Outside any operation, cached or not
+    static long bulk_level_nodes(long units, int target_units, int order);
+
+private:
+    // Saves of the running operation. They reach the writer together when it
+    // ends, so a logged batch never holds half an insert or remove.
+    map<int, vector<char>> op_dirty_;
+    size_t op_saves_;
+
+    // Asynchronous writer. A block saved again before the writer gets to it
+    // only replaces its snapshot, and the map hands batches over in block order.
+    thread worker_thread_;
+    map<int, vector<char>> dirty_blocks_;  // Block -> latest serialized node
+    map<int, vector<char>> flushing_;      // Batch the writer is writing now
+    vector<char> dirty_superblock_;        // Root and bitmap as of the last operation
+    mutex dirty_mutex_;
+    condition_variable dirty_cv_;
+    bool shutdown_flag_;
+    WriteStats write_stats_;
+
+    // Group commit: callers of commit() take a ticket and wait until the
+    // writer has synced a batch taken after it
+    int commit_interval_ms_;
+    unsigned long commit_requested_;
+    unsigned long commit_done_;
+    bool last_commit_ok_;
+    condition_variable commit_cv_;
+
+    // Redo log, replayed by initialize
+    bool wal_enabled_;
+    WriteAheadLog* wal_;
+
+    bool recover();
+    bool write_batch(const vector<pair<int, const char*>>& writes, const vector<char>& superblock,
+                     bool sync, bool& checkpointed);
+    void worker_function();
+};
+
+// B+Tree from Key to Value on a file. Compare orders keys; values order by
+// their operator<. Entries live in the leaves, which are chained both ways so
+// scans walk along them instead of up and down the tree. The codecs store
+// nodes in slotted pages, and nodes split when the next entry might not fit
+// and rebalance when they fall under Layout::MIN_FILL_BYTES, so the fanout
+// follows the sizes of the entries actually stored: short flight numbers
+// give int -> string leaves around 250 entries.
+//
+// Any number of threads can search and scan while inserts and removes go
+// on, one writer at a time. Writers latch each node before changing it and
+// hold the latches to the end of the operation. Readers take no latches on
+// the way down: they note a node's version, read it, and check the version
+// again after taking the next node's (optimistic lock coupling), starting
+// over from the root when a check fails. Keys and values that aren't
+// trivially copyable, like strings, are read under the node's shared latch
+// instead, which is only ever held for the read.
+template <typename Key, typename Value, typename Compare = std::less<Key>,
+          typename KeyCodec = Codec<Key>, typename ValueCodec = Codec<Value>>
+class BTree : public BTreeBase {
+public:
+    typedef BTreeNode<Key, Value, Compare, KeyCodec, ValueCodec> Node;
+
+    BTree(const string& filename, size_t cache_bytes = DEFAULT_CACHE_BYTES);
     ~BTree();
-    
+
     bool initialize();
     void shutdown();
-    
-    // Core operations with values
-    bool search(int key, string& value, vector<int>& path);
-    bool insert(int key, const string& value);
-    bool remove(int key);
-    
+
+    // Core operations with values. Entries are ordered by key and then by
+    // value, so a key can hold several (a departure time shared by flights);
+    // only an identical entry is a duplicate. search finds one entry with
+    // the key and remove(key) removes that one; remove(key, value) removes
+    // exactly the entry given.
+    bool search(const Key& key, Value& value, vector<int>& path);
+    bool insert(const Key& key, const Value& value);
+    bool remove(const Key& key);
+    bool remove(const Key& key, const Value& value);
+
+    // Bulk loading into an empty tree. Entries come in strictly increasing
+    // (key, value) order; nodes are built bottom-up, fill_factor full (at least
+    // half), and each is written once in one sequential pass. False if the
+    // tree isn't empty or an entry is out of order or too long; the tree is
+    // left empty then.
+    template <typename Iterator>
+    bool bulk_load(Iterator first, Iterator last, double fill_factor = 1.0);
+
+    // The same for entries in any order, pulled from next until it returns
+    // false. They are sorted in runs of BULK_LOAD_RUN_BYTES spilled next to
+    // the file; an entry given more than once is loaded once.
+    typedef function<bool(Key& key, Value& value)> EntrySource;
+    bool bulk_load_unsorted(const EntrySource& next, double fill_factor = 1.0);
+
+    // Position in the leaf chain. A cursor copies the entries of the leaf it
+    // is in and keeps that leaf pinned, so memory stays flat however far it
+    // moves; leaving either end makes it invalid. Writes go on while cursors
+    // are open: one leaving a leaf that changed since it was copied finds its
+    // place again from the root, next to the last entry it returned, so it
+    // never returns an entry twice or out of order. Cursors must not outlive
+    // the tree.
+    class Cursor {
+    public:
+        Cursor(Cursor&& other);
+        Cursor& operator=(Cursor&& other);
+        ~Cursor();
+
+        bool valid() const { return leaf_ != nullptr; }
+        const Key& key() const { return entries_[index_].first; }
+        const Value& value() const { return entries_[index_].second; }
+        void next();
+        void prev();
+
+    private:
+        friend class BTree;
+        explicit Cursor(BTree* tree);
+        bool copy(Node* leaf, uint64_t version);    // Takes over the pin on leaf, or drops it if it changed
+        void step(bool forward);
+        void release();
+
+        BTree* tree_;
+        Node* leaf_;
+        uint64_t version_;      // Of leaf_ when it was copied
+        int prev_leaf_;
+        int next_leaf_;
+        vector<pair<Key, Value>> entries_;
+        int index_;
+    };
+
+    // Cursors at the first entry with a key not less than key, at the
+    // smallest entry and at the largest. Reading N entries from seek costs
+    // a descent and the leaves they fill.
+    Cursor seek(const Key& key);
+    Cursor first();
+    Cursor last();
+
     // Range query for flight time searches
-    vector<pair<int, string>> range_query(int low, int high);
-    
-    // Get all flights (in-order traversal)
-    vector<pair<int, string>> get_all()  ;
-    
+    vector<pair<Key, Value>> range_query(const Key& low, const Key& high);
+
+    // Get all flights in order
+    vector<pair<Key, Value>> get_all();
+
     // For debugging
     void print_tree();
-    
-    // Statistics
-    
-    
+
 private:
-    StorageManager* storage_;  // Changed from unique_ptr to raw pointer
-    string filename_;
-    Node* root_;
-    int flight_count_;
-    
-    // Asynchronous writer
-    thread worker_thread_;
-    queue<Node*> dirty_queue_;
-    mutex queue_mutex_;
-    condition_variable queue_cv_;
-    bool shutdown_flag_;
-    
+    typedef typename Node::Layout Layout;
+
+    Node* root_;               // Pinned for as long as it is the root; writers start here
+    atomic<int> root_block_;   // Where readers start, -1 once shut down
+
     // Internal methods
+    Node* fetch(int block_index) { return static_cast<Node*>(pin(block_index)); }
+    Node* allocate_node(bool leaf) { return static_cast<Node*>(pin_new(new Node(storage_->allocate_block(), leaf))); }
+    Node* pin_cached(int block_index) { return static_cast<Node*>(pool_->pin(block_index)); }
+    void set_root(Node* node);
+    void save_node(Node* node);
     Node* load_node(int block_index);
-    void save_node(Node* node, bool async = true);
-    void worker_function();
-    public:
-      int get_flight_count() const;
-      private:
-    // B-tree operations
-    void split_child(Node* parent, int index, Node* child);
-    void insert_non_full(Node* node, int key, const string& value);
+
+    static bool entry_less(const Key& a_key, const Value& a_value, const Key& b_key, const Value& b_value);
+    static bool holds(const Node* node, int index, const Key& key, const Value& value);
+
+    // B+tree operations
+    void split_root();
+    void split_child(Node* parent, Node* child);
+    void insert_non_full(Node* node, const Key& key, const Value& value);
     void merge_children(Node* parent, int index);
     void borrow_from_left(Node* parent, int index);
     void borrow_from_right(Node* parent, int index);
-    void remove_from_leaf(Node* node, int index);
-    void remove_from_non_leaf(Node* node, int index);
-    int find_predecessor(Node* node, int index);
-    int find_successor(Node* node, int index);
-    void remove_key(Node* node, int key);
-    
-    // Helper for in-order traversal
-    void inorder_traversal(Node* node, vector<pair<int, string>>& result);
+    void relink_prev(int block_index, int prev_leaf);
+    void remove_key(Node* node, const Key& key, const Value& value);
+    bool contains(const Key& key, const Value& value);
+
+    // Readers. Plain keys and entries are read optimistically; the rest
+    // under the shared latch. read_node is false if the node changed.
+    static const bool PLAIN_KEYS = is_trivially_copyable<Key>::value;
+    static const bool PLAIN_ENTRIES = PLAIN_KEYS && is_trivially_copyable<Value>::value;
+    template <typename Read>
+    static bool read_node(Node* node, uint64_t version, bool plain, const Read& read);
+
+    // Descents pin one node at a time, route picking the child to take and
+    // locate the entry in the leaf. A scan prefetches the leaves it will
+    // visit under the last internal node, up to high if given.
+    template <typename Route>
+    Node* descend(const Route& route, bool plain, bool scan, const Key* high, uint64_t& version, vector<int>* path);
+    template <typename Route, typename Locate>
+    Node* find_leaf(const Route& route, const Locate& locate, bool plain, bool scan, const Key* high,
+                    int& index, uint64_t& version, vector<int>* path);
+    template <typename Route, typename Locate>
+    Cursor open_cursor(const Route& route, const Locate& locate, bool plain, bool scan, const Key* high);
+    void prefetch(const vector<int>& blocks);
+
+    // Bulk loading: feed hands count sorted entries to the sink it is given,
+    // and the blocks of replaced are freed with the old root
+    typedef function<bool(const Key& key, const Value& value)> EntrySink;
+    bool build_bottom_up(uint64_t count, int entry_bytes, double fill_factor,
+                         const function<bool(const EntrySink&)>& feed, const vector<int>& replaced = {});
+
+    // Files from before entries moved to the leaves are rebuilt on opening
+    typedef function<bool(const Key& key, const Value& value)> EntryVisitor;
+    bool rebuild_tree();
+    bool walk_classic(Node* node, const EntryVisitor& visit, vector<int>* blocks);
 };
 
-#endif
\ No newline at end of file
+#define BTREE_TEMPLATE template <typename Key, typename Value, typename Compare, typename KeyCodec, typename ValueCodec>
+#define BTREE_CLASS BTree<Key, Value, Compare, KeyCodec, ValueCodec>
+
+BTREE_TEMPLATE
+BTREE_CLASS::BTree(const string& filename, size_t cache_bytes)
+    : BTreeBase(filename, cache_bytes, Node::max_bytes(), [this](int block_index) { return load_node(block_index); }),
+      root_(nullptr),
+      root_block_(-1) {
+    storage_->set_record_layout({KeyCodec::TYPE_TAG, KeyCodec::MIN_BYTES, KeyCodec::MAX_BYTES,
+                                 ValueCodec::TYPE_TAG, ValueCodec::MIN_BYTES, ValueCodec::MAX_BYTES});
+}
+
+BTREE_TEMPLATE
+BTREE_CLASS::~BTree() {
+    shutdown();
+}
+
+BTREE_TEMPLATE
+bool BTREE_CLASS::initialize() {
+    if (!open()) {
+        return false;
+    }
+
+    // Load root node if it exists
+    int root_block = storage_->get_root_block();
+    if (root_block != -1) {
+        root_ = pin_cached(root_block);
+        root_block_ = root_block;
+        if (damaged_) {
+            cerr << "Cannot open " << filename_ << " with a damaged root" << endl;
+            return false;
+        }
+
+        if (!storage_->entries_in_leaves()) {
+            if (!rebuild_tree()) {
+                cerr << "Cannot rebuild " << filename_ << " with entries in the leaves" << endl;
+                return false;
+            }
+        } else {
+            uint64_t key_count = 0;
+            int height = 0;
+            storage_->get_tree_stats(key_count, height);
+            flight_count_ = key_count;
+            height_ = height;
+        }
+
+        cout << "Loaded B-Tree with " << flight_count_ << " flights" << endl;
+    } else {
+        // Create new root
+        root_ = static_cast<Node*>(pool_->pin_new(new Node(storage_->allocate_block(), true)));
+        root_block_ = root_->block_index;
+        storage_->set_root_block(root_->block_index);
+        storage_->upgrade_format();
+        flight_count_ = 0;
+        height_ = 1;
+        save_node(root_);
+        end_operation();
+        cout << "Created new B-Tree" << endl;
+    }
+
+    return true;
+}
+
+BTREE_TEMPLATE
+void BTREE_CLASS::shutdown() {
+    if (root_) {
+        root_block_ = -1;
+        pool_->unpin(root_);
+        root_ = nullptr;
+    }
+    close();
+}
+
+// The root keeps a pin of its own so the descent always starts in memory.
+// Readers switch to it once it is whole; the old root is latched or freed
+// by then, so any reader still in it starts over.
+BTREE_TEMPLATE
+void BTREE_CLASS::set_root(Node* node) {
+    pool_->pin(node);
+    if (root_) {
+        pool_->unpin(root_);
+    }
+    root_ = node;
+    root_block_.store(node->block_index, memory_order_release);
+}
+
+BTREE_TEMPLATE
+void BTREE_CLASS::save_node(Node* node) {
+    node->is_dirty = false;
+    if (!node->serialize(stage_block(node->block_index))) {
+        cerr << "Node in block " << node->block_index << " overflows it" << endl;
+    }
+}
+
+BTREE_TEMPLATE
+auto BTREE_CLASS::load_node(int block_index) -> Node* {
+    Node* node = new Node(block_index);
+    bool loaded = false;
+    read_block(block_index, [node, &loaded](const char* data, bool sealed) { loaded = node->deserialize(data, sealed); });
+    if (!loaded) {
+        mark_damaged(block_index);
+        delete node;
+        node = new Node(block_index, true);
+    }
+    return node;
+}
+
+BTREE_TEMPLATE
+bool BTREE_CLASS::entry_less(const Key& a_key, const Value& a_value, const Key& b_key, const Value& b_value) {
+    Compare less;
+    if (less(a_key, b_key) || less(b_key, a_key)) {
+        return less(a_key, b_key);
+    }
+    return a_value < b_value;
+}
+
+BTREE_TEMPLATE
+bool BTREE_CLASS::holds(const Node* node, int index, const Key& key, const Value& value) {
+    return index < node->key_count && Node::same_key(node->keys[index], key) && node->values[index] == value;
+}
+
+// Search with value return. Only the one entry is read out of the leaf.
+BTREE_TEMPLATE
+bool BTREE_CLASS::search(const Key& key, Value& value, vector<int>& path) {
+    auto route = [&key](const Node* node) { return node->find_key(key); };
+    size_t path_start = path.size();
+    while (true) {
+        path.resize(path_start);
+        int index = 0;
+        uint64_t version = 0;
+        Node* leaf = find_leaf(route, route, PLAIN_KEYS, false, nullptr, index, version, &path);
+        if (!leaf) {
+            return false;
+        }
+
+        bool found = false;
+        bool read = read_node(leaf, version, PLAIN_ENTRIES, [&]() {
+            found = Node::same_key(leaf->keys[index], key);
+            if (found) {
+                value = leaf->values[index];
+            }
+        });
+        pool_->unpin(leaf);
+        if (read) {
+            return found;
+        }
+    }
+}
+
+// Exact lookup of one entry, descending in entry order. The writer's own
+// check, so it reads without latches.
+BTREE_TEMPLATE
+bool BTREE_CLASS::contains(const Key& key, const Value& value) {
+    if (!root_) return false;
+
+    Node* current = root_;
+    while (!current->is_leaf) {
+        current = fetch(current->disk_pointers[current->find_child(key, value)]);
+    }
+    bool found = holds(current, current->find_entry(key, value), key, value);
+
+    release_pins();
+    return found;
+}
+
+// Insert with key-value pair
+BTREE_TEMPLATE
+bool BTREE_CLASS::insert(const Key& key, const Value& value) {
+    lock_guard<mutex> lock(write_mutex_);
+    if (damaged_ || !KeyCodec::fits(key) || !ValueCodec::fits(value) || contains(key, value)) {
+        return false;
+    }
+
+    // Splits all the way up take a node per level plus a new root
+    if (storage_->free_blocks() < static_cast<size_t>(height_) + 1) {
+        return false;
+    }
+
+    if (!root_->has_room()) {
+        split_root();
+    }
+
+    insert_non_full(root_, key, value);
+    flight_count_++;
+    end_operation();
+    release_pins();
+
+    if (commit_policy_ == COMMIT_PER_OPERATION) {
+        commit();
+    }
+    return true;
+}
+
+BTREE_TEMPLATE
+void BTREE_CLASS::insert_non_full(Node* node, const Key& key, const Value& value) {
+    if (node->is_leaf) {
+        latch(node);
+        node->insert_key_value(key, value);
+        save_node(node);
+    } else {
+        int idx = node->find_child(key, value);
+
+        Node* child = fetch(node->disk_pointers[idx]);
+        if (!child->has_room()) {
+            split_child(node, child);
+            idx = node->find_child(key, value);
+        }
+
+        insert_non_full(fetch(node->disk_pointers[idx]), key, value);
+    }
+}
+
+BTREE_TEMPLATE
+void BTREE_CLASS::split_root() {
+    Node* new_root = allocate_node(false);
+    new_root->disk_pointers[0] = root_->block_index;
+
+    split_child(new_root, root_);
+
+    storage_->set_root_block(new_root->block_index);
+    set_root(new_root);
+    height_++;
+    save_node(root_);
+}
+
+// Splits by bytes, so entries of different sizes can leave the halves with
+// different counts. An internal node's middle entry moves up; a leaf keeps
+// all of its entries and a copy of the new leaf's first becomes the
+// separator, which is then strictly between the parent's neighbouring ones.
+BTREE_TEMPLATE
+void BTREE_CLASS::split_child(Node* parent, Node* child) {
+    latch(parent);
+    latch(child);
+    Node* new_child = allocate_node(child->is_leaf);
+
+    int middle_idx = child->split_point();
+    int first_right = child->is_leaf ? middle_idx : middle_idx + 1;
+    new_child->key_count = child->key_count - first_right;
+    new_child->make_room(new_child->key_count);
+
+    for (int i = 0; i < new_child->key_count; i++) {
+        new_child->keys[i] = child->keys[i + first_right];
+        new_child->values[i] = child->values[i + first_right];
+    }
+
+    if (!child->is_leaf) {
+        for (int i = 0; i <= new_child->key_count; i++) {
+            new_child->disk_pointers[i] = child->disk_pointers[i + first_right];
+        }
+    } else {
+        new_child->prev_leaf = child->block_index;
+        new_child->next_leaf = child->next_leaf;
+        relink_prev(child->next_leaf, new_child->block_index);
+        child->next_leaf = new_child->block_index;
+    }
+
+    child->key_count = middle_idx;
+
+    parent->insert_key_value(child->keys[middle_idx], child->values[middle_idx],
+                            new_child->block_index);
+
+    save_node(child);
+    save_node(new_child);
+    save_node(parent);
+}
+
+// Points the leaf in block_index, if there is one, back at prev_leaf
+BTREE_TEMPLATE
+void BTREE_CLASS::relink_prev(int block_index, int prev_leaf) {
+    if (block_index == -1) {
+        return;
+    }
+    Node* leaf = fetch(block_index);
+    latch(leaf);
+    leaf->prev_leaf = prev_leaf;
+    save_node(leaf);
+}
+
+BTREE_TEMPLATE
+template <typename Iterator>
+bool BTREE_CLASS::bulk_load(Iterator first, Iterator last, double fill_factor) {
+    uint64_t count = 0;
+    int entry_bytes = 0;
+    for (Iterator it = first; it != last; ++it) {
+        count++;
+        entry_bytes = max(entry_bytes, KeyCodec::size(it->first) + ValueCodec::size(it->second));
+    }
+    return build_bottom_up(count, entry_bytes, fill_factor, [first, last](const EntrySink& sink) {
+        for (Iterator it = first; it != last; ++it) {
+            if (!sink(it->first, it->second)) {
+                return false;
+            }
+        }
+        return true;
+    });
+}
+
+BTREE_TEMPLATE
+bool BTREE_CLASS::bulk_load_unsorted(const EntrySource& next, double fill_factor) {
+    if (!root_ || flight_count_ != 0) {
+        return false;
+    }
+
+    ExternalSorter<Key, Value, Compare, KeyCodec, ValueCodec> sorter(filename_, BULK_LOAD_RUN_BYTES);
+    Key key;
+    Value value;
+    while (next(key, value)) {
+        if (!KeyCodec::fits(key) || !ValueCodec::fits(value) || !sorter.add(key, value)) {
+            return false;
+        }
+    }
+    if (!sorter.finish()) {
+        return false;
+    }
+    return build_bottom_up(sorter.count(), sorter.max_entry_bytes(), fill_factor,
+                           [&sorter](const EntrySink& sink) {
+        return sorter.merge(sink);
+    });
+}
+
+// Knowing the count fixes every level's shape up front, so entries stream
+// straight into the rightmost node of each level: an entry that finds its
+// leaf full starts the next one, and a copy of it becomes the separator of
+// the lowest level still taking children. Blocks are allocated as nodes are
+// finished, which is also the order they are written in, except that each
+// leaf's block is taken one leaf early so the one before can link to it.
+// Nodes are sized for entry_bytes, the largest entry given, so no page
+// overflows however the entries fall.
+//
+// Nothing points at the new blocks until the superblock does, and the old
+// root and replaced blocks stay allocated until then, so a crash or a bad
+// entry leaves the old tree behind. Readers go on in the old tree until the
+// new root replaces it.
+BTREE_TEMPLATE
+bool BTREE_CLASS::build_bottom_up(uint64_t count, int entry_bytes, double fill_factor,
+                                  const function<bool(const EntrySink&)>& feed, const vector<int>& replaced) {
+    lock_guard<mutex> lock(write_mutex_);
+    if (!root_ || damaged_ || flight_count_ != 0 || !commit()) {
+        return false;   // commit() drains the writer, which then stays idle
+    }
+    if (count == 0) {
+        return true;
+    }
+
+    entry_bytes = min(entry_bytes, KeyCodec::MAX_BYTES + ValueCodec::MAX_BYTES);    // Longer ones are refused
+    int leaf_keys = Layout::CAPACITY / (Layout::SLOT_BYTES + entry_bytes);
+    int internal_keys = Layout::CAPACITY / (Layout::SLOT_BYTES + Layout::POINTER_BYTES + entry_bytes);
+
+    struct Level {
+        long units;     // Entries of a leaf, children of an internal node
+        long nodes;
+        long built;
+        int children;   // Of the node being built, if internal
+        Node node;
+
+        int quota() const { return units / nodes + (built < units % nodes ? 1 : 0); }
+    };
+    vector<unique_ptr<Level>> levels;
+    long units = count;
+    do {
+        bool leaf = levels.empty();
+        int max_units = leaf ? leaf_keys : internal_keys + 1;
+        int target_units = static_cast<int>(lround(fill_factor * max_units));
+        target_units = max(max_units / 2, min(target_units, max_units));
+
+        long nodes = bulk_level_nodes(units, target_units, max_units);
+        levels.emplace_back(new Level{units, nodes, 0, 0, Node(-1, leaf)});
+        units = nodes;
+    } while (units > 1);
+
+    vector<int> allocated;
+    AlignedBuffer batch(BULK_WRITE_BLOCKS * BLOCK_SIZE);
+    vector<pair<int, const char*>> writes;
+    size_t batches = 0;
+
+    auto allocate = [&]() {
+        int block = storage_->allocate_block();
+        if (block >= 0) {
+            allocated.push_back(block);
+        }
+        return block;
+    };
+
+    auto flush = [&]() {
+        bool ok = writes.empty() || storage_->write_blocks(writes);
+        batches += !writes.empty();
+        writes.clear();
+        return ok;
+    };
+
+    // Writes out a level's current node and starts its next one
+    auto finish_node = [&](Level& level) {
+        Node& node = level.node;
+        bool more_leaves = node.is_leaf && level.built + 1 < level.nodes;
+        int block = node.is_leaf ? node.block_index : allocate();
+        int next = more_leaves ? allocate() : -1;
+        if (block < 0 || (more_leaves && next < 0)) {
+            return -1;
+        }
+        node.block_index = block;
+        node.next_leaf = next;
+
+        char* buffer = batch.data() + writes.size() * BLOCK_SIZE;
+        node.serialize(buffer);
+        seal_page(buffer);
+        writes.emplace_back(block, buffer);
+        if (writes.size() == BULK_WRITE_BLOCKS && !flush()) {
+            return -1;
+        }
+
+        node.key_count = 0;
+        level.children = 0;
+        level.built++;
+        if (node.is_leaf) {
+            node.prev_leaf = block;
+            node.block_index = next;
+        }
+        return block;
+    };
+
+    uint64_t seen = 0;
+    Key last_key = Key();
+    Value last_value = Value();
+    auto sink = [&](const Key& key, const Value& value) {
+        if (seen == count || !KeyCodec::fits(key) || !ValueCodec::fits(value) ||
+            KeyCodec::size(key) + ValueCodec::size(value) > entry_bytes ||
+            (seen > 0 && !entry_less(last_key, last_value, key, value))) {
+            return false;
+        }
+        seen++;
+        last_key = key;
+        last_value = value;
+
+        Node& leaf = levels[0]->node;
+        if (leaf.key_count == levels[0]->quota()) {
+            int child = finish_node(*levels[0]);
+            size_t i = 1;
+            for (; i < levels.size() && child >= 0; i++) {
+                Level& level = *levels[i];
+                level.node.disk_pointers[level.children++] = child;
+                if (level.children < level.quota()) {
+                    break;
+                }
+                child = finish_node(level);
+            }
+            if (child < 0 || i == levels.size()) {
+                return false;   // Out of blocks, or more entries than count
+            }
+
+            Node& parent = levels[i]->node;
+            parent.make_room(parent.key_count + 1);
+            parent.keys[parent.key_count] = key;
+            parent.values[parent.key_count] = value;
+            parent.key_count++;
+        }
+
+        leaf.make_room(leaf.key_count + 1);
+        leaf.keys[leaf.key_count] = key;
+        leaf.values[leaf.key_count] = value;
+        leaf.key_count++;
+        return true;
+    };
+
+    levels[0]->node.block_index = allocate();
+    bool ok = levels[0]->node.block_index >= 0 && feed(sink) && seen == count;
+    int root_block = ok ? finish_node(*levels[0]) : -1;
+    for (size_t i = 1; i < levels.size() && root_block >= 0; i++) {
+        levels[i]->node.disk_pointers[levels[i]->children++] = root_block;
+        root_block = finish_node(*levels[i]);
+    }
+    ok = root_block >= 0 && flush() && storage_->sync();
+
+    if (!ok) {
+        for (int block : allocated) {
+            storage_->deallocate_block(block);
+        }
+        return false;
+    }
+
+    // A reader following a stale link may have cached one of the blocks
+    // while it was free; the file has the new nodes now
+    for (int block : allocated) {
+        pool_->drop(block);
+    }
+
+    Node* new_root = fetch(root_block);
+    storage_->set_root_block(root_block);
+    free_node(root_);
+    set_root(new_root);
+    release_pins();
+    for (int block : replaced) {
+        free_block(block);
+    }
+    storage_->upgrade_format();
+    flight_count_ = count;
+    height_ = levels.size();
+    return publish_bulk_load(allocated.size(), batches);
+}
+
+// A classic B-tree keeps entries in its internal nodes as well. They are
+// read out in order and bulk loaded into blocks beside the old ones, which
+// are freed when the new root is published, so the file needs room for
+// both trees for a moment and a crash before then leaves the old one.
+BTREE_TEMPLATE
+bool BTREE_CLASS::rebuild_tree() {
+    uint64_t count = 0;
+    int entry_bytes = 0;
+    vector<int> blocks;
+    walk_classic(root_, [&count, &entry_bytes](const Key& key, const Value& value) {
+        count++;
+        entry_bytes = max(entry_bytes, KeyCodec::size(key) + ValueCodec::size(value));
+        return true;
+    }, &blocks);
+
+    // A lone leaf already is one
+    if (root_->is_leaf) {
+        storage_->upgrade_format();
+        flight_count_ = count;
+        height_ = 1;
+        return true;
+    }
+
+    cout << "Rebuilding " << filename_ << " with entries in the leaves" << endl;
+    flight_count_ = 0;
+    return build_bottom_up(count, entry_bytes, REBUILD_FILL_FACTOR, [this](const EntrySink& sink) {
+        return walk_classic(root_, sink, nullptr);
+    }, blocks);
+}
+
+// Visits a classic subtree's entries in order, each child before the entry
+// after it, and collects the blocks below node
+BTREE_TEMPLATE
+bool BTREE_CLASS::walk_classic(Node* node, const EntryVisitor& visit, vector<int>* blocks) {
+    if (!node->is_leaf) {
+        prefetch(vector<int>(node->disk_pointers.begin(), node->disk_pointers.begin() + node->key_count + 1));
+    }
+
+    for (int i = 0; i <= node->key_count; i++) {
+        if (!node->is_leaf) {
+            Node* child = pin_cached(node->disk_pointers[i]);
+            if (blocks) {
+                blocks->push_back(child->block_index);
+            }
+            bool ok = walk_classic(child, visit, blocks);
+            pool_->unpin(child);
+            if (!ok) {
+                return false;
+            }
+        }
+        if (i < node->key_count && !visit(node->keys[i], node->values[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+BTREE_TEMPLATE
+template <typename Read>
+bool BTREE_CLASS::read_node(Node* node, uint64_t version, bool plain, const Read& read) {
+    if (plain) {
+        read();
+        return node->latch.validate(version);
+    }
+    node->latch.lock_shared();
+    bool unchanged = node->latch.validate(version);
+    if (unchanged) {
+        read();
+    }
+    node->latch.unlock_shared();
+    return unchanged;
+}
+
+// A child's version is taken before its parent's is checked again, so a
+// child reached through a parent that didn't change is still its child.
+// Nothing read is trusted, not even a block to pin, until the node it came
+// from checks out.
+BTREE_TEMPLATE
+template <typename Route>
+auto BTREE_CLASS::descend(const Route& route, bool plain, bool scan, const Key* high,
+                          uint64_t& version, vector<int>* path) -> Node* {
+    size_t path_start = path ? path->size() : 0;
+    while (true) {
+        int block = root_block_.load(memory_order_acquire);
+        if (block == -1) {
+            return nullptr;
+        }
+        if (path) {
+            path->resize(path_start);
+        }
+
+        Node* node = pin_cached(block);
+        if (!node->latch.read_begin(version) || root_block_.load(memory_order_acquire) != block) {
+            pool_->unpin(node);
+            continue;
+        }
+
+        for (int level = 1; node; level++) {
+            bool leaf = false;
+            int child = -1;
+            vector<int> children;
+            bool read = read_node(node, version, plain, [&]() {
+                leaf = node->is_leaf;
+                if (!leaf) {
+                    int idx = route(node);
+                    child = node->disk_pointers[idx];
+                    if (scan && level == height_ - 1) {
+                        int last = high ? node->find_key_after(*high) : node->key_count;
+                        children.assign(node->disk_pointers.begin() + idx,
+                                        node->disk_pointers.begin() + max(idx, last) + 1);
+                    }
+                }
+            });
+            if (read && leaf) {
+                return node;
+            }
+
+            Node* next = nullptr;
+            uint64_t next_version = 0;
+            if (read) {
+                if (path) {
+                    path->push_back(node->block_index);
+                }
+                prefetch(children);
+                next = pin_cached(child);
+                if (!next->latch.read_begin(next_version) || !node->latch.validate(version)) {
+                    pool_->unpin(next);
+                    next = nullptr;
+                }
+            }
+            pool_->unpin(node);
+            node = next;
+            version = next_version;
+        }
+    }
+}
+
+// Places index in the leaf descend reaches. An index just past either end
+// moves it into the neighbour on that side, passing over leaves without
+// entries, and nullptr comes back past the ends of the chain. The leaf comes
+// back pinned, with the version index was read at.
+BTREE_TEMPLATE
+template <typename Route, typename Locate>
+auto BTREE_CLASS::find_leaf(const Route& route, const Locate& locate, bool plain, bool scan, const Key* high,
+                            int& index, uint64_t& version, vector<int>* path) -> Node* {
+    size_t path_start = path ? path->size() : 0;
+    while (true) {
+        if (path) {
+            path->resize(path_start);
+        }
+        Node* leaf = descend(route, plain, scan, high, version, path);
+        if (!leaf) {
+            return nullptr;
+        }
+
+        int count = 0;
+        int prev = -1;
+        int next = -1;
+        auto read_links = [&]() {
+            count = leaf->key_count;
+            prev = leaf->prev_leaf;
+            next = leaf->next_leaf;
+        };
+        bool read = read_node(leaf, version, plain, [&]() {
+            index = locate(leaf);
+            read_links();
+        });
+        if (read && path) {
+            path->push_back(leaf->block_index);
+        }
+
+        while (read && (index < 0 || index >= count)) {
+            bool forward = index >= count;
+            int block = forward ? next : prev;
+            if (block == -1) {
+                pool_->unpin(leaf);
+                return nullptr;
+            }
+
+            Node* neighbour = pin_cached(block);
+            uint64_t neighbour_version = 0;
+            read = neighbour->latch.read_begin(neighbour_version) && leaf->latch.validate(version);
+            pool_->unpin(leaf);
+            leaf = neighbour;
+            version = neighbour_version;
+            read = read && read_node(leaf, version, plain, read_links);
+            index = forward ? 0 : count - 1;
+            if (read && path) {
+                path->push_back(block);
+            }
+        }
+        if (read) {
+            return leaf;
+        }
+        pool_->unpin(leaf);
+    }
+}
+
+BTREE_TEMPLATE
+template <typename Route, typename Locate>
+auto BTREE_CLASS::open_cursor(const Route& route, const Locate& locate, bool plain, bool scan,
+                              const Key* high) -> Cursor {
+    Cursor cursor(this);
+    while (true) {
+        int index = 0;
+        uint64_t version = 0;
+        Node* leaf = find_leaf(route, locate, plain, scan, high, index, version, nullptr);
+        if (!leaf) {
+            return cursor;
+        }
+        if (cursor.copy(leaf, version)) {
+            cursor.index_ = index;
+            return cursor;
+        }
+    }
+}
+
+BTREE_TEMPLATE
+BTREE_CLASS::Cursor::Cursor(BTree* tree)
+    : tree_(tree), leaf_(nullptr), version_(0), prev_leaf_(-1), next_leaf_(-1), index_(0) {
+}
+
+BTREE_TEMPLATE
+BTREE_CLASS::Cursor::Cursor(Cursor&& other)
+    : tree_(other.tree_), leaf_(other.leaf_), version_(other.version_), prev_leaf_(other.prev_leaf_),
+      next_leaf_(other.next_leaf_), entries_(std::move(other.entries_)), index_(other.index_) {
+    other.leaf_ = nullptr;
+}
+
+BTREE_TEMPLATE
+auto BTREE_CLASS::Cursor::operator=(Cursor&& other) -> Cursor& {
+    if (this != &other) {
+        release();
+        tree_ = other.tree_;
+        leaf_ = other.leaf_;
+        version_ = other.version_;
+        prev_leaf_ = other.prev_leaf_;
+        next_leaf_ = other.next_leaf_;
+        entries_ = std::move(other.entries_);
+        index_ = other.index_;
+        other.leaf_ = nullptr;
+    }
+    return *this;
+}
+
+BTREE_TEMPLATE
+BTREE_CLASS::Cursor::~Cursor() {
+    release();
+}
+
+BTREE_TEMPLATE
+void BTREE_CLASS::Cursor::next() {
+    if (++index_ == static_cast<int>(entries_.size())) {
+        step(true);
+    }
+}
+
+BTREE_TEMPLATE
+void BTREE_CLASS::Cursor::prev() {
+    if (index_-- == 0) {
+        step(false);
+    }
+}
+
+// Entries are assigned over the ones held, so a scan reuses their storage.
+// They are left half copied when the leaf changed; the caller starts over.
+BTREE_TEMPLATE
+bool BTREE_CLASS::Cursor::copy(Node* leaf, uint64_t version) {
+    int prev_leaf = -1;
+    int next_leaf = -1;
+    bool read = read_node(leaf, version, PLAIN_ENTRIES, [&]() {
+        int count = leaf->key_count;
+        entries_.resize(count);
+        for (int i = 0; i < count; i++) {
+            entries_[i].first = leaf->keys[i];
+            entries_[i].second = leaf->values[i];
+        }
+        prev_leaf = leaf->prev_leaf;
+        next_leaf = leaf->next_leaf;
+    });
+    if (!read) {
+        tree_->pool_->unpin(leaf);
+        return false;
+    }
+
+    release();
+    leaf_ = leaf;
+    version_ = version;
+    prev_leaf_ = prev_leaf;
+    next_leaf_ = next_leaf;
+    return true;
+}
+
+// Into the neighbouring leaf while the one held is as it was copied, passing
+// over leaves without entries. Once it isn't, the neighbour may not be, and
+// the cursor descends again to the entry after (or before) the last one it
+// returned.
+BTREE_TEMPLATE
+void BTREE_CLASS::Cursor::step(bool forward) {
+    pair<Key, Value> last = forward ? entries_.back() : entries_.front();
+    for (int block = forward ? next_leaf_ : prev_leaf_; block != -1; block = forward ? next_leaf_ : prev_leaf_) {
+        Node* neighbour = tree_->pin_cached(block);
+        uint64_t version = 0;
+        if (!neighbour->latch.read_begin(version) || !leaf_->latch.validate(version_)) {
+            tree_->pool_->unpin(neighbour);
+            break;
+        }
+        if (!copy(neighbour, version)) {
+            break;
+        }
+        if (!entries_.empty()) {
+            index_ = forward ? 0 : entries_.size() - 1;
+            return;
+        }
+    }
+    if (forward ? next_leaf_ == -1 : prev_leaf_ == -1) {
+        release();
+        return;
+    }
+
+    const Key& key = last.first;
+    const Value& value = last.second;
+    auto route = [&key, &value](const Node* node) { return node->find_child(key, value); };
+    if (forward) {
+        *this = tree_->open_cursor(route, route, PLAIN_ENTRIES, false, nullptr);
+    } else {
+        *this = tree_->open_cursor(route, [&key, &value](const Node* leaf) {
+            return leaf->find_entry(key, value) - 1;
+        }, PLAIN_ENTRIES, false, nullptr);
+    }
+}
+
+BTREE_TEMPLATE
+void BTREE_CLASS::Cursor::release() {
+    if (leaf_) {
+        tree_->pool_->unpin(leaf_);
+        leaf_ = nullptr;
+    }
+}
+
+// A separator equal to key can have entries with the key on its left, so
+// the descent takes the child left of the first separator not less than
+// key. The leaf it ends in can stop short of the first such entry, which
+// the cursor then finds first in the next leaf.
+BTREE_TEMPLATE
+auto BTREE_CLASS::seek(const Key& key) -> Cursor {
+    auto route = [&key](const Node* node) { return node->find_key(key); };
+    return open_cursor(route, route, PLAIN_KEYS, false, nullptr);
+}
+
+BTREE_TEMPLATE
+auto BTREE_CLASS::first() -> Cursor {
+    auto route = [](const Node*) { return 0; };
+    return open_cursor(route, route, PLAIN_KEYS, true, nullptr);
+}
+
+BTREE_TEMPLATE
+auto BTREE_CLASS::last() -> Cursor {
+    return open_cursor([](const Node* node) { return node->key_count; },
+                       [](const Node* leaf) { return leaf->key_count - 1; }, PLAIN_KEYS, false, nullptr);
+}
+
+// Range query for flights between time ranges
+BTREE_TEMPLATE
+vector<pair<Key, Value>> BTREE_CLASS::range_query(const Key& low, const Key& high) {
+    vector<pair<Key, Value>> result;
+    if (Compare()(high, low)) {
+        return result;
+    }
+    auto route = [&low](const Node* node) { return node->find_key(low); };
+    for (Cursor cursor = open_cursor(route, route, PLAIN_KEYS, true, &high);
+         cursor.valid() && !Compare()(high, cursor.key()); cursor.next()) {
+        result.push_back({cursor.key(), cursor.value()});
+    }
+    return result;
+}
+
+// Get all flights in order
+BTREE_TEMPLATE
+vector<pair<Key, Value>> BTREE_CLASS::get_all() {
+    vector<pair<Key, Value>> result;
+    for (Cursor cursor = first(); cursor.valid(); cursor.next()) {
+        result.push_back({cursor.key(), cursor.value()});
+    }
+    return result;
+}
+
+// Asks storage to start reading the blocks a scan is about to visit that
+// the pool doesn't hold
+BTREE_TEMPLATE
+void BTREE_CLASS::prefetch(const vector<int>& blocks) {
+    vector<int> missing;
+    for (int block : blocks) {
+        if (!pool_->contains(block)) {
+            missing.push_back(block);
+        }
+    }
+    if (missing.size() > 1) {
+        storage_->prefetch(missing);
+    }
+}
+
+// Remove operation
+BTREE_TEMPLATE
+bool BTREE_CLASS::remove(const Key& key) {
+    Value value;
+    vector<int> path;
+    return search(key, value, path) && remove(key, value);
+}
+
+BTREE_TEMPLATE
+bool BTREE_CLASS::remove(const Key& key, const Value& value) {
+    lock_guard<mutex> lock(write_mutex_);
+    if (damaged_ || !contains(key, value)) {
+        return false;
+    }
+
+    // A separator replaced by borrowing can be longer than the one it
+    // replaces, so full nodes split on the way down, as many as insert may
+    // split
+    if (storage_->free_blocks() < static_cast<size_t>(height_) + 1) {
+        return false;
+    }
+
+    if (!root_->has_room()) {
+        split_root();
+    }
+
+    remove_key(root_, key, value);
+    flight_count_--;
+
+    if (root_->key_count == 0 && !root_->is_leaf) {
+        Node* new_root = fetch(root_->disk_pointers[0]);
+        storage_->set_root_block(new_root->block_index);
+        free_node(root_);
+        set_root(new_root);
+        height_--;
+    }
+
+    end_operation();
+    release_pins();
+
+    if (commit_policy_ == COMMIT_PER_OPERATION) {
+        commit();
+    }
+    return true;
+}
+
+// Every node the removal descends into has room for one more of the largest
+// entries, for a separator that grows or one from a split of its child.
+// Nodes under the fill threshold are soft; one only needs enough entries to
+// give one up, which any half of a split has. Separators are left alone
+// when their entry goes: they still divide the children correctly.
+BTREE_TEMPLATE
+void BTREE_CLASS::remove_key(Node* node, const Key& key, const Value& value) {
+    if (node->is_leaf) {
+        int idx = node->find_entry(key, value);
+        if (holds(node, idx, key, value)) {
+            latch(node);
+            node->remove_key(idx);
+            save_node(node);
+        }
+        return;
+    }
+
+    int idx = node->find_child(key, value);
+    Node* child = fetch(node->disk_pointers[idx]);
+
+    if (!child->has_room()) {
+        split_child(node, child);
+        idx = node->find_child(key, value);
+    } else if (child->is_deficient()) {
+        if (idx > 0) {
+            Node* left_sibling = fetch(node->disk_pointers[idx - 1]);
+
+            if (!left_sibling->is_deficient()) {
+                borrow_from_left(node, idx);
+            } else {
+                merge_children(node, idx - 1);
+                idx = idx - 1;
+            }
+        } else if (idx < node->key_count) {
+            Node* right_sibling = fetch(node->disk_pointers[idx + 1]);
+
+            if (!right_sibling->is_deficient()) {
+                borrow_from_right(node, idx);
+            } else {
+                merge_children(node, idx);
+            }
+        }
+    }
+
+    remove_key(fetch(node->disk_pointers[idx]), key, value);
+}
+
+// Leaves concatenate and the separator between them goes; internal nodes
+// take it down between their children
+BTREE_TEMPLATE
+void BTREE_CLASS::merge_children(Node* parent, int index) {
+    Node* left_child = fetch(parent->disk_pointers[index]);
+    Node* right_child = fetch(parent->disk_pointers[index + 1]);
+    latch(parent);
+    latch(left_child);
+    latch(right_child);
+    left_child->make_room(left_child->key_count + 1 + right_child->key_count);
+
+    if (!left_child->is_leaf) {
+        left_child->keys[left_child->key_count] = parent->keys[index];
+        left_child->values[left_child->key_count] = parent->values[index];
+        left_child->key_count++;
+    }
+
+    for (int i = 0; i < right_child->key_count; i++) {
+        left_child->keys[left_child->key_count + i] = right_child->keys[i];
+        left_child->values[left_child->key_count + i] = right_child->values[i];
+    }
+
+    if (!left_child->is_leaf) {
+        for (int i = 0; i <= right_child->key_count; i++) {
+            left_child->disk_pointers[left_child->key_count + i] = right_child->disk_pointers[i];
+        }
+    } else {
+        left_child->next_leaf = right_child->next_leaf;
+        relink_prev(right_child->next_leaf, left_child->block_index);
+    }
+
+    left_child->key_count += right_child->key_count;
+
+    parent->remove_key(index);
+
+    // remove_key shifted the right child's slot out; clear the stale last slot
+    parent->disk_pointers[parent->key_count + 1] = -1;
+
+    free_node(right_child);
+
+    save_node(left_child);
+    save_node(parent);
+}
+
+// A leaf takes its sibling's last entry, which becomes the separator; an
+// internal node rotates one through the parent
+BTREE_TEMPLATE
+void BTREE_CLASS::borrow_from_left(Node* parent, int index) {
+    Node* child = fetch(parent->disk_pointers[index]);
+    Node* left_sibling = fetch(parent->disk_pointers[index - 1]);
+    latch(parent);
+    latch(child);
+    latch(left_sibling);
+    child->make_room(child->key_count + 1);
+
+    for (int i = child->key_count; i > 0; i--) {
+        child->keys[i] = child->keys[i - 1];
+        child->values[i] = child->values[i - 1];
+    }
+    if (!child->is_leaf) {
+        for (int i = child->key_count + 1; i > 0; i--) {
+            child->disk_pointers[i] = child->disk_pointers[i - 1];
+        }
+    }
+
+    if (child->is_leaf) {
+        child->keys[0] = left_sibling->keys[left_sibling->key_count - 1];
+        child->values[0] = left_sibling->values[left_sibling->key_count - 1];
+    } else {
+        child->keys[0] = parent->keys[index - 1];
+        child->values[0] = parent->values[index - 1];
+        child->disk_pointers[0] = left_sibling->disk_pointers[left_sibling->key_count];
+    }
+
+    child->key_count++;
+
+    parent->keys[index - 1] = left_sibling->keys[left_sibling->key_count - 1];
+    parent->values[index - 1] = left_sibling->values[left_sibling->key_count - 1];
+    left_sibling->key_count--;
+
+    save_node(child);
+    save_node(left_sibling);
+    save_node(parent);
+}
+
+// A leaf takes its sibling's first entry and the sibling's new first
+// becomes the separator; an internal node rotates one through the parent
+BTREE_TEMPLATE
+void BTREE_CLASS::borrow_from_right(Node* parent, int index) {
+    Node* child = fetch(parent->disk_pointers[index]);
+    Node* right_sibling = fetch(parent->disk_pointers[index + 1]);
+    latch(parent);
+    latch(child);
+    latch(right_sibling);
+    child->make_room(child->key_count + 1);
+
+    if (child->is_leaf) {
+        child->keys[child->key_count] = right_sibling->keys[0];
+        child->values[child->key_count] = right_sibling->values[0];
+    } else {
+        child->keys[child->key_count] = parent->keys[index];
+        child->values[child->key_count] = parent->values[index];
+        child->disk_pointers[child->key_count + 1] = right_sibling->disk_pointers[0];
+    }
+
+    child->key_count++;
+
+    int first = child->is_leaf ? 1 : 0;   // Of the sibling's entries, the new separator
+    parent->keys[index] = right_sibling->keys[first];
+    parent->values[index] = right_sibling->values[first];
+
+    for (int i = 0; i < right_sibling->key_count - 1; i++) {
+        right_sibling->keys[i] = right_sibling->keys[i + 1];
+        right_sibling->values[i] = right_sibling->values[i + 1];
+    }
+    if (!right_sibling->is_leaf) {
+        for (int i = 0; i < right_sibling->key_count; i++) {
+            right_sibling->disk_pointers[i] = right_sibling->disk_pointers[i + 1];
+        }
+    }
+
+    right_sibling->key_count--;
+
+    save_node(child);
+    save_node(right_sibling);
+    save_node(parent);
+}
+
+BTREE_TEMPLATE
+void BTREE_CLASS::print_tree() {
+    lock_guard<mutex> lock(write_mutex_);
+    if (!root_) {
+        cout << "Tree is empty" << endl;
+        return;
+    }
+
+    // Queue blocks rather than nodes so a wide level isn't pinned all at once
+    queue<int> q;
+    q.push(root_->block_index);
+    int level = 0;
+
+    while (!q.empty()) {
+        int level_size = q.size();
+        cout << "Level " << level << ": ";
+
+        for (int i = 0; i < level_size; i++) {
+            Node* current = pin_cached(q.front());
+            q.pop();
+
+            cout << "[Block " << current->block_index << ": ";
+            for (int j = 0; j < current->key_count; j++) {
+                cout << current->keys[j] << "(" << current->values[j] << ")";
+                if (j < current->key_count - 1) cout << ",";
+            }
+            cout << "] ";
+
+            if (!current->is_leaf) {
+                for (int j = 0; j <= current->key_count; j++) {
+                    if (current->disk_pointers[j] != -1) {
+                        q.push(current->disk_pointers[j]);
+                    }
+                }
+            }
+            pool_->unpin(current);
+        }
+
+        cout << endl;
+        level++;
+    }
+}
+
+#undef BTREE_TEMPLATE
+#undef BTREE_CLASS
+
+#endif
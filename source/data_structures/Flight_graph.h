@@ -55,6 +55,20 @@ private:
     unordered_map<string, City> cities;
 
 public:
+    FlightGraph() = default;
+    FlightGraph(const FlightGraph&) = delete;
+    FlightGraph& operator=(const FlightGraph&) = delete;
+    
+    ~FlightGraph() {
+        for (auto& pair : adjacencyList) {
+            ListNode<Edge*>* current = pair.second.begin();
+            while (current != nullptr) {
+                delete current->data;
+                current = current->next;
+            }
+        }
+    }
+    
     // Add city to graph
     void addCity(const string& code, const string& name) {
         cities[code] = City(code, name);
@@ -84,17 +98,17 @@ public:
     }
     
     // Find shortest path (by distance) - RETURNS FULL RESULT
-    DijkstraResult findShortestPath(const string& start, const string& end) {
+    DijkstraResult findShortestPath(const string& start, const string& end) const {
         return findPathWithTotals(start, end, "distance");
     }
     
     // Find cheapest path (by price) - RETURNS FULL RESULT
-    DijkstraResult findCheapestPath(const string& start, const string& end) {
+    DijkstraResult findCheapestPath(const string& start, const string& end) const {
         return findPathWithTotals(start, end, "price");
     }
     
     // Find fastest path (by duration) - RETURNS FULL RESULT
-    DijkstraResult findFastestPath(const string& start, const string& end) {
+    DijkstraResult findFastestPath(const string& start, const string& end) const {
         return findPathWithTotals(start, end, "duration");
     }
     
@@ -203,8 +217,9 @@ public:
     
 private:
     // Dijkstra's algorithm that returns totals
+    // const so concurrent searches on a built graph need no lock
     DijkstraResult findPathWithTotals(const string& start, const string& end, 
-                                     const string& criterion) {
+                                     const string& criterion) const {
         DijkstraResult result;
         
         // Check if cities exist
@@ -254,7 +269,7 @@ private:
             
             // Explore neighbors
             if (adjacencyList.find(current.city) != adjacencyList.end()) {
-                ListNode<Edge*>* edgeNode = adjacencyList[current.city].begin();
+                ListNode<Edge*>* edgeNode = adjacencyList.at(current.city).begin();
                 while (edgeNode != nullptr) {
                     Edge* edge = edgeNode->data;
                     string neighbor = edge->to;
@@ -294,7 +309,7 @@ private:
     }
     
     // Calculate totals for a route
-    void calculateRouteTotals(DijkstraResult& result) {
+    void calculateRouteTotals(DijkstraResult& result) const {
         result.totalDistance = 0;
         result.totalPrice = 0;
         result.totalTime = 0;
@@ -305,7 +320,7 @@ private:
             string flight = result.flights[i];
             
             // Find this edge and get its values
-            ListNode<Edge*>* edgeNode = adjacencyList[from].begin();
+            ListNode<Edge*>* edgeNode = adjacencyList.at(from).begin();
             while (edgeNode != nullptr) {
                 Edge* edge = edgeNode->data;
                 if (edge->to == to && edge->flightNumber == flight) {
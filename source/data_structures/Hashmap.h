@@ -42,6 +42,21 @@ private:
         return hashFunc(key) % capacity;
     }
     
+    // Doubles the bucket count once the average chain passes the load
+    // factor, so lookups stay O(1) as the map grows
+    void rehash(int newCapacity) {
+        vector<LinkedList<HashNode<K, V>>> newTable(newCapacity);
+        for (int i = 0; i < capacity; i++) {
+            ListNode<HashNode<K, V>>* current = table[i].begin();
+            while (current != nullptr) {
+                newTable[hash<K>()(current->data.key) % newCapacity].add(current->data);
+                current = current->next;
+            }
+        }
+        table.swap(newTable);   // Swaps buffers; no list is copied
+        capacity = newCapacity;
+    }
+    
 public:
     HashMap(int cap = 100) : capacity(cap), size(0) {
         table.resize(capacity);
@@ -60,6 +75,9 @@ public:
         } else {
             table[index].add(temp);   // Insert new
             size++;
+            if (size > capacity * 3 / 4) {
+                rehash(capacity * 2);
+            }
         }
     }
     
@@ -77,6 +95,13 @@ public:
         return nullptr;
     }
     
+    const V* get(const K& key) const {
+        int index = hashFunction(key);
+        HashNode<K, V> dummy(key, V());
+        const HashNode<K, V>* node = table[index].get(dummy);
+        return node != nullptr ? &(node->value) : nullptr;
+    }
+    
     // Check if key exists
     bool contains(const K& key) const {
         int index = hashFunction(key);
@@ -129,6 +154,18 @@ public:
         return result;
     }
     
+    // Visit every pair in place, in bucket order
+    template <typename Fn>
+    void forEach(Fn fn) const {
+        for (int i = 0; i < capacity; i++) {
+            const ListNode<HashNode<K, V>>* current = table[i].begin();
+            while (current != nullptr) {
+                fn(current->data.key, current->data.value);
+                current = current->next;
+            }
+        }
+    }
+    
     // Print for debugging
     void print() const {
         cout << "\n=== Hash Map (Size: " << size << ") ===" << endl;
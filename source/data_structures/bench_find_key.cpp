@@ -0,0 +1,89 @@
+// Microbenchmark for BTreeNode::find_key, the search run at every level of a
+// B-Tree descent. Compares the original linear scan with the branch-free
+// binary search and the vectorized kernel on full and half-full nodes.
+//
+// Build: make bench   (or g++ -std=c++17 -O2 bench_find_key.cpp node.cpp)
+
+#include "node.h"
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <random>
+#include <vector>
+#include <algorithm>
+
+using namespace std;
+
+// The scan find_key used before
+static int search_linear(const int* keys, int count, int key) {
+    int idx = 0;
+    while (idx < count && keys[idx] < key) {
+        idx++;
+    }
+    return idx;
+}
+
+typedef int (*Kernel)(const int* keys, int count, int key);
+
+static const int NODES = 1024;          // Enough nodes that the predictor can't learn the keys
+static const int QUERIES = 1 << 20;
+static const int LOOKUPS = 4 * QUERIES;
+
+static volatile long long sink;         // Keeps the searches from being optimized away
+
+static double nanos_per_search(Kernel kernel, const vector<vector<int>>& nodes, int count,
+                               const vector<int>& queries) {
+    long long checksum = 0;
+    auto start = chrono::steady_clock::now();
+    for (int i = 0; i < LOOKUPS; i++) {
+        const vector<int>& keys = nodes[i & (NODES - 1)];
+        checksum += kernel(keys.data(), count, queries[i & (QUERIES - 1)]);
+    }
+    auto elapsed = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count();
+
+    sink = checksum;
+    return elapsed / LOOKUPS;
+}
+
+int main() {
+    mt19937 rng(42);
+
+    cout << "find_key kernel on this CPU: " << KeySearch::search_kernel() << endl;
+    cout << fixed << setprecision(2);
+
+    // A full leaf of int keys with inline flight numbers, and a half-full one
+    const int full = NodeLayout<Codec<int>, Codec<FixedString<8>>>::MAX_ENTRIES;
+    for (int count : {full, full / 2}) {
+        // Sorted distinct departure-like keys per node
+        vector<vector<int>> nodes(NODES, vector<int>(full));
+        for (auto& keys : nodes) {
+            for (int i = 0; i < count; i++) keys[i] = rng() % 2000000;
+            sort(keys.begin(), keys.begin() + count);
+        }
+        vector<int> queries(QUERIES);
+        for (auto& query : queries) query = rng() % 2000000;
+
+        // Every kernel must agree with the scan
+        for (int i = 0; i < 100000; i++) {
+            const vector<int>& keys = nodes[i & (NODES - 1)];
+            int expected = search_linear(keys.data(), count, queries[i]);
+            if (KeySearch::search_binary(keys.data(), count, queries[i]) != expected ||
+                KeySearch::search_vector(keys.data(), count, queries[i]) != expected) {
+                cout << "Kernel mismatch for key " << queries[i] << endl;
+                return 1;
+            }
+        }
+
+        double linear = nanos_per_search(search_linear, nodes, count, queries);
+        double binary = nanos_per_search(KeySearch::search_binary, nodes, count, queries);
+        double simd = nanos_per_search(KeySearch::search_vector, nodes, count, queries);
+
+        cout << "\n" << count << " keys per node (ns per level)" << endl;
+        cout << "  linear: " << setw(6) << linear << endl;
+        cout << "  binary: " << setw(6) << binary << "  (" << linear / binary << "x)" << endl;
+        cout << "  " << KeySearch::search_kernel() << ":" << string(6 - string(KeySearch::search_kernel()).size(), ' ')
+             << setw(6) << simd << "  (" << linear / simd << "x)" << endl;
+    }
+
+    return 0;
+}
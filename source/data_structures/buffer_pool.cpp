@@ -0,0 +1,297 @@
+#include "buffer_pool.h"
+#include <algorithm>
+
+using namespace std;
+
+BufferPool::BufferPool(NodeLoader load_node, size_t budget_bytes, size_t node_bytes)
+    : load_node_(load_node),
+      node_bytes_(node_bytes),
+      max_frames_(max<size_t>(budget_bytes / node_bytes, 1)),
+      frame_chunks_(MAX_BLOCKS / FRAME_CHUNK),
+      index_(MAX_BLOCKS / INDEX_CHUNK),
+      frame_count_(0),
+      hand_(0),
+      resident_(0),
+      misses_(0),
+      evictions_(0) {
+    for (Counter& counter : hits_) {
+        counter.value = 0;
+    }
+}
+
+BufferPool::~BufferPool() {
+    for (size_t slot = 0; slot < frame_count_; slot++) {
+        delete frame(slot).node;
+    }
+    for (auto& chunk : frame_chunks_) {
+        delete[] chunk.load();
+    }
+    for (auto& chunk : index_) {
+        delete[] chunk.load();
+    }
+}
+
+NodeBase* BufferPool::pin(int block_index) {
+    NodeBase* node = try_pin(block_index);
+    if (node) {
+        count_hit();
+        return node;
+    }
+
+    unique_lock<mutex> lock(mutex_);
+    for (int slot = indexed_slot(block_index); slot >= 0; slot = indexed_slot(block_index)) {
+        Frame& frame = this->frame(slot);
+        if (frame.loading) {
+            loaded_.wait(lock);
+            continue;
+        }
+        // Indexed and loaded, so not being emptied either
+        frame.pins.fetch_add(1);
+        frame.referenced = true;
+        count_hit();
+        return frame.node;
+    }
+
+    misses_++;
+    size_t slot = take_slot();
+    Frame& frame = this->frame(slot);
+    frame.loading = true;
+    frame.block = block_index;
+    set_index(block_index, slot);
+    resident_++;
+    lock.unlock();
+
+    node = load_node_(block_index);
+
+    lock.lock();
+    install(node, slot);
+    frame.loading = false;
+    loaded_.notify_all();
+    return node;
+}
+
+NodeBase* BufferPool::pin(NodeBase* node) {
+    frame(node->pool_slot).pins.fetch_add(1);
+    return node;
+}
+
+NodeBase* BufferPool::pin_new(NodeBase* node) {
+    unique_lock<mutex> lock(mutex_);
+    drop(node->block_index, lock);
+    size_t slot = take_slot();
+    install(node, slot);
+    set_index(node->block_index, slot);
+    resident_++;
+    return node;
+}
+
+void BufferPool::unpin(NodeBase* node) {
+    release_pin(node->pool_slot);
+}
+
+void BufferPool::discard(NodeBase* node) {
+    lock_guard<mutex> lock(mutex_);
+    discard_slot(node->pool_slot);
+}
+
+void BufferPool::drop(int block_index) {
+    unique_lock<mutex> lock(mutex_);
+    drop(block_index, lock);
+}
+
+bool BufferPool::contains(int block_index) const {
+    return indexed_slot(block_index) >= 0;
+}
+
+BufferPool::Stats BufferPool::stats() const {
+    lock_guard<mutex> lock(mutex_);
+    Stats stats;
+    stats.hits = 0;
+    for (const Counter& counter : hits_) {
+        stats.hits += counter.value.load(memory_order_relaxed);
+    }
+    stats.misses = misses_;
+    stats.evictions = evictions_;
+    stats.resident_bytes = resident_ * node_bytes_;
+    stats.budget_bytes = max_frames_ * node_bytes_;
+    return stats;
+}
+
+auto BufferPool::frame(size_t slot) const -> Frame& {
+    return frame_chunks_[slot / FRAME_CHUNK].load(memory_order_acquire)[slot % FRAME_CHUNK];
+}
+
+int BufferPool::indexed_slot(int block_index) const {
+    if (block_index < 0 || static_cast<size_t>(block_index) >= MAX_BLOCKS) {
+        return -1;
+    }
+    atomic<int>* entries = index_[block_index / INDEX_CHUNK].load(memory_order_acquire);
+    return entries ? entries[block_index % INDEX_CHUNK].load(memory_order_acquire) : -1;
+}
+
+// Under mutex_. Blocks past what the bitmap tracks are never indexed, so
+// they miss every time.
+void BufferPool::set_index(int block_index, int slot) {
+    if (block_index < 0 || static_cast<size_t>(block_index) >= MAX_BLOCKS) {
+        return;
+    }
+    atomic<atomic<int>*>& chunk = index_[block_index / INDEX_CHUNK];
+    atomic<int>* entries = chunk.load(memory_order_relaxed);
+    if (!entries) {
+        entries = new atomic<int>[INDEX_CHUNK];
+        for (size_t i = 0; i < INDEX_CHUNK; i++) {
+            entries[i].store(-1, memory_order_relaxed);
+        }
+        chunk.store(entries, memory_order_release);
+    }
+    entries[block_index % INDEX_CHUNK].store(slot, memory_order_release);
+}
+
+// A slot read from the index can be emptied and reused before the pin
+// lands, so the pin only counts once the frame is seen to still hold the
+// block
+NodeBase* BufferPool::try_pin(int block_index) {
+    int slot = indexed_slot(block_index);
+    if (slot < 0) {
+        return nullptr;
+    }
+
+    Frame& frame = this->frame(slot);
+    int pins = frame.pins.load(memory_order_relaxed);
+    do {
+        if (pins < 0) {
+            return nullptr;
+        }
+    } while (!frame.pins.compare_exchange_weak(pins, pins + 1, memory_order_acquire, memory_order_relaxed));
+
+    if (frame.block.load(memory_order_relaxed) != block_index || frame.discarded) {
+        release_pin(slot);
+        return nullptr;
+    }
+    if (!frame.referenced.load(memory_order_relaxed)) {
+        frame.referenced.store(true, memory_order_relaxed);
+    }
+    return frame.node;
+}
+
+// The last pin of a discarded frame frees it, and the last pin of any frame
+// gives back what a fully pinned pool had to borrow
+void BufferPool::release_pin(size_t slot) {
+    Frame& frame = this->frame(slot);
+    if (frame.pins.fetch_sub(1) > 1 || (!frame.discarded && resident_ <= max_frames_)) {
+        return;
+    }
+
+    lock_guard<mutex> lock(mutex_);
+    int unpinned = 0;
+    if (frame.discarded && frame.pins.compare_exchange_strong(unpinned, -1)) {
+        release_slot(slot);
+    }
+    while (resident_ > max_frames_ && evict_one()) {
+    }
+}
+
+void BufferPool::count_hit() {
+    static atomic<unsigned> next_shard(0);
+    thread_local unsigned shard = next_shard++ % HIT_SHARDS;
+    hits_[shard].value.fetch_add(1, memory_order_relaxed);
+}
+
+size_t BufferPool::take_slot() {
+    if (resident_ >= max_frames_) {
+        evict_one();    // Grows past the budget when nothing can go
+    }
+
+    if (!free_slots_.empty()) {
+        size_t slot = free_slots_.back();
+        free_slots_.pop_back();
+        return slot;
+    }
+    size_t slot = frame_count_++;
+    if (slot % FRAME_CHUNK == 0) {
+        frame_chunks_[slot / FRAME_CHUNK].store(new Frame[FRAME_CHUNK], memory_order_release);
+    }
+    return slot;
+}
+
+// The frame is published with its first pin, so a hit that sees the count
+// sees the node too
+void BufferPool::install(NodeBase* node, size_t slot) {
+    Frame& frame = this->frame(slot);
+    node->pool_slot = slot;
+    frame.node = node;
+    frame.block.store(node->block_index, memory_order_relaxed);
+    frame.referenced = true;
+    frame.discarded = false;
+    frame.pins.store(1, memory_order_release);
+}
+
+// The block may be allocated again right away, so it leaves the index now
+void BufferPool::discard_slot(size_t slot) {
+    Frame& frame = this->frame(slot);
+    frame.node->latch.mark_obsolete();
+    if (indexed_slot(frame.node->block_index) == static_cast<int>(slot)) {
+        set_index(frame.node->block_index, -1);
+    }
+    frame.discarded = true;
+
+    int unpinned = 0;
+    if (frame.pins.compare_exchange_strong(unpinned, -1)) {
+        release_slot(slot);
+    }
+}
+
+void BufferPool::drop(int block_index, unique_lock<mutex>& lock) {
+    for (int slot = indexed_slot(block_index); slot >= 0; slot = indexed_slot(block_index)) {
+        if (frame(slot).loading) {
+            loaded_.wait(lock);
+            continue;
+        }
+        discard_slot(slot);
+        return;
+    }
+}
+
+// The frame's count is already -1, so no hit can take it
+void BufferPool::release_slot(size_t slot) {
+    Frame& frame = this->frame(slot);
+    delete frame.node;
+    frame.node = nullptr;
+    frame.block = -1;
+    frame.referenced = false;
+    frame.discarded = false;
+    free_slots_.push_back(slot);
+    resident_--;
+}
+
+// Discarded frames whose last unpin raced their discard are picked up on
+// the way
+bool BufferPool::evict_one() {
+    // Two full turns: the first may do nothing but clear reference bits
+    for (size_t step = 0; step < 2 * frame_count_; step++) {
+        size_t slot = hand_;
+        hand_ = (hand_ + 1) % frame_count_;
+
+        Frame& frame = this->frame(slot);
+        if (frame.pins != 0) {
+            continue;   // Pinned, free or loading
+        }
+        bool discarded = frame.discarded;
+        if (!discarded && frame.referenced) {
+            frame.referenced = false;
+            continue;
+        }
+
+        int unpinned = 0;
+        if (!frame.pins.compare_exchange_strong(unpinned, -1)) {
+            continue;   // Pinned by a hit just now
+        }
+        if (!discarded) {
+            set_index(frame.node->block_index, -1);
+            evictions_++;
+        }
+        release_slot(slot);
+        return true;
+    }
+    return false;
+}
@@ -0,0 +1,116 @@
+#ifndef BUFFER_POOL_H
+#define BUFFER_POOL_H
+
+#include "node.h"
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <cstddef>
+
+// Page cache for B-Tree nodes of any key and value type, keyed by block index.
+//
+// Every node the tree touches lives in a frame here, so each block has at
+// most one in-memory copy. A frame can be evicted once it is unpinned: the
+// tree saves a snapshot of every change, and the node loader it supplies
+// prefers queued snapshots over the file. Victims are picked with CLOCK:
+// a hit sets the frame's reference bit and the hand clears bits until it
+// finds a frame that was not used since its last pass.
+//
+// The byte budget is counted in frames of node_bytes, what one node takes
+// in memory. When every frame is pinned the pool grows past it and shrinks
+// back as pins are released.
+//
+// Any number of threads pin and unpin at once. A hit takes no lock: the
+// block's slot comes from an index of atomics and the pin is a
+// compare-and-swap on the frame's count, which a frame being emptied holds
+// at -1. Misses, evictions and discards take the pool's mutex, and a miss
+// reads its block outside it, behind a placeholder that other pins of the
+// block wait on.
+class BufferPool {
+public:
+    struct Stats {
+        size_t hits;
+        size_t misses;
+        size_t evictions;
+        size_t resident_bytes;
+        size_t budget_bytes;
+    };
+
+    typedef std::function<NodeBase*(int block_index)> NodeLoader;   // Reads a block into a new node
+
+    BufferPool(NodeLoader load_node, size_t budget_bytes, size_t node_bytes);
+    ~BufferPool();
+
+    NodeBase* pin(int block_index);         // Reads the block on a miss
+    NodeBase* pin(NodeBase* node);          // One more pin on a node already pinned
+    NodeBase* pin_new(NodeBase* node);      // Freshly allocated block, nothing to read; the pool owns node
+    void unpin(NodeBase* node);
+
+    // The block was freed: the node is marked obsolete for optimistic
+    // readers and goes with its last pin. drop does the same for whatever
+    // the pool holds of a block, which readers following a stale link can
+    // have loaded while it was free.
+    void discard(NodeBase* node);
+    void drop(int block_index);
+    bool contains(int block_index) const;
+
+    Stats stats() const;
+
+private:
+    struct alignas(64) Frame {
+        std::atomic<int> pins;          // -1 while the slot is free, loading or being emptied
+        std::atomic<int> block;
+        std::atomic<bool> referenced;
+        std::atomic<bool> discarded;
+        NodeBase* node;                 // Set under mutex_, stable while pinned
+        bool loading;                   // Under mutex_
+
+        Frame() : pins(-1), block(-1), referenced(false), discarded(false), node(nullptr), loading(false) {}
+    };
+
+    // Hits are counted per thread group so the counter isn't contended
+    struct alignas(64) Counter {
+        std::atomic<size_t> value;
+    };
+
+    // Frames and index entries come in chunks that never move once made,
+    // so lock-free hits can reach them while the pool grows
+    static const size_t FRAME_CHUNK = 1024;
+    static const size_t INDEX_CHUNK = 4096;
+    static const size_t MAX_BLOCKS = static_cast<size_t>(SUPERBLOCK_BLOCKS) * BLOCK_SIZE * 8;  // As many as the bitmap tracks
+    static const int HIT_SHARDS = 16;
+
+    NodeLoader load_node_;
+    size_t node_bytes_;
+    size_t max_frames_;
+    std::vector<std::atomic<Frame*>> frame_chunks_;     // The CLOCK ring
+    std::vector<std::atomic<std::atomic<int>*>> index_; // Block -> frame slot, -1 if none
+    mutable std::mutex mutex_;
+    std::condition_variable loaded_;
+    std::vector<size_t> free_slots_;
+    size_t frame_count_;
+    size_t hand_;
+    std::atomic<size_t> resident_;
+    Counter hits_[HIT_SHARDS];
+    size_t misses_;
+    size_t evictions_;
+
+    Frame& frame(size_t slot) const;
+    int indexed_slot(int block_index) const;
+    void set_index(int block_index, int slot);
+    NodeBase* try_pin(int block_index);
+    void release_pin(size_t slot);
+    void count_hit();
+
+    // Under mutex_
+    size_t take_slot();
+    void install(NodeBase* node, size_t slot);
+    void discard_slot(size_t slot);
+    void drop(int block_index, std::unique_lock<std::mutex>& lock);
+    void release_slot(size_t slot);
+    bool evict_one();
+};
+
+#endif
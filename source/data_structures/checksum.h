@@ -0,0 +1,50 @@
+#ifndef CHECKSUM_H
+#define CHECKSUM_H
+
+#include <cstdint>
+#include <cstddef>
+
+// Slicing-by-8 tables: entries[0] is the classic byte table, and
+// entries[k][b] is the CRC of byte b followed by k zero bytes, so eight
+// lookups advance the CRC over eight bytes at once
+struct Crc32Table {
+    uint32_t entries[8][256];
+
+    Crc32Table() {
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; k++) {
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            }
+            entries[0][i] = c;
+        }
+        for (uint32_t i = 0; i < 256; i++) {
+            for (int k = 1; k < 8; k++) {
+                entries[k][i] = entries[0][entries[k - 1][i] & 0xFF] ^ (entries[k - 1][i] >> 8);
+            }
+        }
+    }
+};
+
+// CRC-32 (IEEE), used to spot torn or stale records and damaged pages on
+// disk. Chain calls by passing the previous result as crc.
+inline uint32_t crc32(const void* data, size_t length, uint32_t crc = 0) {
+    static const Crc32Table table;  // Built once, thread-safe
+
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    crc = ~crc;
+    for (; length >= 8; length -= 8, bytes += 8) {
+        uint32_t low = (bytes[0] | bytes[1] << 8 | bytes[2] << 16 | static_cast<uint32_t>(bytes[3]) << 24) ^ crc;
+        uint32_t high = bytes[4] | bytes[5] << 8 | bytes[6] << 16 | static_cast<uint32_t>(bytes[7]) << 24;
+        crc = table.entries[7][low & 0xFF] ^ table.entries[6][(low >> 8) & 0xFF] ^
+              table.entries[5][(low >> 16) & 0xFF] ^ table.entries[4][low >> 24] ^
+              table.entries[3][high & 0xFF] ^ table.entries[2][(high >> 8) & 0xFF] ^
+              table.entries[1][(high >> 16) & 0xFF] ^ table.entries[0][high >> 24];
+    }
+    for (; length > 0; length--, bytes++) {
+        crc = table.entries[0][(crc ^ *bytes) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+#endif
@@ -0,0 +1,165 @@
+#ifndef CODEC_H
+#define CODEC_H
+
+#include "constants.h"
+#include <string>
+#include <utility>
+#include <ostream>
+#include <algorithm>
+#include <type_traits>
+#include <cstring>
+#include <cstdint>
+
+// How a tree stores its keys and values in a block. A codec tells the
+// fewest and most bytes a value can take, which node layouts are bounded by,
+// the bytes a given value takes, and copies values in and out of a buffer.
+// Its type tag and byte bounds are recorded in the file, which no tree with
+// a different key or value codec will open:
+//
+//   static const uint32_t TYPE_TAG;
+//   static const int MIN_BYTES;
+//   static const int MAX_BYTES;
+//   static bool fits(const T& value);              // Whether it can be stored
+//   static int size(const T& value);               // Bytes encode will write
+//   static int encode(const T& value, char* out);  // Returns bytes written
+//   static int decode(const char* in, int available, T& value);
+//
+// decode reads at most available bytes and returns how many it read, or -1
+// when they don't hold a value, so a damaged block is caught before it is
+// decoded.
+//
+// Codec<T> covers arithmetic types, FixedString, pairs of those (composite
+// keys) and std::string. Other types need a specialization, or a codec
+// handed to BTree.
+template <typename T, typename Enable = void>
+struct Codec;
+
+// Short string stored inline, N bytes zero padded, such as a flight number.
+// Orders and compares like the string it holds.
+template <int N>
+class FixedString {
+public:
+    FixedString() { memset(data_, 0, N); }
+    explicit FixedString(const std::string& s) {   // Cut to N bytes; check fits first
+        memset(data_, 0, N);
+        memcpy(data_, s.data(), std::min<size_t>(s.size(), N));
+    }
+
+    static bool fits(const std::string& s) { return s.size() <= static_cast<size_t>(N); }
+    std::string str() const { return std::string(data_, strnlen(data_, N)); }
+    const char* data() const { return data_; }
+    char* data() { return data_; }
+
+    bool operator<(const FixedString& other) const { return memcmp(data_, other.data_, N) < 0; }
+    bool operator>(const FixedString& other) const { return other < *this; }
+    bool operator<=(const FixedString& other) const { return !(other < *this); }
+    bool operator==(const FixedString& other) const { return memcmp(data_, other.data_, N) == 0; }
+    bool operator!=(const FixedString& other) const { return !(*this == other); }
+
+    friend std::ostream& operator<<(std::ostream& os, const FixedString& s) { return os << s.str(); }
+
+private:
+    char data_[N];
+};
+
+// Fixed-width types are stored as their bytes
+template <typename T>
+struct Codec<T, typename std::enable_if<std::is_arithmetic<T>::value>::type> {
+    static const uint32_t TYPE_TAG =
+        (std::is_floating_point<T>::value ? 'f' : std::is_signed<T>::value ? 'i' : 'u') << 24 | sizeof(T);
+    static const int MIN_BYTES = sizeof(T);
+    static const int MAX_BYTES = sizeof(T);
+
+    static bool fits(const T&) { return true; }
+    static int size(const T&) { return sizeof(T); }
+    static int encode(const T& value, char* out) {
+        memcpy(out, &value, sizeof(T));
+        return sizeof(T);
+    }
+    static int decode(const char* in, int available, T& value) {
+        if (available < static_cast<int>(sizeof(T))) {
+            return -1;
+        }
+        memcpy(&value, in, sizeof(T));
+        return sizeof(T);
+    }
+};
+
+template <int N>
+struct Codec<FixedString<N>> {
+    static const uint32_t TYPE_TAG = 's' << 24 | N;
+    static const int MIN_BYTES = N;
+    static const int MAX_BYTES = N;
+
+    static bool fits(const FixedString<N>&) { return true; }
+    static int size(const FixedString<N>&) { return N; }
+    static int encode(const FixedString<N>& value, char* out) {
+        memcpy(out, value.data(), N);
+        return N;
+    }
+    static int decode(const char* in, int available, FixedString<N>& value) {
+        if (available < N) {
+            return -1;
+        }
+        memcpy(value.data(), in, N);
+        return N;
+    }
+};
+
+// Composite keys: the two halves back to back, ordered as std::pair orders
+template <typename A, typename B>
+struct Codec<std::pair<A, B>> {
+    static const uint32_t TYPE_TAG = ('p' << 24) ^ (Codec<A>::TYPE_TAG * 31 + Codec<B>::TYPE_TAG);
+    static const int MIN_BYTES = Codec<A>::MIN_BYTES + Codec<B>::MIN_BYTES;
+    static const int MAX_BYTES = Codec<A>::MAX_BYTES + Codec<B>::MAX_BYTES;
+
+    static bool fits(const std::pair<A, B>& value) {
+        return Codec<A>::fits(value.first) && Codec<B>::fits(value.second);
+    }
+    static int size(const std::pair<A, B>& value) {
+        return Codec<A>::size(value.first) + Codec<B>::size(value.second);
+    }
+    static int encode(const std::pair<A, B>& value, char* out) {
+        int bytes = Codec<A>::encode(value.first, out);
+        return bytes + Codec<B>::encode(value.second, out + bytes);
+    }
+    static int decode(const char* in, int available, std::pair<A, B>& value) {
+        int first = Codec<A>::decode(in, available, value.first);
+        int second = first < 0 ? -1 : Codec<B>::decode(in + first, available - first, value.second);
+        return second < 0 ? -1 : first + second;
+    }
+};
+
+// Length-prefixed strings of up to MAX_VALUE_SIZE bytes, the format int ->
+// string trees have always had on disk
+template <>
+struct Codec<std::string> {
+    static const uint32_t TYPE_TAG = 'v' << 24;
+    static const int MIN_BYTES = sizeof(int32_t);
+    static const int MAX_BYTES = sizeof(int32_t) + MAX_VALUE_SIZE;
+
+    static bool fits(const std::string& value) {
+        return value.size() <= static_cast<size_t>(MAX_VALUE_SIZE);
+    }
+    static int size(const std::string& value) { return sizeof(int32_t) + value.size(); }
+    static int encode(const std::string& value, char* out) {
+        int32_t length = value.size();
+        memcpy(out, &length, sizeof(length));
+        memcpy(out + sizeof(length), value.data(), length);
+        return sizeof(length) + length;
+    }
+    static int decode(const char* in, int available, std::string& value) {
+        int32_t length;
+        if (available < static_cast<int>(sizeof(length))) {
+            return -1;
+        }
+        memcpy(&length, in, sizeof(length));
+        if (length < 0 || length > MAX_VALUE_SIZE || length > available - static_cast<int>(sizeof(length))) {
+            return -1;
+        }
+        value.assign(in + sizeof(length), length);
+        return sizeof(length) + length;
+    }
+};
+
+#endif
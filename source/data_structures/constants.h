@@ -1,8 +1,42 @@
 #ifndef CONSTANTS_H
 #define CONSTANTS_H
 
+#include <cstddef>
+
 // Define all constants in one place
 const int BLOCK_SIZE = 4096;  // 4KB blocks
-const int M = 50;             // B-Tree order (adjusted for key-value pairs)
+
+// Longest string value. Files written before nodes became slotted pages had
+// 50-way int -> string nodes sized for values this long.
+const int MAX_VALUE_SIZE = 71;
+
+// Default memory budget of a tree's node cache
+const size_t DEFAULT_CACHE_BYTES = 16 * 1024 * 1024;
+
+// How long the writer lets saves coalesce before flushing a batch
+const int WRITE_BACK_DELAY_MS = 5;
+
+// Default spacing of commits under COMMIT_INTERVAL
+const int DEFAULT_COMMIT_INTERVAL_MS = 50;
+
+// Blocks at the front of a storage file kept for the superblock: its header
+// and the allocation bitmap. 64 blocks track about 2M blocks (8 GB of nodes).
+const int SUPERBLOCK_BLOCKS = 64;
+
+// Memory-mapped storage files grow by this much at a time
+const size_t MAP_EXTENT_BYTES = 16 * 1024 * 1024;
+
+// Bulk loads write the nodes they build in batches of this many blocks
+const int BULK_WRITE_BLOCKS = 256;
+
+// Memory an unsorted bulk load sorts in before it spills a run to disk
+const size_t BULK_LOAD_RUN_BYTES = 64 * 1024 * 1024;
+
+// How full the leaves are when a file from before entries moved to the
+// leaves is rebuilt; the slack takes inserts without splitting right away
+const double REBUILD_FILL_FACTOR = 0.8;
+
+// Write-ahead log size that triggers a checkpoint. Bounds recovery time.
+const size_t WAL_CHECKPOINT_BYTES = 8 * 1024 * 1024;
 
 #endif
\ No newline at end of file
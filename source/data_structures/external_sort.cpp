@@ -0,0 +1,35 @@
+#include "external_sort.h"
+#include <iostream>
+
+using namespace std;
+
+SortRunWriter::SortRunWriter(const string& filename)
+    : filename_(filename),
+      out_(filename, ios::binary | ios::trunc) {
+}
+
+void SortRunWriter::add(const char* data, uint32_t length) {
+    out_.write(reinterpret_cast<const char*>(&length), sizeof(length));
+    out_.write(data, length);
+}
+
+bool SortRunWriter::close() {
+    out_.close();
+    if (!out_) {
+        cerr << "Failed to write sort run: " << filename_ << endl;
+        return false;
+    }
+    return true;
+}
+
+SortRunReader::SortRunReader(const string& filename) : in_(filename, ios::binary) {
+}
+
+bool SortRunReader::next() {
+    uint32_t length = 0;
+    if (!in_.read(reinterpret_cast<char*>(&length), sizeof(length))) {
+        return false;
+    }
+    record_.resize(length);
+    return length == 0 || static_cast<bool>(in_.read(record_.data(), length));
+}
@@ -0,0 +1,228 @@
+#ifndef EXTERNAL_SORT_H
+#define EXTERNAL_SORT_H
+
+#include "codec.h"
+#include <string>
+#include <vector>
+#include <memory>
+#include <queue>
+#include <fstream>
+#include <utility>
+#include <algorithm>
+#include <functional>
+#include <cstdio>
+#include <cstdint>
+#include <cstddef>
+
+// Spilled runs are files of records, each a byte count and that many bytes
+class SortRunWriter {
+public:
+    explicit SortRunWriter(const std::string& filename);
+    void add(const char* data, uint32_t length);
+    bool close();   // False if anything failed to reach the file
+
+private:
+    std::string filename_;
+    std::ofstream out_;
+};
+
+class SortRunReader {
+public:
+    explicit SortRunReader(const std::string& filename);
+    bool next();    // Steps to the next record; false past the last
+    const char* data() const { return record_.data(); }
+    int size() const { return record_.size(); }
+
+private:
+    std::ifstream in_;
+    std::vector<char> record_;
+};
+
+// Sorts (key, value) entries that need not fit in memory, for bulk loading.
+//
+// Entries collect into a run until it holds run_bytes; the run is then
+// sorted and spilled to <spill_prefix>.run<N>, encoded with the tree's
+// codecs. Merging streams the runs back in (key, value) order, the tree's
+// entry order, through a heap, so memory stays at one run plus a read
+// buffer per run. An entry added more than once comes out once.
+template <typename Key, typename Value, typename Compare = std::less<Key>,
+          typename KeyCodec = Codec<Key>, typename ValueCodec = Codec<Value>>
+class ExternalSorter {
+public:
+    typedef std::function<bool(const Key& key, const Value& value)> EntryHandler;
+
+    ExternalSorter(const std::string& spill_prefix, size_t run_bytes)
+        : spill_prefix_(spill_prefix), run_bytes_(run_bytes), run_size_(0), count_(0), max_entry_bytes_(0) {}
+    ~ExternalSorter();  // Removes the run files
+
+    bool add(const Key& key, const Value& value);
+
+    // Ends input. Counting distinct entries takes a merge pass when runs were
+    // spilled, so builders that need the total up front get it from count.
+    bool finish();
+    uint64_t count() const { return count_; }
+    int max_entry_bytes() const { return max_entry_bytes_; }   // Encoded key and value of the largest entry
+
+    // Hands every distinct entry to handle in order, until it returns
+    // false. May run more than once.
+    bool merge(const EntryHandler& handle);
+
+private:
+    typedef std::pair<Key, Value> Entry;
+
+    std::string spill_prefix_;
+    size_t run_bytes_;
+    std::vector<Entry> run_;    // Entries not yet spilled
+    size_t run_size_;
+    std::vector<std::string> run_files_;
+    uint64_t count_;
+    int max_entry_bytes_;
+
+    void sort_run();
+    bool spill_run();
+
+    static bool entry_less(const Entry& a, const Entry& b) {
+        Compare less;
+        if (less(a.first, b.first) || less(b.first, a.first)) {
+            return less(a.first, b.first);
+        }
+        return a.second < b.second;
+    }
+    static bool same_entry(const Entry& a, const Entry& b) {
+        return !entry_less(a, b) && !entry_less(b, a);
+    }
+
+    // Memory an entry holds besides itself
+    static size_t heap_bytes(const std::string& value) { return value.size(); }
+    template <typename T>
+    static size_t heap_bytes(const T&) { return 0; }
+};
+
+template <typename Key, typename Value, typename Compare, typename KeyCodec, typename ValueCodec>
+ExternalSorter<Key, Value, Compare, KeyCodec, ValueCodec>::~ExternalSorter() {
+    for (const std::string& filename : run_files_) {
+        std::remove(filename.c_str());
+    }
+}
+
+template <typename Key, typename Value, typename Compare, typename KeyCodec, typename ValueCodec>
+bool ExternalSorter<Key, Value, Compare, KeyCodec, ValueCodec>::add(const Key& key, const Value& value) {
+    run_.emplace_back(key, value);
+    run_size_ += sizeof(Entry) + heap_bytes(key) + heap_bytes(value);
+    max_entry_bytes_ = std::max(max_entry_bytes_, KeyCodec::size(key) + ValueCodec::size(value));
+    return run_size_ < run_bytes_ || spill_run();
+}
+
+template <typename Key, typename Value, typename Compare, typename KeyCodec, typename ValueCodec>
+bool ExternalSorter<Key, Value, Compare, KeyCodec, ValueCodec>::finish() {
+    if (run_files_.empty()) {
+        sort_run();
+        count_ = run_.size();
+        return true;
+    }
+    if (!run_.empty() && !spill_run()) {
+        return false;
+    }
+
+    count_ = 0;
+    return merge([this](const Key&, const Value&) {
+        count_++;
+        return true;
+    });
+}
+
+template <typename Key, typename Value, typename Compare, typename KeyCodec, typename ValueCodec>
+bool ExternalSorter<Key, Value, Compare, KeyCodec, ValueCodec>::merge(const EntryHandler& handle) {
+    if (run_files_.empty()) {
+        for (const Entry& entry : run_) {
+            if (!handle(entry.first, entry.second)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    struct Run {
+        SortRunReader reader;
+        Entry entry;
+        bool intact;    // False once a record failed to decode
+
+        explicit Run(const std::string& filename) : reader(filename), intact(true) {}
+        bool next() {
+            if (!reader.next()) {
+                return false;
+            }
+            int bytes = KeyCodec::decode(reader.data(), reader.size(), entry.first);
+            intact = bytes >= 0 && ValueCodec::decode(reader.data() + bytes, reader.size() - bytes, entry.second) >= 0;
+            return intact;
+        }
+    };
+    std::vector<std::unique_ptr<Run>> runs;
+    for (const std::string& filename : run_files_) {
+        runs.emplace_back(new Run(filename));
+    }
+
+    // Smallest entry on top
+    auto later = [&runs](size_t a, size_t b) { return entry_less(runs[b]->entry, runs[a]->entry); };
+    std::priority_queue<size_t, std::vector<size_t>, decltype(later)> heap(later);
+    for (size_t i = 0; i < runs.size(); i++) {
+        if (runs[i]->next()) {
+            heap.push(i);
+        }
+    }
+
+    bool first = true;
+    Entry last;
+    while (!heap.empty()) {
+        size_t i = heap.top();
+        heap.pop();
+
+        Run& run = *runs[i];
+        if (first || !same_entry(run.entry, last)) {
+            if (!handle(run.entry.first, run.entry.second)) {
+                return false;
+            }
+            first = false;
+            last = run.entry;
+        }
+        if (run.next()) {
+            heap.push(i);
+        }
+    }
+    for (const auto& run : runs) {
+        if (!run->intact) {
+            return false;
+        }
+    }
+    return true;
+}
+
+template <typename Key, typename Value, typename Compare, typename KeyCodec, typename ValueCodec>
+void ExternalSorter<Key, Value, Compare, KeyCodec, ValueCodec>::sort_run() {
+    std::sort(run_.begin(), run_.end(), entry_less);
+    run_.erase(std::unique(run_.begin(), run_.end(), same_entry), run_.end());
+}
+
+template <typename Key, typename Value, typename Compare, typename KeyCodec, typename ValueCodec>
+bool ExternalSorter<Key, Value, Compare, KeyCodec, ValueCodec>::spill_run() {
+    sort_run();
+
+    std::string filename = spill_prefix_ + ".run" + std::to_string(run_files_.size());
+    run_files_.push_back(filename);
+    SortRunWriter writer(filename);
+    std::vector<char> record(KeyCodec::MAX_BYTES + ValueCodec::MAX_BYTES);
+    for (const Entry& entry : run_) {
+        int bytes = KeyCodec::encode(entry.first, record.data());
+        bytes += ValueCodec::encode(entry.second, record.data() + bytes);
+        writer.add(record.data(), bytes);
+    }
+    if (!writer.close()) {
+        return false;
+    }
+
+    run_.clear();
+    run_size_ = 0;
+    return true;
+}
+
+#endif
@@ -15,8 +15,11 @@ bool FlightService::addFlight(Flight* flight) {
     Flight** existing = flightMap.get(id);
     if (existing && *existing) return false;
     
-    // Add to BTree by time (cast time_t to int)
-    flightTimeTree.insert(static_cast<int>(flight->getDeparture()), id);
+    // Add to BTree by time. The flight number orders flights that share a
+    // departure time.
+    if (!FlightNumber::fits(id) || !flightTimeTree.insert(flight->getDeparture(), FlightNumber(id))) {
+        return false;
+    }
     
     // Add to HashMap for lookup
     flightMap.insert(id, flight);
@@ -35,8 +38,8 @@ bool FlightService::removeFlight(string id) {
     Flight* flight = findFlight(id);
     if (!flight) return false;
     
-    // Remove from BTree
-    flightTimeTree.remove(static_cast<int>(flight->getDeparture()));
+    // Remove this flight's entry, not just any at its departure time
+    flightTimeTree.remove(flight->getDeparture(), FlightNumber(id));
     
     // Remove gate assignment
     string gate = getFlightGate(id);
@@ -55,12 +58,12 @@ bool FlightService::removeFlight(string id) {
 vector<Flight*> FlightService::getFlightsByTime(time_t from, time_t to) {
     vector<Flight*> result;
     
-    // Get IDs from BTree (cast time_t to int)
-    auto ids = flightTimeTree.range_query(static_cast<int>(from), static_cast<int>(to));
+    // Get IDs from BTree
+    auto ids = flightTimeTree.range_query(from, to);
     
     // Get full flight info
     for (auto& pair : ids) {
-        Flight* flight = findFlight(pair.second);
+        Flight* flight = findFlight(pair.second.str());
         if (flight) {
             result.push_back(flight);
         }
@@ -75,7 +78,7 @@ vector<Flight*> FlightService::getAllFlights() {
     auto all = flightTimeTree.get_all();
     
     for (auto& pair : all) {
-        Flight* flight = findFlight(pair.second);
+        Flight* flight = findFlight(pair.second.str());
         if (flight) {
             result.push_back(flight);
         }
@@ -139,8 +142,8 @@ bool FlightService::delayFlight(string flightId, int minutes) {
     flight->setDeparture(newTime);
     
     // Update BTree: remove old, insert new
-    flightTimeTree.remove(static_cast<int>(oldTime));
-    flightTimeTree.insert(static_cast<int>(newTime), flightId);
+    flightTimeTree.remove(oldTime, FlightNumber(flightId));
+    flightTimeTree.insert(newTime, FlightNumber(flightId));
     
     return true;
 }
@@ -165,12 +168,12 @@ int FlightService::countActiveFlights() const {
     int count = 0;
     
     // Work around const-correctness issue
-    BTree& nonConstTree = const_cast<BTree&>(flightTimeTree);
+    auto& nonConstTree = const_cast<BTree<int64_t, FlightNumber>&>(flightTimeTree);
     auto all = nonConstTree.get_all();
     
     for (auto& pair : all) {
         // Work around HashMap const issue
-        Flight** flightPtr = const_cast<HashMap<string, Flight*>&>(flightMap).get(pair.second);
+        Flight** flightPtr = const_cast<HashMap<string, Flight*>&>(flightMap).get(pair.second.str());
         Flight* flight = flightPtr ? *flightPtr : nullptr;
         if (flight && flight->isActive()) {
             count++;
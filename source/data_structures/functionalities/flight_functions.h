@@ -8,7 +8,10 @@
 #include <ctime>
 
 class FlightService {
-    BTree flightTimeTree;       // Sorted by departure time
+    // Departure time -> flight number, sorted by time and then number. Flight
+    // numbers of up to 8 characters are stored inline in the nodes.
+    typedef FixedString<8> FlightNumber;
+    BTree<int64_t, FlightNumber> flightTimeTree;
     HashMap<std::string, Flight*> flightMap; // Quick lookup by flight number
     HashMap<std::string, std::string> gateMap; // Flight -> Gate mapping
     
@@ -8,7 +8,7 @@
 
 class GateService {
     std::vector<Gate*> gates;
-    BTree gateSchedule; // Time -> Gate mapping
+    BTree<int64_t, std::string> gateSchedule; // Time -> Gate mapping
     
 public:
     GateService();
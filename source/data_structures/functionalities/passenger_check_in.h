@@ -15,6 +15,7 @@
 #include <iostream>
 #include <vector>
 #include <ctime>
+#include <cstdio>
 
 class CheckinService {
 private:
@@ -24,10 +25,47 @@ private:
     HashMap<std::string, Booking*>* bookingMap;
     
     // NEW: Flight and Gate management
-    BTree* flightSchedule;                          // B-Tree for range queries
+    BTree<int64_t, FixedString<8>>* flightSchedule; // Departure time -> flight number, for range queries
     HashMap<std::string, Flight*>* flightMap;       // O(1) flight lookup
     HashMap<std::string, Gate*>* gateMap;           // O(1) gate lookup
-    BTree* gateSchedule;                            // B-Tree for gate queries
+    BTree<int, std::string>* gateSchedule;          // Gate number -> gate, for gate queries
+    
+    // Schedules written before flight numbers were stored inline map int
+    // departure times to strings. Such a file is refused under the current
+    // types, so its flights are carried over into a new one and the old file
+    // is kept beside it with an .old suffix.
+    static BTree<int64_t, FixedString<8>>* openFlightSchedule(const std::string& filename) {
+        BTree<int64_t, FixedString<8>>* schedule = new BTree<int64_t, FixedString<8>>(filename);
+        if (schedule->initialize()) {
+            return schedule;
+        }
+        delete schedule;
+        
+        std::vector<std::pair<int, std::string>> flights;
+        bool readable;
+        {
+            BTree<int, std::string> old(filename);
+            readable = old.initialize();
+            if (readable) {
+                flights = old.get_all();
+            }
+        }
+        if (!readable || std::rename(filename.c_str(), (filename + ".old").c_str()) != 0) {
+            std::cerr << "Cannot migrate flight schedule " << filename << std::endl;
+            return new BTree<int64_t, FixedString<8>>(filename);
+        }
+        std::remove((filename + ".wal").c_str());
+        
+        schedule = new BTree<int64_t, FixedString<8>>(filename);
+        schedule->initialize();
+        for (const auto& [departure, flightId] : flights) {
+            if (FixedString<8>::fits(flightId)) {
+                schedule->insert(departure, FixedString<8>(flightId));
+            }
+        }
+        std::cout << "Migrated " << flights.size() << " flights into " << filename << std::endl;
+        return schedule;
+    }
     
 public:
     CheckinService() {
@@ -37,10 +75,9 @@ public:
         gateMap = new HashMap<std::string, Gate*>(100);
         
         // Initialize B-Trees
-        flightSchedule = new BTree("flight_schedule.dat");
-        gateSchedule = new BTree("gate_schedule.dat");
+        flightSchedule = openFlightSchedule("flight_schedule.dat");
+        gateSchedule = new BTree<int, std::string>("gate_schedule.dat");
         
-        flightSchedule->initialize();
         gateSchedule->initialize();
     }
     
@@ -62,9 +99,11 @@ public:
     void addFlight(Flight* flight) {
         flightMap->insert(flight->getFlightId(), flight);
         
-        // Store in B-Tree by departure time (for range queries)
-        int timeKey = static_cast<int>(flight->getDeparture());
-        flightSchedule->insert(timeKey, flight->getFlightId());
+        // Store in B-Tree by departure time (for range queries). Flight
+        // numbers longer than the tree stores inline stay out of it.
+        if (FixedString<8>::fits(flight->getFlightId())) {
+            flightSchedule->insert(flight->getDeparture(), FixedString<8>(flight->getFlightId()));
+        }
         
         std::cout << "Added flight " << flight->getFlightId() << " to schedule" << std::endl;
     }
@@ -85,13 +124,10 @@ public:
         std::vector<Flight*> result;
         
         // Use B-Tree range query - O(log n + k)
-        auto flightIds = flightSchedule->range_query(
-            static_cast<int>(start), 
-            static_cast<int>(end)
-        );
+        auto flightIds = flightSchedule->range_query(start, end);
         
         for (const auto& [timeKey, flightId] : flightIds) {
-            Flight** flightPtr = flightMap->get(flightId);
+            Flight** flightPtr = flightMap->get(flightId.str());
             if (flightPtr) {
                 result.push_back(*flightPtr);
             }
@@ -89,6 +89,17 @@ public:
         return nullptr;
     }
     
+    const T* get(T value) const {
+        ListNode<T>* current = head;
+        while (current != nullptr) {
+            if (current->data == value) {
+                return &(current->data);
+            }
+            current = current->next;
+        }
+        return nullptr;
+    }
+    
     // Get size
     int getSize() const {
         return size;
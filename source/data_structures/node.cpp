@@ -1,187 +1,160 @@
 #include "node.h"
-#include "storage_manager.h"
-#include <cstring>
-#include <algorithm>
-#include <iostream>
 #include <functional>
 
-using namespace std;
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define NODE_X86_SEARCH 1
+#endif
 
-// Constructor
-Node::Node(int block_idx, bool leaf) 
-    : block_index(block_idx), is_leaf(leaf), key_count(0), is_dirty(false) {
-    initialize();
-}
+using namespace std;
 
-Node::~Node() {
-    clear_memory_pointers();
-}
+namespace {
 
-void Node::initialize() {
-    keys.resize(M - 1);
-    values.resize(M - 1);
-    disk_pointers.resize(M, -1);
-    memory_pointers.resize(M, nullptr);
-    key_count = 0;
+#ifdef NODE_X86_SEARCH
+// Keys are sorted, so the index of the first key >= key is simply the number
+// of keys below it: compare whole vectors against the key and count the
+// lanes. No branch depends on the data.
+__attribute__((target("avx2,popcnt")))
+int search_avx2(const int* keys, int count, int key) {
+    __m256i needle = _mm256_set1_epi32(key);
+    int below = 0;
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(keys + i));
+        __m256i less = _mm256_cmpgt_epi32(needle, block);
+        below += __builtin_popcount(_mm256_movemask_ps(_mm256_castsi256_ps(less)));
+    }
+    for (; i < count; i++) {
+        below += keys[i] < key;
+    }
+    return below;
 }
 
-void Node::serialize(char* buffer) const {
-    memset(buffer, 0, BLOCK_SIZE);
-    
-    // Header: is_leaf (1 byte) + key_count (4 bytes)
-    buffer[0] = is_leaf ? 1 : 0;
-    memcpy(buffer + 1, &key_count, sizeof(int));
-    
-    int offset = 5; // 1 + 4
-    
-    // Keys
-    for (int i = 0; i < key_count; i++) {
-        memcpy(buffer + offset, &keys[i], sizeof(int));
-        offset += sizeof(int);
+__attribute__((target("sse4.2,popcnt")))
+int search_sse4(const int* keys, int count, int key) {
+    __m128i needle = _mm_set1_epi32(key);
+    int below = 0;
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(keys + i));
+        __m128i less = _mm_cmpgt_epi32(needle, block);
+        below += __builtin_popcount(_mm_movemask_ps(_mm_castsi128_ps(less)));
     }
-    
-    // Values (Flight numbers) - store with length prefix
-    for (int i = 0; i < key_count; i++) {
-        int value_len = values[i].size();
-        memcpy(buffer + offset, &value_len, sizeof(int));
-        offset += sizeof(int);
-        
-        if (value_len > 0) {
-            memcpy(buffer + offset, values[i].c_str(), value_len);
-            offset += value_len;
-        }
+    for (; i < count; i++) {
+        below += keys[i] < key;
     }
-    
-    // Disk pointers
-    for (int i = 0; i <= key_count; i++) {
-        memcpy(buffer + offset, &disk_pointers[i], sizeof(int));
-        offset += sizeof(int);
+    return below;
+}
+
+// The same over 64-bit keys, four or two to a vector
+__attribute__((target("avx2,popcnt")))
+int search_avx2_64(const int64_t* keys, int count, int64_t key) {
+    __m256i needle = _mm256_set1_epi64x(key);
+    int below = 0;
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(keys + i));
+        __m256i less = _mm256_cmpgt_epi64(needle, block);
+        below += __builtin_popcount(_mm256_movemask_pd(_mm256_castsi256_pd(less)));
     }
-    
-    // Fill remaining space with zeros
-    while (offset < BLOCK_SIZE) {
-        buffer[offset++] = 0;
+    for (; i < count; i++) {
+        below += keys[i] < key;
     }
+    return below;
 }
 
-void Node::deserialize(const char* buffer) {
-    // Header
-    is_leaf = (buffer[0] == 1);
-    memcpy(&key_count, buffer + 1, sizeof(int));
-    
-    int offset = 5;
-    
-    // Keys
-    for (int i = 0; i < key_count; i++) {
-        memcpy(&keys[i], buffer + offset, sizeof(int));
-        offset += sizeof(int);
-    }
-    
-    // Values
-    values.clear();
-    for (int i = 0; i < key_count; i++) {
-        int value_len;
-        memcpy(&value_len, buffer + offset, sizeof(int));
-        offset += sizeof(int);
-        
-        if (value_len > 0) {
-            values.push_back(string(buffer + offset, value_len));
-            offset += value_len;
-        } else {
-            values.push_back("");
-        }
+__attribute__((target("sse4.2,popcnt")))
+int search_sse4_64(const int64_t* keys, int count, int64_t key) {
+    __m128i needle = _mm_set1_epi64x(key);
+    int below = 0;
+    int i = 0;
+    for (; i + 2 <= count; i += 2) {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(keys + i));
+        __m128i less = _mm_cmpgt_epi64(needle, block);
+        below += __builtin_popcount(_mm_movemask_pd(_mm_castsi128_pd(less)));
     }
-    
-    // Disk pointers
-    disk_pointers.resize(M, -1);
-    for (int i = 0; i <= key_count; i++) {
-        memcpy(&disk_pointers[i], buffer + offset, sizeof(int));
-        offset += sizeof(int);
+    for (; i < count; i++) {
+        below += keys[i] < key;
     }
-    
-    // Clear memory pointers
-    clear_memory_pointers();
+    return below;
 }
+#endif
 
-void Node::clear_memory_pointers() {
-    for (auto& ptr : memory_pointers) {
-        ptr = nullptr;
-    }
+typedef int (*SearchKernel)(const int* keys, int count, int key);
+typedef int (*SearchKernel64)(const int64_t* keys, int count, int64_t key);
+
+int search_binary_64(const int64_t* keys, int count, int64_t key) {
+    return KeySearch::search_binary(keys, count, key, less<int64_t>());
 }
 
-int Node::find_key(int key) const {
-    int idx = 0;
-    while (idx < key_count && keys[idx] < key) {
-        idx++;
-    }
-    return idx;
+SearchKernel select_vector_kernel() {
+#ifdef NODE_X86_SEARCH
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return search_avx2;
+    if (__builtin_cpu_supports("sse4.2")) return search_sse4;
+#endif
+    return KeySearch::search_binary;
 }
 
-void Node::insert_key_value(int key, const string& value, int disk_ptr, Node* mem_ptr) {
-    int idx = find_key(key);
-    
-    // Shift keys and values to the right
-    for (int i = key_count; i > idx; i--) {
-        keys[i] = keys[i - 1];
-        values[i] = values[i - 1];
-    }
-    for (int i = key_count + 1; i > idx + 1; i--) {
-        disk_pointers[i] = disk_pointers[i - 1];
-        memory_pointers[i] = memory_pointers[i - 1];
-    }
-    
-    // Insert new key, value and pointer
-    keys[idx] = key;
-    values[idx] = value;
-    if (disk_ptr != -1) {
-        disk_pointers[idx + 1] = disk_ptr;
-    }
-    if (mem_ptr != nullptr) {
-        memory_pointers[idx + 1] = mem_ptr;
-    }
-    
-    key_count++;
-    is_dirty = true;
+SearchKernel64 select_vector_kernel_64() {
+#ifdef NODE_X86_SEARCH
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return search_avx2_64;
+    if (__builtin_cpu_supports("sse4.2")) return search_sse4_64;
+#endif
+    return search_binary_64;
 }
 
-void Node::remove_key(int index) {
-    for (int i = index; i < key_count - 1; i++) {
-        keys[i] = keys[i + 1];
-        values[i] = values[i + 1];
-    }
-    for (int i = index + 1; i < key_count; i++) {
-        disk_pointers[i] = disk_pointers[i + 1];
-        memory_pointers[i] = memory_pointers[i + 1];
-    }
-    key_count--;
-    is_dirty = true;
+const int VECTOR_WINDOW_KEYS = 32;
+
+const SearchKernel vector_kernel = select_vector_kernel();
+const SearchKernel64 vector_kernel_64 = select_vector_kernel_64();
+
 }
 
-// Range query for flight searches
-void Node::range_query(int low, int high, vector<pair<int, string>>& result, 
-                       function<Node*(int)> load_node_func) {
-    int i = 0;
-    while (i < key_count) {
-        if (!is_leaf) {
-            // Load child if not in memory
-            if (!memory_pointers[i]) {
-                memory_pointers[i] = load_node_func(disk_pointers[i]);
-            }
-            memory_pointers[i]->range_query(low, high, result, load_node_func);
-        }
-        
-        // Check if current key is in range
-        if (keys[i] >= low && keys[i] <= high) {
-            result.push_back({keys[i], values[i]});
-        }
-        i++;
+// Branch-free lower bound: the loop always runs log2(count) times and the
+// comparison feeds a conditional move rather than a jump, so there is
+// nothing for the branch predictor to miss
+int KeySearch::search_binary(const int* keys, int count, int key) {
+    if (count == 0) {
+        return 0;
     }
     
-    // Check last child
-    if (!is_leaf) {
-        if (!memory_pointers[i]) {
-            memory_pointers[i] = load_node_func(disk_pointers[i]);
-        }
-        memory_pointers[i]->range_query(low, high, result, load_node_func);
+    const int* base = keys;
+    while (count > 1) {
+        int half = count / 2;
+        base = base[half] < key ? base + half : base;
+        count -= half;
     }
-}
\ No newline at end of file
+    return static_cast<int>(base - keys) + (*base < key);
+}
+
+// Counting every key stops paying off beyond a few vectors of them, so the
+// binary search first narrows a page-sized node down to a window that still
+// holds the answer, and the kernel counts the keys below the key in that
+template <typename Key, typename Kernel>
+static int search_window(const Key* keys, int count, Key key, Kernel kernel) {
+    const Key* base = keys;
+    while (count > VECTOR_WINDOW_KEYS) {
+        int half = count / 2;
+        base = base[half] < key ? base + half : base;
+        count -= half;
+    }
+    return static_cast<int>(base - keys) + kernel(base, count, key);
+}
+
+int KeySearch::search_vector(const int* keys, int count, int key) {
+    return search_window(keys, count, key, vector_kernel);
+}
+
+int KeySearch::search_vector(const int64_t* keys, int count, int64_t key) {
+    return search_window(keys, count, key, vector_kernel_64);
+}
+
+const char* KeySearch::search_kernel() {
+#ifdef NODE_X86_SEARCH
+    if (vector_kernel == search_avx2) return "avx2";
+    if (vector_kernel == search_sse4) return "sse4";
+#endif
+    return "binary";
+}
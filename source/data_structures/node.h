@@ -1,50 +1,551 @@
 #ifndef NODE_H
 #define NODE_H
 
+#include <array>
 #include <vector>
+#include <cstddef>
 #include <cstdint>
+#include <cstring>
 #include <string>
-#include <memory>
+#include <limits>
 #include <functional>
+#include <type_traits>
+#include <atomic>
+#include <shared_mutex>
+#include <thread>
 
 // Include constants
 #include "constants.h"
+#include "codec.h"
+#include "checksum.h"
 
-class Node {
+// Version latch for optimistic lock coupling. A writer locks a node before
+// changing it and moves its version on when it unlocks; a reader notes the
+// version, reads without locking and then validates that the version held.
+// Keys and values that can't be copied while they change, like strings, are
+// read under the shared side instead, which waits out writers.
+class NodeLatch {
+public:
+    NodeLatch() : version_(0) {}
+
+    // Waits while the node is locked; false once it has been freed
+    bool read_begin(uint64_t& version) const {
+        version = version_.load(std::memory_order_acquire);
+        while (version & LOCKED) {
+            std::this_thread::yield();
+            version = version_.load(std::memory_order_acquire);
+        }
+        return !(version & OBSOLETE);
+    }
+    bool validate(uint64_t version) const {
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return version_.load(std::memory_order_relaxed) == version;
+    }
+
+    void lock_shared() const { mutex_.lock_shared(); }
+    void unlock_shared() const { mutex_.unlock_shared(); }
+
+    void lock() {
+        mutex_.lock();
+        version_.fetch_or(LOCKED, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+    }
+    void unlock() {
+        version_.fetch_add(VERSION_STEP - LOCKED, std::memory_order_release);
+        mutex_.unlock();
+    }
+    void mark_obsolete() { version_.fetch_or(OBSOLETE, std::memory_order_release); }
+
+private:
+    static const uint64_t LOCKED = 1;
+    static const uint64_t OBSOLETE = 2;
+    static const uint64_t VERSION_STEP = 4;
+
+    std::atomic<uint64_t> version_;
+    mutable std::shared_mutex mutex_;
+};
+
+// What the buffer pool needs of a node: its block, its latch, and a way to
+// delete it whatever its key and value types
+class NodeBase {
 public:
-    // Disk representation
-    std::vector<int> keys;          // Departure timestamps
-    std::vector<std::string> values; // Flight numbers for lookup
-    std::vector<int> disk_pointers; // Block indices for children
     int block_index;                // This node's position in file
+    NodeLatch latch;
+    size_t pool_slot;               // Frame the buffer pool holds it in
+
+    explicit NodeBase(int block_idx) : block_index(block_idx), pool_slot(0) {}
+    virtual ~NodeBase() {}
+};
+
+// Header of a slotted page. Nodes written before pages were slotted start
+// with their leaf flag, 0 or 1, where the format is, followed by the key
+// count and then the keys, values and child pointers packed back to back;
+// those still load, as do slotted pages from before pages were checksummed,
+// whose header ends at the checksum, and from before leaves were chained,
+// whose header ends at the links.
+struct PageHeader {
+    uint8_t format;         // PAGE_SLOTTED
+    uint8_t is_leaf;
+    uint16_t key_count;
+    uint16_t cells_start;   // Lowest cell; the free space ends here
+    uint16_t reserved;
+    int32_t last_child;     // Rightmost child of an internal page, -1 in a leaf
+    int32_t prev_leaf;      // Neighbouring leaves, -1 past either end and in internal pages
+    int32_t next_leaf;
+    uint32_t checksum;      // CRC of the page with this field zeroed, free space aside; see seal_page
+};
+
+const uint8_t PAGE_SLOTTED = 4;
+const uint8_t PAGE_SLOTTED_UNCHECKED = 3;
+const uint8_t PAGE_SLOTTED_UNLINKED = 2;
+
+// The free space between the slots and the cells is zero and never read,
+// so it is left out
+inline uint32_t page_checksum(const PageHeader& header, const char* page) {
+    PageHeader unsigned_header = header;
+    unsigned_header.checksum = 0;
+    uint32_t crc = crc32(&unsigned_header, sizeof(unsigned_header));
+    crc = crc32(page + sizeof(PageHeader), header.key_count * sizeof(uint16_t), crc);
+    return crc32(page + header.cells_start, BLOCK_SIZE - header.cells_start, crc);
+}
+
+// Pages get their checksum on their way to disk rather than on every save,
+// so a leaf saved on each insert of a burst is summed once. Summing only
+// reads the page, and pages of other formats carry no checksum.
+inline uint32_t seal_checksum(const char* page) {
+    PageHeader header;
+    memcpy(&header, page, sizeof(header));
+    return header.format == PAGE_SLOTTED ? page_checksum(header, page) : 0;
+}
+inline void seal_page(char* page, uint32_t checksum) {
+    if (static_cast<uint8_t>(page[0]) == PAGE_SLOTTED) {
+        memcpy(page + offsetof(PageHeader, checksum), &checksum, sizeof(checksum));
+    }
+}
+inline void seal_page(char* page) { seal_page(page, seal_checksum(page)); }
+
+static_assert(BLOCK_SIZE <= 65536, "Slots hold 16-bit offsets into the page");
+
+// Slotted-page geometry for a key and value codec. The header is followed
+// by a slot per entry holding its cell's offset; cells fill the page from
+// the end, each an entry's left child (internal pages only), key and value.
+// How many entries fit depends on their actual sizes, so nodes split and
+// merge by the bytes they use; these bounds only size a node's arrays and
+// its fill thresholds.
+template <typename KeyCodec, typename ValueCodec>
+struct NodeLayout {
+    static const int HEADER_BYTES = sizeof(PageHeader);
+    static const int UNCHECKED_HEADER_BYTES = offsetof(PageHeader, checksum);
+    static const int SLOT_BYTES = sizeof(uint16_t);
+    static const int POINTER_BYTES = sizeof(int32_t);
+    static const int CAPACITY = BLOCK_SIZE - HEADER_BYTES;     // For slots and cells
+
+    // Slot and cell of the largest entry of an internal page, and of the
+    // smallest of a leaf
+    static const int MAX_ENTRY_BYTES = SLOT_BYTES + POINTER_BYTES + KeyCodec::MAX_BYTES + ValueCodec::MAX_BYTES;
+    static const int MIN_ENTRY_BYTES = SLOT_BYTES + KeyCodec::MIN_BYTES + ValueCodec::MIN_BYTES;
+    static const int MAX_ENTRIES = (BLOCK_SIZE - UNCHECKED_HEADER_BYTES) / MIN_ENTRY_BYTES;    // Unchecked pages too
+
+    // A node using less takes an entry from a sibling or merges with it. Two
+    // such nodes and the separator between them leave room for two entries.
+    static const int MIN_FILL_BYTES = (CAPACITY - 3 * MAX_ENTRY_BYTES) / 2;
+
+    static_assert(CAPACITY >= 10 * MAX_ENTRY_BYTES, "Keys and values too large to fit ten entries in a block");
+};
+
+// Search kernels behind find_key, public for benchmarking. Each returns the
+// index of the first of count sorted keys that is >= key.
+struct KeySearch {
+    static int search_binary(const int* keys, int count, int key);
+    static int search_vector(const int* keys, int count, int key);  // AVX2/SSE4 when available
+    static int search_vector(const int64_t* keys, int count, int64_t key);
+    static const char* search_kernel();     // Which kernel find_key runs on this CPU
+
+    // The same branch-free search for any key type and order
+    template <typename Key, typename Compare>
+    static int search_binary(const Key* keys, int count, const Key& key, const Compare& less) {
+        if (count == 0) {
+            return 0;
+        }
+        const Key* base = keys;
+        while (count > 1) {
+            int half = count / 2;
+            base = less(base[half], key) ? base + half : base;
+            count -= half;
+        }
+        return static_cast<int>(base - keys) + less(*base, key);
+    }
+};
+
+// A B+Tree node. A leaf holds entries and links to its neighbours; an
+// internal node holds separators, copies of the first entry its next child
+// had when the two were split apart, with the child pointers. Child pointers
+// and plain keys and values are held in place, in arrays long enough for a
+// page of the smallest entries, so a node of plain types is a single
+// allocation that readers can copy from while it changes. Others, such as
+// strings, are held in vectors grown to the entries the node has had, so a
+// load builds as many as the page holds rather than a page of the smallest.
+template <typename Key, typename Value, typename Compare, typename KeyCodec, typename ValueCodec>
+class BTreeNode : public NodeBase {
+public:
+    typedef NodeLayout<KeyCodec, ValueCodec> Layout;
+
+    template <typename T>
+    using Entries = typename std::conditional<std::is_trivially_copyable<T>::value,
+                                              std::array<T, Layout::MAX_ENTRIES>, std::vector<T>>::type;
+
+    // Disk representation
+    Entries<Key> keys;
+    Entries<Value> values;
+    std::array<int, Layout::MAX_ENTRIES + 1> disk_pointers;  // Block indices for children (loaded through the BufferPool)
     bool is_leaf;
     int key_count;
-    
-    // Memory representation
-    std::vector<Node*> memory_pointers;
+    int prev_leaf;      // Blocks of the neighbouring leaves, -1 if none
+    int next_leaf;
+
     bool is_dirty; // Track if node needs to be written to disk
-    
-    Node(int block_idx, bool leaf = false);
-    ~Node();
-    
-    // Serialization/Deserialization
-    void serialize(char* buffer) const;
-    void deserialize(const char* buffer);
-    
-    // Memory management
-    void clear_memory_pointers();
-    
-    // Utility
-    int find_key(int key) const;
-    void insert_key_value(int key, const std::string& value, int disk_ptr = -1, Node* mem_ptr = nullptr);
+
+    BTreeNode(int block_idx, bool leaf = false)
+        : NodeBase(block_idx), keys(), values(), is_leaf(leaf), key_count(0), prev_leaf(-1), next_leaf(-1),
+          is_dirty(false) {
+        disk_pointers.fill(-1);
+    }
+
+    // Serialization/Deserialization. serialize is false if the node doesn't
+    // fit in a block, which the tree never lets happen, and leaves the
+    // checksum to seal_page. deserialize is false if the block holds counts,
+    // offsets or lengths no node can have, or, when sealed, fails its
+    // checksum; it leaves the node partly read.
+    bool serialize(char* buffer) const;
+    bool deserialize(const char* buffer, bool sealed);
+
+    // Entries added past key_count need room made for them first
+    void make_room(int entries) {
+        grow(keys, entries);
+        grow(values, entries);
+    }
+
+    // What the node takes at most, its vectors full, which the buffer pool
+    // budgets for
+    static constexpr size_t max_bytes() {
+        return sizeof(BTreeNode) + heap_bytes<Key>() + heap_bytes<Value>();
+    }
+
+    // Space, counted as the slots and cells entries take in the page
+    int entry_bytes(int index) const {
+        int cell = is_leaf ? 0 : Layout::POINTER_BYTES;
+        return Layout::SLOT_BYTES + cell + KeyCodec::size(keys[index]) + ValueCodec::size(values[index]);
+    }
+    int used_bytes() const;
+    bool has_room(int entries = 1) const {      // For that many more of the largest entries
+        return used_bytes() + entries * Layout::MAX_ENTRY_BYTES <= Layout::CAPACITY;
+    }
+    bool is_deficient() const { return used_bytes() < Layout::MIN_FILL_BYTES; }
+    int split_point() const;    // Entry that moves up, leaving about half the bytes on each side
+
+    // Utility. Entries are ordered by key, then by value, so one key can
+    // hold several entries.
+    int find_key(const Key& key) const;         // Index of the first key >= key
+    int find_key_after(const Key& key) const;   // Index of the first key > key
+    int find_entry(const Key& key, const Value& value) const;   // First entry >= (key, value)
+    int find_child(const Key& key, const Value& value) const;   // Child whose range holds (key, value)
+
+    static bool same_key(const Key& a, const Key& b) { return !Compare()(a, b) && !Compare()(b, a); }
+
+    void insert_key_value(const Key& key, const Value& value, int disk_ptr = -1);
     void remove_key(int index);
-    
-    // Range query - NEW for flight searches
-    void range_query(int low, int high, std::vector<std::pair<int, std::string>>& result, 
-                     std::function<Node*(int)> load_node_func);
-    
+
 private:
-    void initialize();
+    template <typename T, size_t N>
+    static void grow(std::array<T, N>&, int) {}
+    template <typename T>
+    static void grow(std::vector<T>& entries, int count) {
+        if (entries.size() < static_cast<size_t>(count)) {
+            entries.resize(count);
+        }
+    }
+    template <typename T>
+    static constexpr size_t heap_bytes() {
+        return std::is_trivially_copyable<T>::value ? 0 : Layout::MAX_ENTRIES * sizeof(T);
+    }
+
+    // Plain integer keys in their natural order go to the vector kernels
+    static const bool VECTOR_KEYS = std::is_same<Compare, std::less<Key>>::value &&
+        (std::is_same<Key, int>::value || std::is_same<Key, int64_t>::value);
+    static const bool FIXED_WIDTH = KeyCodec::MIN_BYTES == KeyCodec::MAX_BYTES &&
+                                    ValueCodec::MIN_BYTES == ValueCodec::MAX_BYTES;
+
+    // The format of nodes written before pages were slotted
+    static const int PACKED_HEADER_BYTES = 1 + sizeof(int32_t);
+    bool serialize_packed(char* buffer) const;
+    bool deserialize_packed(const char* buffer);
 };
 
-#endif
\ No newline at end of file
+template <typename Key, typename Value, typename Compare, typename KeyCodec, typename ValueCodec>
+bool BTreeNode<Key, Value, Compare, KeyCodec, ValueCodec>::serialize(char* buffer) const {
+    // A packed node, or a page filled before pages had a checksum, can load
+    // fuller than a checked page holds. The tree only ever takes entries out
+    // of one, so it keeps its format until it fits.
+    uint8_t format = PAGE_SLOTTED;
+    int header_bytes = Layout::HEADER_BYTES;
+    if (used_bytes() > Layout::CAPACITY) {
+        if (used_bytes() > BLOCK_SIZE - Layout::UNCHECKED_HEADER_BYTES) {
+            return serialize_packed(buffer);
+        }
+        format = PAGE_SLOTTED_UNCHECKED;
+        header_bytes = Layout::UNCHECKED_HEADER_BYTES;
+    }
+
+    memset(buffer, 0, BLOCK_SIZE);
+    int cells_start = BLOCK_SIZE;
+    for (int i = 0; i < key_count; i++) {
+        cells_start -= entry_bytes(i) - Layout::SLOT_BYTES;
+        uint16_t slot = cells_start;
+        memcpy(buffer + header_bytes + i * Layout::SLOT_BYTES, &slot, sizeof(slot));
+
+        char* cell = buffer + cells_start;
+        if (!is_leaf) {
+            memcpy(cell, &disk_pointers[i], sizeof(int32_t));
+            cell += sizeof(int32_t);
+        }
+        cell += KeyCodec::encode(keys[i], cell);
+        ValueCodec::encode(values[i], cell);
+    }
+
+    PageHeader header = {};
+    header.format = format;
+    header.is_leaf = is_leaf;
+    header.key_count = key_count;
+    header.cells_start = cells_start;
+    header.last_child = is_leaf ? -1 : disk_pointers[key_count];
+    header.prev_leaf = prev_leaf;
+    header.next_leaf = next_leaf;
+    memcpy(buffer, &header, header_bytes);
+    return true;
+}
+
+template <typename Key, typename Value, typename Compare, typename KeyCodec, typename ValueCodec>
+bool BTreeNode<Key, Value, Compare, KeyCodec, ValueCodec>::deserialize(const char* buffer, bool sealed) {
+    uint8_t format = buffer[0];
+    if (format != PAGE_SLOTTED && format != PAGE_SLOTTED_UNCHECKED && format != PAGE_SLOTTED_UNLINKED) {
+        return deserialize_packed(buffer);
+    }
+
+    PageHeader header = {};
+    int header_bytes = format == PAGE_SLOTTED ? Layout::HEADER_BYTES :
+                       format == PAGE_SLOTTED_UNCHECKED ? Layout::UNCHECKED_HEADER_BYTES :
+                       offsetof(PageHeader, prev_leaf);
+    memcpy(&header, buffer, header_bytes);
+    if (header.key_count > Layout::MAX_ENTRIES || header.cells_start > BLOCK_SIZE ||
+        header_bytes + header.key_count * Layout::SLOT_BYTES > header.cells_start ||
+        (sealed && format == PAGE_SLOTTED && header.checksum != page_checksum(header, buffer))) {
+        return false;
+    }
+    is_leaf = header.is_leaf;
+    key_count = header.key_count;
+    make_room(key_count);
+    prev_leaf = format == PAGE_SLOTTED_UNLINKED ? -1 : header.prev_leaf;
+    next_leaf = format == PAGE_SLOTTED_UNLINKED ? -1 : header.next_leaf;
+
+    // Block 0 is the superblock, so no child pointer is 0 or less
+    for (int i = 0; i < key_count; i++) {
+        uint16_t slot;
+        memcpy(&slot, buffer + header_bytes + i * Layout::SLOT_BYTES, sizeof(slot));
+        if (slot < header.cells_start || slot >= BLOCK_SIZE) {
+            return false;
+        }
+
+        int offset = slot;
+        if (!is_leaf) {
+            if (offset + Layout::POINTER_BYTES > BLOCK_SIZE) {
+                return false;
+            }
+            memcpy(&disk_pointers[i], buffer + offset, sizeof(int32_t));
+            offset += sizeof(int32_t);
+            if (disk_pointers[i] <= 0) {
+                return false;
+            }
+        }
+        int bytes = KeyCodec::decode(buffer + offset, BLOCK_SIZE - offset, keys[i]);
+        if (bytes < 0 || ValueCodec::decode(buffer + offset + bytes, BLOCK_SIZE - offset - bytes, values[i]) < 0) {
+            return false;
+        }
+    }
+    if (!is_leaf) {
+        disk_pointers[key_count] = header.last_child;
+        return header.last_child > 0;
+    }
+    return true;
+}
+
+// Header: is_leaf (1 byte) + key_count (4 bytes), then the keys, the values
+// and key_count + 1 child pointers
+template <typename Key, typename Value, typename Compare, typename KeyCodec, typename ValueCodec>
+bool BTreeNode<Key, Value, Compare, KeyCodec, ValueCodec>::serialize_packed(char* buffer) const {
+    size_t bytes = PACKED_HEADER_BYTES + (key_count + 1) * sizeof(int32_t);
+    for (int i = 0; i < key_count; i++) {
+        bytes += KeyCodec::size(keys[i]) + ValueCodec::size(values[i]);
+    }
+    if (bytes > static_cast<size_t>(BLOCK_SIZE)) {
+        return false;
+    }
+
+    memset(buffer, 0, BLOCK_SIZE);
+    buffer[0] = is_leaf ? 1 : 0;
+    memcpy(buffer + 1, &key_count, sizeof(int));
+
+    int offset = PACKED_HEADER_BYTES;
+    for (int i = 0; i < key_count; i++) {
+        offset += KeyCodec::encode(keys[i], buffer + offset);
+    }
+    for (int i = 0; i < key_count; i++) {
+        offset += ValueCodec::encode(values[i], buffer + offset);
+    }
+    for (int i = 0; i <= key_count; i++) {
+        memcpy(buffer + offset, &disk_pointers[i], sizeof(int));
+        offset += sizeof(int);
+    }
+    return true;
+}
+
+template <typename Key, typename Value, typename Compare, typename KeyCodec, typename ValueCodec>
+bool BTreeNode<Key, Value, Compare, KeyCodec, ValueCodec>::deserialize_packed(const char* buffer) {
+    if (buffer[0] != 0 && buffer[0] != 1) {
+        return false;
+    }
+    is_leaf = (buffer[0] == 1);
+    memcpy(&key_count, buffer + 1, sizeof(int));
+    if (key_count < 0 || key_count > Layout::MAX_ENTRIES) {
+        return false;
+    }
+    make_room(key_count);
+
+    int offset = PACKED_HEADER_BYTES;
+    for (int i = 0; i < key_count; i++) {
+        int bytes = KeyCodec::decode(buffer + offset, BLOCK_SIZE - offset, keys[i]);
+        if (bytes < 0) {
+            return false;
+        }
+        offset += bytes;
+    }
+    for (int i = 0; i < key_count; i++) {
+        int bytes = ValueCodec::decode(buffer + offset, BLOCK_SIZE - offset, values[i]);
+        if (bytes < 0) {
+            return false;
+        }
+        offset += bytes;
+    }
+    if (offset + (key_count + 1) * static_cast<int>(sizeof(int)) > BLOCK_SIZE) {
+        return false;
+    }
+    for (int i = 0; i <= key_count; i++) {
+        memcpy(&disk_pointers[i], buffer + offset, sizeof(int));
+        offset += sizeof(int);
+    }
+    return true;
+}
+
+template <typename Key, typename Value, typename Compare, typename KeyCodec, typename ValueCodec>
+int BTreeNode<Key, Value, Compare, KeyCodec, ValueCodec>::used_bytes() const {
+    if constexpr (FIXED_WIDTH) {
+        return key_count == 0 ? 0 : key_count * entry_bytes(0);
+    } else {
+        int bytes = 0;
+        for (int i = 0; i < key_count; i++) {
+            bytes += entry_bytes(i);
+        }
+        return bytes;
+    }
+}
+
+// Entries before the split point go left and those after it right, so
+// each side keeps at least one
+template <typename Key, typename Value, typename Compare, typename KeyCodec, typename ValueCodec>
+int BTreeNode<Key, Value, Compare, KeyCodec, ValueCodec>::split_point() const {
+    int half = used_bytes() / 2;
+    int left_bytes = entry_bytes(0);
+    int middle = 1;
+    while (middle < key_count - 2 && left_bytes + entry_bytes(middle) <= half) {
+        left_bytes += entry_bytes(middle);
+        middle++;
+    }
+    return middle;
+}
+
+template <typename Key, typename Value, typename Compare, typename KeyCodec, typename ValueCodec>
+int BTreeNode<Key, Value, Compare, KeyCodec, ValueCodec>::find_key(const Key& key) const {
+    if constexpr (VECTOR_KEYS) {
+        return KeySearch::search_vector(keys.data(), key_count, key);
+    } else {
+        return KeySearch::search_binary(keys.data(), key_count, key, Compare());
+    }
+}
+
+template <typename Key, typename Value, typename Compare, typename KeyCodec, typename ValueCodec>
+int BTreeNode<Key, Value, Compare, KeyCodec, ValueCodec>::find_key_after(const Key& key) const {
+    if constexpr (VECTOR_KEYS) {
+        return key == std::numeric_limits<Key>::max() ? key_count : find_key(key + 1);
+    } else {
+        Compare less;
+        return KeySearch::search_binary(keys.data(), key_count, key,
+                                        [&less](const Key& a, const Key& b) { return !less(b, a); });
+    }
+}
+
+// The key search does the work; only entries sharing the key compare values
+template <typename Key, typename Value, typename Compare, typename KeyCodec, typename ValueCodec>
+int BTreeNode<Key, Value, Compare, KeyCodec, ValueCodec>::find_entry(const Key& key, const Value& value) const {
+    int idx = find_key(key);
+    while (idx < key_count && same_key(keys[idx], key) && values[idx] < value) {
+        idx++;
+    }
+    return idx;
+}
+
+// Entries equal to a separator live to its right
+template <typename Key, typename Value, typename Compare, typename KeyCodec, typename ValueCodec>
+int BTreeNode<Key, Value, Compare, KeyCodec, ValueCodec>::find_child(const Key& key, const Value& value) const {
+    int idx = find_entry(key, value);
+    return idx < key_count && same_key(keys[idx], key) && values[idx] == value ? idx + 1 : idx;
+}
+
+template <typename Key, typename Value, typename Compare, typename KeyCodec, typename ValueCodec>
+void BTreeNode<Key, Value, Compare, KeyCodec, ValueCodec>::insert_key_value(const Key& key, const Value& value,
+                                                                          int disk_ptr) {
+    int idx = find_entry(key, value);
+    make_room(key_count + 1);
+
+    // Shift keys and values to the right
+    for (int i = key_count; i > idx; i--) {
+        keys[i] = keys[i - 1];
+        values[i] = values[i - 1];
+    }
+    for (int i = key_count + 1; i > idx + 1; i--) {
+        disk_pointers[i] = disk_pointers[i - 1];
+    }
+
+    // Insert new key, value and pointer
+    keys[idx] = key;
+    values[idx] = value;
+    if (disk_ptr != -1) {
+        disk_pointers[idx + 1] = disk_ptr;
+    }
+
+    key_count++;
+    is_dirty = true;
+}
+
+template <typename Key, typename Value, typename Compare, typename KeyCodec, typename ValueCodec>
+void BTreeNode<Key, Value, Compare, KeyCodec, ValueCodec>::remove_key(int index) {
+    for (int i = index; i < key_count - 1; i++) {
+        keys[i] = keys[i + 1];
+        values[i] = values[i + 1];
+    }
+    for (int i = index + 1; i < key_count; i++) {
+        disk_pointers[i] = disk_pointers[i + 1];
+    }
+    key_count--;
+    is_dirty = true;
+}
+
+#endif
@@ -1,81 +1,410 @@
 #include "storage_manager.h"
 #include "constants.h"  // ADD THIS LINE
+#include "checksum.h"
+#include "codec.h"
 #include <iostream>
 #include <cstring>
+#include <climits>
+#include <cstdlib>
+#include <cerrno>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/mman.h>
 
 using namespace std;
 
+AlignedBuffer::AlignedBuffer(size_t size)
+    : data_(nullptr),
+      size_((size + BLOCK_SIZE - 1) / BLOCK_SIZE * BLOCK_SIZE) {
+    if (size_ > 0) {
+        data_ = static_cast<char*>(aligned_alloc(BLOCK_SIZE, size_));
+        memset(data_, 0, size_);
+    }
+}
+
+AlignedBuffer::~AlignedBuffer() {
+    free(data_);
+}
+
+AlignedBuffer& AlignedBuffer::operator=(AlignedBuffer&& other) {
+    swap(data_, other.data_);
+    swap(size_, other.size_);
+    return *this;
+}
+
 StorageManager::StorageManager(const string& filename) 
-    : filename_(filename) {
+    : filename_(filename),
+      fd_(-1),
+      direct_io_(false),
+      mapped_(false),
+      map_(nullptr),
+      map_size_(0),
+      root_block_(-1),
+      height_(0),
+      key_count_(0),
+      stats_known_(true),
+      format_version_(FORMAT_VERSION),
+      superblock_valid_(true),
+      reserved_blocks_(SUPERBLOCK_BLOCKS),
+      layout_(),
+      free_hint_(0),
+      used_blocks_(0),
+      bitmap_capacity_((SUPERBLOCK_BLOCKS * BLOCK_SIZE - header_bytes(FORMAT_VERSION)) / sizeof(uint64_t)) {
 }
 
 StorageManager::~StorageManager() {
     shutdown();
 }
 
+bool StorageManager::RecordLayout::operator==(const RecordLayout& other) const {
+    return key_tag == other.key_tag && key_min_bytes == other.key_min_bytes &&
+           key_max_bytes == other.key_max_bytes && value_tag == other.value_tag &&
+           value_min_bytes == other.value_min_bytes && value_max_bytes == other.value_max_bytes;
+}
+
+void StorageManager::set_record_layout(const RecordLayout& layout) {
+    layout_ = layout;
+}
+
+void StorageManager::set_direct_io(bool enabled) {
+    direct_io_ = enabled;
+}
+
+bool StorageManager::direct_io() const {
+    return direct_io_;
+}
+
+void StorageManager::set_memory_mapped(bool enabled) {
+    mapped_ = enabled;
+}
+
+bool StorageManager::memory_mapped() const {
+    return mapped_;
+}
+
 bool StorageManager::initialize() {
-    file_.open(filename_, ios::binary | ios::in | ios::out);
-    
-    if (!file_.is_open()) {
-        // Create new file
-        file_.open(filename_, ios::binary | ios::out);
-        file_.close();
-        file_.open(filename_, ios::binary | ios::in | ios::out);
-        
-        if (!file_.is_open()) {
-            cerr << "Failed to create file: " << filename_ << endl;
-            return false;
+    if (mapped_ && direct_io_) {
+        cerr << "O_DIRECT does not apply to a mapped file: " << filename_ << endl;
+        direct_io_ = false;
+    }
+    if (direct_io_) {
+        fd_ = open(filename_.c_str(), O_RDWR | O_CREAT | O_DIRECT, 0644);
+        if (fd_ < 0 && errno == EINVAL) {
+            cerr << "O_DIRECT not supported for " << filename_ << ", using buffered I/O" << endl;
+            direct_io_ = false;
         }
-        
-        // Initialize superblock
-        int root_block = -1;
-        file_.seekp(0);
-        file_.write(reinterpret_cast<const char*>(&root_block), sizeof(int));
-        
-        // Initialize bitmap (block 0 is used for superblock)
-        bitmap_.resize(1, 0);
-        set_block_used(0);
-        save_bitmap();
-        
-        cout << "Created new database file: " << filename_ << endl;
-    } else {
-        load_bitmap();
+    }
+    if (!direct_io_) {
+        fd_ = open(filename_.c_str(), O_RDWR | O_CREAT, 0644);
+    }
+    if (fd_ < 0) {
+        cerr << "Failed to open file: " << filename_ << endl;
+        return false;
+    }
+    
+    struct stat st;
+    bool existing = fstat(fd_, &st) == 0 && st.st_size > 0;
+    if (mapped_ && !map_file(existing ? st.st_size : 0)) {
+        cerr << "Failed to map file: " << filename_ << endl;
+        return false;
+    }
+    if (existing) {
+        return load_superblock(st.st_size);
     }
     
+    // The superblock's reserved blocks are never handed out
+    root_block_ = -1;
+    bitmap_.assign(1, 0);
+    for (int block = 0; block < reserved_blocks_; block++) {
+        set_block_used(block);
+    }
+    if (!write_superblock() || fdatasync(fd_) != 0 || 
+        (mapped_ && msync(map_, map_size_, MS_SYNC) != 0)) {
+        cerr << "Failed to create file: " << filename_ << endl;
+        return false;
+    }
+    
+    cout << "Created new database file: " << filename_ << endl;
     return true;
 }
 
 void StorageManager::shutdown() {
-    if (file_.is_open()) {
-        save_bitmap();
-        file_.close();
+    if (fd_ >= 0) {
+        if (superblock_valid_) {
+            write_superblock();  // Never paper over a damaged one
+        }
+        if (map_) {
+            msync(map_, map_size_, MS_SYNC);
+            munmap(map_, map_size_);
+            map_ = nullptr;
+            map_size_ = 0;
+        }
+        fdatasync(fd_);
+        close(fd_);
+        fd_ = -1;
+    }
+}
+
+static size_t round_to_extent(size_t size) {
+    size_t extents = (max<size_t>(size, 1) + MAP_EXTENT_BYTES - 1) / MAP_EXTENT_BYTES;
+    return extents * MAP_EXTENT_BYTES;
+}
+
+bool StorageManager::map_file(size_t min_size) {
+    size_t size = round_to_extent(min_size);
+    if (ftruncate(fd_, size) != 0) {
+        return false;
+    }
+    
+    void* map = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+    if (map == MAP_FAILED) {
+        return false;
     }
+    
+    // Point lookups jump around the file; kernel readahead would only
+    // pull in blocks nobody asked for. Range scans prefetch explicitly.
+    madvise(map, size, MADV_RANDOM);
+    map_ = static_cast<char*>(map);
+    map_size_ = size;
+    return true;
 }
 
-void StorageManager::load_bitmap() {
-    lock_guard<mutex> lock(file_mutex_);
+bool StorageManager::grow_mapping(size_t min_size) {
+    unique_lock<shared_mutex> lock(map_mutex_);
+    if (min_size <= map_size_) {
+        return true;
+    }
     
-    // Read bitmap size (first 8 bytes after root block)
-    file_.seekg(BITMAP_START);
-    uint64_t bitmap_size;
-    file_.read(reinterpret_cast<char*>(&bitmap_size), sizeof(bitmap_size));
+    size_t size = round_to_extent(min_size);
+    if (ftruncate(fd_, size) != 0) {
+        cerr << "Failed to grow " << filename_ << endl;
+        return false;
+    }
     
+    void* map = mremap(map_, map_size_, size, MREMAP_MAYMOVE);
+    if (map == MAP_FAILED) {
+        cerr << "Failed to remap " << filename_ << endl;
+        return false;
+    }
+    madvise(map, size, MADV_RANDOM);
+    map_ = static_cast<char*>(map);
+    map_size_ = size;
+    return true;
+}
+
+size_t StorageManager::header_bytes(uint32_t version) {
+    return sizeof(SuperblockHeader) + (version >= RECORD_LAYOUT_VERSION ? sizeof(RecordLayout) : 0);
+}
+
+// Formats 2 and 3 never recorded a layout, so those files take the tree's
+// on trust and record it when next written
+bool StorageManager::check_layout(const char* image, uint32_t version) {
+    RecordLayout recorded;
+    if (version >= RECORD_LAYOUT_VERSION) {
+        memcpy(&recorded, image + sizeof(SuperblockHeader), sizeof(recorded));
+    } else if (version == 1) {
+        recorded = {Codec<int32_t>::TYPE_TAG, Codec<int32_t>::MIN_BYTES, Codec<int32_t>::MAX_BYTES,
+                    Codec<string>::TYPE_TAG, Codec<string>::MIN_BYTES, Codec<string>::MAX_BYTES};
+    } else {
+        return true;
+    }
+    if (recorded != layout_) {
+        cerr << "File holds other key or value types (tags " << hex << recorded.key_tag << " -> " 
+             << recorded.value_tag << ", tree has " << layout_.key_tag << " -> " << layout_.value_tag 
+             << dec << "): " << filename_ << endl;
+        return false;
+    }
+    return true;
+}
+
+// Only the superblock is read: the header and bitmap, plus the tree stats
+// that spare callers a scan of the tree
+bool StorageManager::load_superblock(size_t file_size) {
+    // Whole blocks into an aligned buffer, which O_DIRECT insists on
+    AlignedBuffer image(BLOCK_SIZE);
+    pread(fd_, image.data(), BLOCK_SIZE, 0);
+    
+    SuperblockHeader header;
+    memcpy(&header, image.data(), sizeof(header));
+    if (header.magic != MAGIC) {
+        return load_legacy_superblock(image.data(), file_size);
+    }
+    if (header.version > FORMAT_VERSION || header.block_size != static_cast<uint32_t>(BLOCK_SIZE)) {
+        cerr << "Unsupported format (version " << header.version << ", " << header.block_size 
+             << "-byte blocks): " << filename_ << endl;
+        superblock_valid_ = false;  // Left as found
+        return false;
+    }
+    
+    size_t reserved_bytes = static_cast<size_t>(header.reserved_blocks) * BLOCK_SIZE;
+    size_t prefix_bytes = header_bytes(header.version);
+    bool valid = reserved_bytes > prefix_bytes && header.bitmap_words > 0 &&
+                 header.bitmap_words <= (reserved_bytes - prefix_bytes) / sizeof(uint64_t);
+    
+    size_t image_size = prefix_bytes + (valid ? header.bitmap_words : 0) * sizeof(uint64_t);
+    if (image_size > BLOCK_SIZE) {
+        image = AlignedBuffer(image_size);
+        pread(fd_, image.data(), image.size(), 0);
+    }
+    
+    if (valid) {
+        SuperblockHeader unsigned_header = header;
+        unsigned_header.checksum = 0;
+        uint32_t checksum = crc32(image.data() + sizeof(header), image_size - sizeof(header),
+                                  crc32(&unsigned_header, sizeof(unsigned_header)));
+        valid = checksum == header.checksum;
+    }
+    
+    lock_guard<mutex> lock(meta_mutex_);
+    if (!valid) {
+        cerr << "Superblock checksum mismatch: " << filename_ << endl;
+        superblock_valid_ = false;
+        return true;    // The tree may still recover it from its log
+    }
+    if (!check_layout(image.data(), header.version)) {
+        superblock_valid_ = false;
+        return false;
+    }
+    parse_superblock(image.data());
+    return true;
+}
+
+// Format 1 files start with the root block index and the bitmap size and
+// words, and reserve only block 0. Their key count isn't recorded.
+bool StorageManager::load_legacy_superblock(const char* block, size_t file_size) {
+    const int bitmap_start = 8;     // After the root block index
+    uint64_t bitmap_size = 0;
+    memcpy(&bitmap_size, block + bitmap_start, sizeof(bitmap_size));
+    
+    size_t capacity = (BLOCK_SIZE - bitmap_start - sizeof(bitmap_size)) / sizeof(uint64_t);
+    if (bitmap_size == 0 || bitmap_size > capacity || 
+        bitmap_size > file_size / BLOCK_SIZE / 64 + 1) {
+        cerr << "Not a B-tree file, or its superblock is damaged: " << filename_ << endl;
+        superblock_valid_ = false;
+        return false;
+    }
+    
+    // Rewritten with a header once the tree is rebuilt, so the bitmap has
+    // to leave room for one
+    lock_guard<mutex> lock(meta_mutex_);
+    size_t upgraded_capacity = (BLOCK_SIZE - header_bytes(FORMAT_VERSION)) / sizeof(uint64_t);
+    if (!check_layout(block, 1) || bitmap_size > upgraded_capacity) {
+        if (bitmap_size > upgraded_capacity) {
+            cerr << "Too large to upgrade in place: " << filename_ << endl;
+        }
+        superblock_valid_ = false;
+        return false;
+    }
+    memcpy(&root_block_, block, sizeof(root_block_));
     bitmap_.resize(bitmap_size);
-    if (bitmap_size > 0) {
-        file_.read(reinterpret_cast<char*>(bitmap_.data()), 
-                   bitmap_size * sizeof(uint64_t));
+    memcpy(bitmap_.data(), block + bitmap_start + sizeof(bitmap_size), bitmap_size * sizeof(uint64_t));
+    
+    height_ = 0;
+    key_count_ = 0;
+    stats_known_ = false;
+    format_version_ = 1;
+    reserved_blocks_ = 1;
+    bitmap_capacity_ = upgraded_capacity;
+    free_hint_ = 0;
+    used_blocks_ = 0;
+    for (uint64_t word : bitmap_) {
+        used_blocks_ += __builtin_popcountll(word);
+    }
+    return true;
+}
+
+void StorageManager::parse_superblock(const char* image) {
+    SuperblockHeader header;
+    memcpy(&header, image, sizeof(header));
+    
+    root_block_ = header.root_block;
+    height_ = header.height;
+    key_count_ = header.key_count;
+    stats_known_ = true;
+    format_version_ = header.version;
+    superblock_valid_ = true;
+    reserved_blocks_ = header.reserved_blocks;
+    bitmap_capacity_ = (reserved_blocks_ * BLOCK_SIZE - header_bytes(FORMAT_VERSION)) / sizeof(uint64_t);
+    
+    bitmap_.resize(header.bitmap_words);
+    memcpy(bitmap_.data(), image + header_bytes(header.version), header.bitmap_words * sizeof(uint64_t));
+    used_blocks_ = header.used_blocks;
+    free_hint_ = min<size_t>(header.free_hint, bitmap_.size());
+}
+
+// Header, the record layout, then the bitmap words. The checksum is left
+// zero here and filled in when the image is written to the data file.
+vector<char> StorageManager::superblock_image() const {
+    lock_guard<mutex> lock(meta_mutex_);
+    
+    // Once written with a header, a format 1 file is a format 2 one, and a
+    // format 3 one records its layout
+    uint32_t version = format_version_ >= LEAF_ENTRIES_VERSION ? FORMAT_VERSION : max<uint32_t>(format_version_, 2);
+    SuperblockHeader header = {MAGIC, version, 0, static_cast<uint32_t>(BLOCK_SIZE),
+                               static_cast<uint32_t>(reserved_blocks_), root_block_, height_,
+                               key_count_, used_blocks_, free_hint_, bitmap_.size()};
+    size_t prefix_bytes = header_bytes(version);
+    vector<char> image(prefix_bytes + bitmap_.size() * sizeof(uint64_t));
+    memcpy(image.data(), &header, sizeof(header));
+    if (version >= RECORD_LAYOUT_VERSION) {
+        memcpy(image.data() + sizeof(header), &layout_, sizeof(layout_));
     }
+    memcpy(image.data() + prefix_bytes, bitmap_.data(), bitmap_.size() * sizeof(uint64_t));
+    return image;
 }
 
-void StorageManager::save_bitmap() {
-    lock_guard<mutex> lock(file_mutex_);
+bool StorageManager::install_superblock(const vector<char>& image) {
+    SuperblockHeader header;
+    if (image.size() < sizeof(header)) {
+        return false;
+    }
+    memcpy(&header, image.data(), sizeof(header));
+    if (header.magic != MAGIC || header.version > FORMAT_VERSION ||
+        image.size() != header_bytes(header.version) + header.bitmap_words * sizeof(uint64_t)) {
+        return false;
+    }
     
-    file_.seekp(BITMAP_START);
-    uint64_t bitmap_size = bitmap_.size();
-    file_.write(reinterpret_cast<const char*>(&bitmap_size), sizeof(bitmap_size));
-    file_.write(reinterpret_cast<const char*>(bitmap_.data()), 
-                bitmap_size * sizeof(uint64_t));
-    file_.flush();
+    lock_guard<mutex> lock(meta_mutex_);
+    if (!check_layout(image.data(), header.version)) {
+        return false;
+    }
+    parse_superblock(image.data());
+    return true;
+}
+
+bool StorageManager::write_superblock() {
+    return write_superblock_image(superblock_image());
+}
+
+bool StorageManager::write_superblock_image(const vector<char>& image) {
+    AlignedBuffer header(image.size());
+    memcpy(header.data(), image.data(), image.size());
+    
+    uint32_t checksum = crc32(header.data(), image.size());
+    memcpy(header.data() + offsetof(SuperblockHeader, checksum), &checksum, sizeof(checksum));
+    
+    if (map_) {
+        shared_lock<shared_mutex> map_lock(map_mutex_);
+        memcpy(map_, header.data(), min(header.size(), map_size_));
+        return header.size() <= map_size_;
+    }
+    return pwrite(fd_, header.data(), header.size(), 0) == static_cast<ssize_t>(header.size());
+}
+
+bool StorageManager::checkpoint(const vector<char>& superblock) {
+    bool ok = write_superblock_image(superblock);
+    ok = sync() && ok;
+    if (!ok) {
+        cerr << "Checkpoint failed on " << filename_ << endl;
+    }
+    return ok;
+}
+
+bool StorageManager::is_aligned(const char* buffer) const {
+    return reinterpret_cast<uintptr_t>(buffer) % BLOCK_SIZE == 0;
 }
 
 bool StorageManager::is_block_free(int block_index) const {
@@ -98,77 +427,235 @@ void StorageManager::set_block_used(int block_index) {
         bitmap_.resize(word_index + 1, 0);
     }
     
-    bitmap_[word_index] |= (1ULL << bit_index);
+    if (!(bitmap_[word_index] & (1ULL << bit_index))) {
+        bitmap_[word_index] |= (1ULL << bit_index);
+        used_blocks_++;
+    }
 }
 
 void StorageManager::set_block_free(int block_index) {
     int word_index = block_index / 64;
     int bit_index = block_index % 64;
     
-    if (word_index < static_cast<int>(bitmap_.size())) {
+    if (word_index < static_cast<int>(bitmap_.size()) && (bitmap_[word_index] & (1ULL << bit_index))) {
         bitmap_[word_index] &= ~(1ULL << bit_index);
+        used_blocks_--;
+        free_hint_ = min(free_hint_, static_cast<size_t>(word_index));
     }
 }
 
 int StorageManager::allocate_block() {
-    // Find first free block
-    for (int i = 0; i < static_cast<int>(bitmap_.size() * 64); i++) {
-        if (is_block_free(i)) {
-            set_block_used(i);
-            
-            // Initialize block with zeros
-            char buffer[BLOCK_SIZE] = {0};
-            write_block(i, buffer);
-            
-            return i;
-        }
-    }
+    lock_guard<mutex> lock(meta_mutex_);
     
-    // No free block found, extend file and bitmap
-    int new_block = bitmap_.size() * 64;
-    set_block_used(new_block);
+    // Skip full words from the hint, then take the lowest clear bit. The
+    // hint only moves back when a block is freed, so each full word is
+    // passed over once between frees.
+    while (free_hint_ < bitmap_.size() && bitmap_[free_hint_] == ~0ULL) {
+        free_hint_++;
+    }
+    if (free_hint_ >= bitmap_capacity_) {
+        cerr << "No free blocks left in " << filename_ << endl;
+        return -1;
+    }
+    int block = free_hint_ * 64;
+    if (free_hint_ < bitmap_.size()) {
+        block += __builtin_ctzll(~bitmap_[free_hint_]);
+    }
     
-    // Initialize new block
-    char buffer[BLOCK_SIZE] = {0};
-    write_block(new_block, buffer);
+    // Past the bitmap's last word this extends the file and bitmap
+    set_block_used(block);
+    if (map_) {
+        grow_mapping(static_cast<size_t>(block + 1) * BLOCK_SIZE);
+    }
     
-    return new_block;
+    // No zero fill: the tree saves every node it allocates, and blocks past
+    // the end of the file read back as zeros
+    return block;
 }
 
 void StorageManager::deallocate_block(int block_index) {
-    if (block_index > 0) { // Don't deallocate superblock
+    lock_guard<mutex> lock(meta_mutex_);
+    if (block_index >= reserved_blocks_) { // Don't deallocate the superblock
         set_block_free(block_index);
     }
 }
 
+// pread/pwrite carry their own offsets, so calls from the tree and the
+// writer thread need no lock around the descriptor
 void StorageManager::read_block(int block_index, char* buffer) {
-    lock_guard<mutex> lock(file_mutex_);
+    if (map_) {
+        visit_block(block_index, [buffer](const char* data) { memcpy(buffer, data, BLOCK_SIZE); });
+        return;
+    }
     
-    file_.seekg(block_index * BLOCK_SIZE);
-    file_.read(buffer, BLOCK_SIZE);
+    off_t offset = static_cast<off_t>(block_index) * BLOCK_SIZE;
+    
+    // O_DIRECT needs an aligned destination; bounce the odd caller that
+    // doesn't provide one
+    AlignedBuffer bounce(direct_io_ && !is_aligned(buffer) ? BLOCK_SIZE : 0);
+    char* target = bounce.size() ? bounce.data() : buffer;
+    
+    ssize_t got = max<ssize_t>(pread(fd_, target, BLOCK_SIZE, offset), 0);
+    if (got < BLOCK_SIZE) {
+        memset(target + got, 0, BLOCK_SIZE - got);  // Past EOF
+    }
+    if (target != buffer) {
+        memcpy(buffer, target, BLOCK_SIZE);
+    }
 }
 
 void StorageManager::write_block(int block_index, const char* buffer) {
-    lock_guard<mutex> lock(file_mutex_);
+    write_blocks({{block_index, buffer}});
+}
+
+void StorageManager::visit_block(int block_index, const function<void(const char*)>& fn) {
+    size_t offset = static_cast<size_t>(block_index) * BLOCK_SIZE;
+    if (map_) {
+        shared_lock<shared_mutex> lock(map_mutex_);
+        if (offset + BLOCK_SIZE <= map_size_) {
+            fn(map_ + offset);
+            return;
+        }
+    }
+    
+    alignas(BLOCK_SIZE) char buffer[BLOCK_SIZE];
+    if (map_) {
+        memset(buffer, 0, BLOCK_SIZE);  // Past the end of the mapping
+    } else {
+        read_block(block_index, buffer);
+    }
+    fn(buffer);
+}
+
+void StorageManager::prefetch(const vector<int>& blocks) {
+    if (map_) {
+        shared_lock<shared_mutex> lock(map_mutex_);
+        for (int block : blocks) {
+            size_t offset = static_cast<size_t>(block) * BLOCK_SIZE;
+            if (offset + BLOCK_SIZE <= map_size_) {
+                madvise(map_ + offset, BLOCK_SIZE, MADV_WILLNEED);
+            }
+        }
+    } else if (!direct_io_) {
+        for (int block : blocks) {
+            posix_fadvise(fd_, static_cast<off_t>(block) * BLOCK_SIZE, BLOCK_SIZE, POSIX_FADV_WILLNEED);
+        }
+    }
+}
+
+// Each run of neighbouring blocks goes out in one pwritev. Under O_DIRECT,
+// unaligned blocks are staged into one aligned buffer per run instead.
+bool StorageManager::write_blocks(const vector<pair<int, const char*>>& blocks) {
+    if (map_) {
+        // Replayed blocks can lie past a mapping sized from the superblock
+        size_t needed = 0;
+        for (const auto& block : blocks) {
+            needed = max(needed, static_cast<size_t>(block.first + 1) * BLOCK_SIZE);
+        }
+        grow_mapping(needed);
+        
+        shared_lock<shared_mutex> lock(map_mutex_);
+        for (const auto& block : blocks) {
+            size_t offset = static_cast<size_t>(block.first) * BLOCK_SIZE;
+            if (offset + BLOCK_SIZE > map_size_) {
+                cerr << "Write past the mapping at block " << block.first << " in " << filename_ << endl;
+                return false;
+            }
+            memcpy(map_ + offset, block.second, BLOCK_SIZE);
+        }
+        return true;
+    }
     
-    file_.seekp(block_index * BLOCK_SIZE);
-    file_.write(buffer, BLOCK_SIZE);
-    file_.flush();
+    bool ok = true;
+    size_t i = 0;
+    while (i < blocks.size()) {
+        vector<struct iovec> run;
+        bool aligned = true;
+        int first = blocks[i].first;
+        while (i < blocks.size() && blocks[i].first == first + static_cast<int>(run.size()) && 
+               run.size() < IOV_MAX) {
+            run.push_back({const_cast<char*>(blocks[i].second), static_cast<size_t>(BLOCK_SIZE)});
+            aligned = aligned && is_aligned(blocks[i].second);
+            i++;
+        }
+        
+        ssize_t expected = static_cast<ssize_t>(run.size()) * BLOCK_SIZE;
+        AlignedBuffer staged(direct_io_ && !aligned ? expected : 0);
+        if (staged.size()) {
+            for (size_t b = 0; b < run.size(); b++) {
+                memcpy(staged.data() + b * BLOCK_SIZE, run[b].iov_base, BLOCK_SIZE);
+            }
+            run.assign(1, {staged.data(), staged.size()});
+        }
+        
+        if (pwritev(fd_, run.data(), run.size(), static_cast<off_t>(first) * BLOCK_SIZE) != expected) {
+            cerr << "Short write at block " << first << " in " << filename_ << endl;
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+bool StorageManager::commit(const vector<pair<int, const char*>>& blocks) {
+    bool ok = write_blocks(blocks);
+    ok = write_superblock() && ok;
+    return sync() && ok;
+}
+
+bool StorageManager::sync() {
+    if (map_) {
+        shared_lock<shared_mutex> lock(map_mutex_);
+        if (msync(map_, map_size_, MS_SYNC) != 0) {
+            cerr << "msync failed on " << filename_ << endl;
+            return false;
+        }
+    } else if (fdatasync(fd_) != 0) {
+        cerr << "fdatasync failed on " << filename_ << endl;
+        return false;
+    }
+    return true;
 }
 
 int StorageManager::get_root_block() const {
-    lock_guard<mutex> lock(file_mutex_);
-    
-    int root_block = -1;
-    file_.seekg(0);
-    file_.read(reinterpret_cast<char*>(&root_block), sizeof(int));
-    return root_block;
+    lock_guard<mutex> lock(meta_mutex_);
+    return root_block_;
 }
 
 void StorageManager::set_root_block(int root_block) {
-    lock_guard<mutex> lock(file_mutex_);
-    
-    file_.seekp(0);
-    file_.write(reinterpret_cast<const char*>(&root_block), sizeof(int));
-    file_.flush();
-}
\ No newline at end of file
+    lock_guard<mutex> lock(meta_mutex_);
+    root_block_ = root_block;
+}
+
+bool StorageManager::get_tree_stats(uint64_t& key_count, int& height) const {
+    lock_guard<mutex> lock(meta_mutex_);
+    key_count = key_count_;
+    height = height_;
+    return stats_known_;
+}
+
+void StorageManager::set_tree_stats(uint64_t key_count, int height) {
+    lock_guard<mutex> lock(meta_mutex_);
+    key_count_ = key_count;
+    height_ = height;
+    stats_known_ = true;
+}
+
+bool StorageManager::entries_in_leaves() const {
+    lock_guard<mutex> lock(meta_mutex_);
+    return format_version_ >= LEAF_ENTRIES_VERSION;
+}
+
+void StorageManager::upgrade_format() {
+    lock_guard<mutex> lock(meta_mutex_);
+    format_version_ = FORMAT_VERSION;
+}
+
+size_t StorageManager::free_blocks() const {
+    lock_guard<mutex> lock(meta_mutex_);
+    return bitmap_capacity_ * 64 - used_blocks_;
+}
+
+bool StorageManager::superblock_valid() const {
+    lock_guard<mutex> lock(meta_mutex_);
+    return superblock_valid_;
+}
@@ -1,47 +1,190 @@
 #ifndef STORAGE_MANAGER_H
 #define STORAGE_MANAGER_H
 
-#include <fstream>
 #include <string>
 #include <vector>
 #include <mutex>
+#include <shared_mutex>
+#include <functional>
 #include <cstdint>
+#include <utility>
 
 // Forward declare constants (defined in constants.h)
 extern const int BLOCK_SIZE;
 
+// Zeroed heap buffer of whole blocks, aligned to BLOCK_SIZE as O_DIRECT
+// requires. A size of 0 holds nothing.
+class AlignedBuffer {
+public:
+    explicit AlignedBuffer(size_t size);
+    ~AlignedBuffer();
+    AlignedBuffer(const AlignedBuffer&) = delete;
+    AlignedBuffer& operator=(const AlignedBuffer&) = delete;
+    AlignedBuffer& operator=(AlignedBuffer&& other);
+    
+    char* data() { return data_; }
+    size_t size() const { return size_; }   // Rounded up to whole blocks
+    
+private:
+    char* data_;
+    size_t size_;
+};
+
 class StorageManager {
 public:
+    // What the tree's blocks hold: the key and value codecs' type tags and
+    // byte bounds. Recorded from format 4 on; initialize refuses a file
+    // recorded with another layout.
+    struct RecordLayout {
+        uint32_t key_tag;
+        uint32_t key_min_bytes;
+        uint32_t key_max_bytes;
+        uint32_t value_tag;
+        uint32_t value_min_bytes;
+        uint32_t value_max_bytes;
+        
+        bool operator==(const RecordLayout& other) const;
+        bool operator!=(const RecordLayout& other) const { return !(*this == other); }
+    };
+    
     StorageManager(const std::string& filename);
     ~StorageManager();
     
     bool initialize();
     void shutdown();
     
+    // Set before initialize. Files without a recorded layout take this one;
+    // format 1 files only ever held int -> string.
+    void set_record_layout(const RecordLayout& layout);
+    
+    // Bypass the page cache with O_DIRECT (set before initialize). Worth it
+    // when a BufferPool above does the caching; falls back to buffered I/O on
+    // filesystems that refuse it.
+    void set_direct_io(bool enabled);
+    bool direct_io() const;
+    
+    // Map the file instead (set before initialize). Reads come straight from
+    // the mapping, writes are copies into it and commits msync it. The file
+    // grows in MAP_EXTENT_BYTES steps. Takes precedence over O_DIRECT.
+    void set_memory_mapped(bool enabled);
+    bool memory_mapped() const;
+    
     // Block management
     int allocate_block();
     void deallocate_block(int block_index);
     void read_block(int block_index, char* buffer);
     void write_block(int block_index, const char* buffer);
     
-    // Superblock operations
+    // Hands fn the block's bytes without an extra copy when the file is
+    // mapped. The pointer is only good for the duration of the call.
+    void visit_block(int block_index, const std::function<void(const char*)>& fn);
+    
+    // Hint that these blocks are about to be read (a range scan)
+    void prefetch(const std::vector<int>& blocks);
+    
+    // Batched writes, sorted by block. write_blocks leaves them to the page
+    // cache; commit also writes the superblock and waits for one fdatasync.
+    bool write_blocks(const std::vector<std::pair<int, const char*>>& blocks);
+    bool commit(const std::vector<std::pair<int, const char*>>& blocks);
+    bool sync();    // Waits for everything written so far, superblock aside
+    
+    // Superblock operations. The root, tree stats and bitmap live in memory
+    // and reach the file with the next commit (or shutdown).
     int get_root_block() const;
     void set_root_block(int root_block);
     
+    // Key count and height of the tree, so opening it needs no scan. False
+    // for files written before the superblock kept them.
+    bool get_tree_stats(uint64_t& key_count, int& height) const;
+    void set_tree_stats(uint64_t key_count, int height);
+    
+    // Before format 3 internal nodes held entries as well as leaves. The
+    // tree rebuilds such files when it opens them; upgrade_format marks the
+    // superblock current, to be written along with the rebuilt root.
+    bool entries_in_leaves() const;
+    void upgrade_format();
+    
+    // Blocks allocate_block can still hand out before the bitmap outgrows
+    // the superblock's reserved blocks
+    size_t free_blocks() const;
+    
+    // False when the superblock failed its checksum. Only the write-ahead
+    // log can bring such a file back, by installing a logged superblock.
+    bool superblock_valid() const;
+    
+    // Checkpointing for the write-ahead log. superblock_image captures the
+    // superblock as it would be written; checkpoint writes such an image and
+    // syncs the data file; install_superblock adopts a replayed one (false
+    // if it isn't one).
+    std::vector<char> superblock_image() const;
+    bool checkpoint(const std::vector<char>& superblock);
+    bool install_superblock(const std::vector<char>& superblock);
+    
 private:
+    // Start of block 0. From format 4 the record layout follows it, then
+    // the allocation bitmap, and all of it may span the first
+    // reserved_blocks blocks of the file.
+    struct SuperblockHeader {
+        uint64_t magic;
+        uint32_t version;
+        uint32_t checksum;          // CRC of the header (this field zeroed) and bitmap
+        uint32_t block_size;
+        uint32_t reserved_blocks;
+        int32_t root_block;
+        int32_t height;
+        uint64_t key_count;
+        uint64_t used_blocks;
+        uint64_t free_hint;
+        uint64_t bitmap_words;
+    };
+    
+    static const uint64_t MAGIC = 0x4B4F4C4245455254ULL;   // "TREEBLOK" on disk
+    static const uint32_t FORMAT_VERSION = 4;   // 1: root and bitmap only, no header; 2: classic B-tree
+    static const uint32_t LEAF_ENTRIES_VERSION = 3;
+    static const uint32_t RECORD_LAYOUT_VERSION = 4;
+    
     std::string filename_;
-    mutable std::fstream file_;
-    mutable std::mutex file_mutex_;
+    int fd_;
+    bool direct_io_;
+    
+    // Mapped mode. Readers and writers of the mapping hold map_mutex_ shared;
+    // growing it (which may move it) holds it exclusively.
+    bool mapped_;
+    char* map_;
+    size_t map_size_;
+    mutable std::shared_mutex map_mutex_;
+    
+    // Guards the superblock fields, which the tree changes while the writer
+    // thread commits them
+    mutable std::mutex meta_mutex_;
+    int root_block_;
+    int height_;
+    uint64_t key_count_;
+    bool stats_known_;
+    uint32_t format_version_;   // Of the file as loaded, until upgrade_format
+    bool superblock_valid_;
+    int reserved_blocks_;
+    RecordLayout layout_;
     
     // Bitmap management
     std::vector<uint64_t> bitmap_; // Using uint64_t for efficient bit operations
-    static const int BITMAP_START = 8; // After root block index
+    size_t free_hint_;             // No word before this one has a free bit
+    size_t used_blocks_;
+    size_t bitmap_capacity_;       // Words that fit in the reserved blocks
     
-    void load_bitmap();
-    void save_bitmap();
+    bool is_aligned(const char* buffer) const;
+    bool map_file(size_t min_size);
+    bool grow_mapping(size_t min_size);
+    static size_t header_bytes(uint32_t version);
+    bool check_layout(const char* image, uint32_t version);
+    bool load_superblock(size_t file_size);
+    bool load_legacy_superblock(const char* block, size_t file_size);
+    void parse_superblock(const char* image);
+    bool write_superblock();
+    bool write_superblock_image(const std::vector<char>& image);
     bool is_block_free(int block_index) const;
     void set_block_used(int block_index);
     void set_block_free(int block_index);
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -5,7 +5,7 @@
 using namespace std;
 
 int main() {
-    BTree tree("test_flights.dat");
+    BTree<time_t, string> tree("test_flights.dat");
     
     if (!tree.initialize()) {
         cout << "Failed to initialize B-Tree" << endl;
@@ -0,0 +1,145 @@
+#include "buffer_pool.h"
+#include "test_support.h"
+#include <random>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+// The pool on its own, with a loader that makes empty nodes and counts the
+// copies of each block alive, which must never be more than one
+
+static const int BLOCKS = 64;
+static const size_t NODE_BYTES = 1000;
+static atomic<int> live[BLOCKS];
+static atomic<int> loads(0);
+
+class CountedNode : public NodeBase {
+public:
+    explicit CountedNode(int block_index) : NodeBase(block_index) {
+        CHECK(++live[block_index] == 1);
+    }
+    ~CountedNode() { live[block_index]--; }
+};
+
+static NodeBase* load_counted(int block_index) {
+    loads++;
+    return new CountedNode(block_index);
+}
+
+static void test_budget() {
+    BufferPool pool(load_counted, 4 * NODE_BYTES, NODE_BYTES);
+    for (int block = 0; block < 10; block++) {
+        NodeBase* node = pool.pin(block);
+        CHECK(node->block_index == block);
+        pool.unpin(node);
+    }
+    BufferPool::Stats stats = pool.stats();
+    CHECK(stats.misses == 10);
+    CHECK(stats.evictions == 6);
+    CHECK(stats.resident_bytes <= stats.budget_bytes);
+
+    // A hit hands back the node already there
+    NodeBase* first = pool.pin(9);
+    NodeBase* second = pool.pin(9);
+    CHECK(first == second);
+    CHECK(pool.stats().hits == 2);
+    pool.unpin(first);
+    pool.unpin(second);
+}
+
+// A frame used since the hand last passed gets a second chance
+static void test_clock() {
+    BufferPool pool(load_counted, 4 * NODE_BYTES, NODE_BYTES);
+    for (int block = 0; block < 4; block++) {
+        pool.unpin(pool.pin(block));
+    }
+    pool.unpin(pool.pin(4));    // The hand clears every bit, then takes block 0
+    CHECK(!pool.contains(0));
+    pool.unpin(pool.pin(1));
+    pool.unpin(pool.pin(5));
+    CHECK(pool.contains(1));
+    CHECK(!pool.contains(2));
+}
+
+// Pinned nodes stay put, past the budget if they have to, and the pool
+// shrinks back once they are released
+static void test_pinned() {
+    BufferPool pool(load_counted, 4 * NODE_BYTES, NODE_BYTES);
+    vector<NodeBase*> pinned;
+    for (int block = 0; block < 8; block++) {
+        pinned.push_back(pool.pin(block));
+    }
+    CHECK(pool.stats().resident_bytes == 8 * NODE_BYTES);
+    for (int block = 0; block < 8; block++) {
+        CHECK(pool.pin(block) == pinned[block]);
+        pool.unpin(pinned[block]);
+    }
+    for (NodeBase* node : pinned) {
+        pool.unpin(node);
+    }
+    CHECK(pool.stats().resident_bytes <= 4 * NODE_BYTES);
+
+    NodeBase* kept = pool.pin(20);
+    for (int block = 30; block < 60; block++) {
+        pool.unpin(pool.pin(block));
+    }
+    CHECK(pool.pin(20) == kept);
+    pool.unpin(kept);
+    pool.unpin(kept);
+}
+
+// A discarded node leaves the index at once and goes with its last pin
+static void test_discard() {
+    BufferPool pool(load_counted, 4 * NODE_BYTES, NODE_BYTES);
+    NodeBase* node = pool.pin_new(new CountedNode(7));
+    uint64_t version;
+    CHECK(node->latch.read_begin(version));
+    pool.discard(node);
+    CHECK(!pool.contains(7));
+    CHECK(!node->latch.read_begin(version));    // Readers holding it see it was freed
+    CHECK(live[7] == 1);
+    pool.unpin(node);
+    CHECK(live[7] == 0);
+
+    int before = loads;
+    pool.unpin(pool.pin(7));
+    CHECK(loads == before + 1);
+}
+
+// Threads pinning at random in a pool a quarter the size of the blocks
+// always get the block they asked for, and never a second copy of one
+static void test_concurrent() {
+    BufferPool pool(load_counted, BLOCKS / 4 * NODE_BYTES, NODE_BYTES);
+    vector<thread> threads;
+    for (int t = 0; t < 8; t++) {
+        threads.emplace_back([&pool, t]() {
+            mt19937 rng(t);
+            for (int i = 0; i < 100000; i++) {
+                int block = rng() % BLOCKS;
+                NodeBase* node = pool.pin(block);
+                CHECK(node->block_index == block);
+                CHECK(live[block] == 1);
+                pool.unpin(node);
+            }
+        });
+    }
+    for (thread& t : threads) {
+        t.join();
+    }
+    BufferPool::Stats stats = pool.stats();
+    CHECK(stats.hits + stats.misses == 800000);
+    CHECK(stats.resident_bytes <= stats.budget_bytes);
+}
+
+int main() {
+    test_budget();
+    test_clock();
+    test_pinned();
+    test_discard();
+    test_concurrent();
+    for (int block = 0; block < BLOCKS; block++) {
+        CHECK(live[block] == 0);
+    }
+    return test_result("test_buffer_pool");
+}
@@ -0,0 +1,155 @@
+#include "Btree.h"
+#include "test_support.h"
+#include <algorithm>
+#include <random>
+#include <sys/stat.h>
+
+using namespace std;
+
+typedef BTree<int, string> Tree;
+typedef vector<pair<int, string>> Entries;
+
+static const string FILENAME = "test_bulk_load.dat";
+
+static Entries sorted_entries(int count) {
+    Entries entries;
+    for (int key = 0; key < count; key++) {
+        entries.push_back(make_pair(key * 2, "F" + to_string(key)));
+    }
+    return entries;
+}
+
+// The tree holds exactly entries, in order both ways along the leaves and
+// through a search for each
+static void check_holds(Tree& tree, const Entries& entries) {
+    CHECK(tree.get_flight_count() == static_cast<int>(entries.size()));
+    CHECK(tree.get_all() == entries);
+
+    size_t i = entries.size();
+    for (auto cursor = tree.last(); cursor.valid(); cursor.prev()) {
+        if (!CHECK(i > 0 && cursor.key() == entries[i - 1].first)) {
+            break;
+        }
+        i--;
+    }
+    CHECK(i == 0);
+
+    vector<int> path;
+    for (const auto& entry : entries) {
+        string value;
+        path.clear();
+        if (!CHECK(tree.search(entry.first, value, path) && value == entry.second)) {
+            break;
+        }
+    }
+}
+
+static off_t file_size() {
+    struct stat st;
+    return stat(FILENAME.c_str(), &st) == 0 ? st.st_size : 0;
+}
+
+// Entries survive reopening, and the tree built takes changes as usual.
+// Returns the size of the file it made.
+static off_t test_sorted(double fill_factor) {
+    Entries entries = sorted_entries(50000);
+    remove_tree_files(FILENAME);
+    {
+        Tree tree(FILENAME);
+        CHECK(tree.initialize());
+        CHECK(tree.bulk_load(entries.begin(), entries.end(), fill_factor));
+        check_holds(tree, entries);
+    }
+    off_t size = file_size();
+    {
+        Tree tree(FILENAME);
+        CHECK(tree.initialize());
+        check_holds(tree, entries);
+
+        for (int key = 1; key < 20000; key += 2) {
+            CHECK(tree.insert(key, "odd"));
+        }
+        for (int i = 0; i < 20000; i += 4) {
+            CHECK(tree.remove(entries[i].first, entries[i].second));
+        }
+    }
+    {
+        Tree tree(FILENAME);
+        CHECK(tree.initialize());
+        Entries expected;
+        for (const auto& entry : sorted_entries(50000)) {
+            if (entry.first >= 40000 || (entry.first / 2) % 4 != 0) {
+                expected.push_back(entry);
+            }
+        }
+        for (int key = 1; key < 20000; key += 2) {
+            expected.push_back(make_pair(key, string("odd")));
+        }
+        sort(expected.begin(), expected.end());
+        check_holds(tree, expected);
+    }
+    remove_tree_files(FILENAME);
+    return size;
+}
+
+// Bad input leaves the tree empty and still usable
+static void test_rejected() {
+    remove_tree_files(FILENAME);
+    Tree tree(FILENAME);
+    CHECK(tree.initialize());
+
+    Entries unordered = sorted_entries(1000);
+    swap(unordered[500], unordered[501]);
+    CHECK(!tree.bulk_load(unordered.begin(), unordered.end()));
+    CHECK(tree.get_flight_count() == 0 && tree.get_all().empty());
+
+    Entries repeated = sorted_entries(1000);
+    repeated.insert(repeated.begin() + 10, repeated[10]);
+    CHECK(!tree.bulk_load(repeated.begin(), repeated.end()));
+
+    Entries too_long = sorted_entries(1000);
+    too_long[999].second = string(MAX_VALUE_SIZE + 1, 'x');
+    CHECK(!tree.bulk_load(too_long.begin(), too_long.end()));
+    CHECK(tree.get_all().empty());
+
+    Entries entries = sorted_entries(1000);
+    CHECK(tree.bulk_load(entries.begin(), entries.end()));
+    CHECK(!tree.bulk_load(entries.begin(), entries.end()));   // No longer empty
+    check_holds(tree, entries);
+    tree.shutdown();
+    remove_tree_files(FILENAME);
+}
+
+// Shuffled entries, each given twice, load once each in order
+static void test_unsorted() {
+    Entries entries = sorted_entries(100000);
+    Entries shuffled = entries;
+    shuffled.insert(shuffled.end(), entries.begin(), entries.end());
+    shuffle(shuffled.begin(), shuffled.end(), mt19937(5));
+
+    remove_tree_files(FILENAME);
+    Tree tree(FILENAME);
+    CHECK(tree.initialize());
+    size_t next = 0;
+    CHECK(tree.bulk_load_unsorted([&shuffled, &next](int& key, string& value) {
+        if (next == shuffled.size()) {
+            return false;
+        }
+        key = shuffled[next].first;
+        value = shuffled[next].second;
+        next++;
+        return true;
+    }));
+    check_holds(tree, entries);
+    tree.shutdown();
+    remove_tree_files(FILENAME);
+}
+
+int main() {
+    off_t full = test_sorted(1.0);
+    off_t half = test_sorted(0.5);
+    CHECK(half > full * 3 / 2);     // Leaves about half full take about twice the blocks
+    test_rejected();
+    test_unsorted();
+    return test_result("test_bulk_load");
+}
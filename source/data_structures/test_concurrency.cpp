@@ -0,0 +1,153 @@
+#include "Btree.h"
+#include "test_support.h"
+#include <chrono>
+#include <climits>
+#include <random>
+#include <set>
+#include <thread>
+
+using namespace std;
+
+// Readers search and scan both ways while writers insert and remove, over a
+// tree of int values, which readers copy optimistically, and one of string
+// values, which they read under the shared latch. Every tenth key is loaded
+// first and never removed, so readers know those must always be found, and
+// every value is a function of its key, so a torn read shows.
+
+static const int KEYS = 100000;
+static const int READERS = 4;
+static const int WRITERS = 2;
+
+template <typename Value> Value value_of(int key);
+template <> int value_of<int>(int key) { return key * 3 + 1; }
+template <> string value_of<string>(int key) { return to_string(key) + string(key % 50, 'a' + key % 26); }
+
+template <typename Value>
+static void read_concurrently(BTree<int, Value>& tree, unsigned seed, const atomic<bool>& stop) {
+    mt19937 rng(seed);
+    vector<int> path;
+    while (!stop) {
+        int op = rng() % 10;
+        int key = rng() % KEYS;
+        if (op < 6) {
+            Value value;
+            path.clear();
+            bool found = tree.search(key, value, path);
+            if (key % 10 == 0) {
+                CHECK(found);
+            }
+            if (found) {
+                CHECK(value == value_of<Value>(key));
+            }
+        } else if (op < 8) {
+            // Forward from a stable key, which must be there, and every
+            // stable key after it must be passed in order
+            int stable = key / 10 * 10;
+            int previous = INT_MIN;
+            auto cursor = tree.seek(stable);
+            for (int i = 0; i < 500 && cursor.valid(); i++, cursor.next()) {
+                int current = cursor.key();
+                CHECK(current > previous);
+                CHECK(cursor.value() == value_of<Value>(current));
+                CHECK(current <= stable || stable >= KEYS);
+                while (stable <= current) {
+                    stable += 10;
+                }
+                previous = current;
+            }
+        } else {
+            int stable = key / 10 * 10;
+            int previous = INT_MAX;
+            auto cursor = tree.seek(stable);
+            if (!CHECK(cursor.valid() && cursor.key() == stable)) {
+                continue;
+            }
+            for (int i = 0; i < 500 && cursor.valid(); i++, cursor.prev()) {
+                int current = cursor.key();
+                CHECK(current < previous);
+                CHECK(cursor.value() == value_of<Value>(current));
+                CHECK(current >= stable);
+                while (stable >= current) {
+                    stable -= 10;
+                }
+                previous = current;
+            }
+        }
+    }
+}
+
+template <typename Value>
+static void run(const string& filename) {
+    remove_tree_files(filename);
+    // A cache far smaller than the tree, so readers also race evictions
+    BTree<int, Value> tree(filename, 256 * 1024);
+    tree.set_commit_policy(COMMIT_ON_SHUTDOWN);
+    if (!CHECK(tree.initialize())) {
+        return;
+    }
+
+    vector<pair<int, Value>> stable;
+    for (int key = 0; key < KEYS; key += 10) {
+        stable.push_back(make_pair(key, value_of<Value>(key)));
+    }
+    if (!CHECK(tree.bulk_load(stable.begin(), stable.end(), 0.7))) {
+        return;
+    }
+
+    // Each writer owns the keys k with (k / 10) % WRITERS its own, so it
+    // knows what it left behind
+    atomic<bool> stop(false);
+    vector<set<int>> written(WRITERS);
+    vector<thread> threads;
+    for (int i = 0; i < READERS; i++) {
+        threads.emplace_back([&tree, &stop, i]() { read_concurrently(tree, 100 + i, stop); });
+    }
+    for (int w = 0; w < WRITERS; w++) {
+        threads.emplace_back([&tree, &stop, &written, w]() {
+            mt19937 rng(w + 1);
+            while (!stop) {
+                int key = rng() % KEYS;
+                if (key % 10 == 0 || (key / 10) % WRITERS != w) {
+                    continue;
+                }
+                if (written[w].count(key)) {
+                    CHECK(tree.remove(key, value_of<Value>(key)));
+                    written[w].erase(key);
+                } else {
+                    CHECK(tree.insert(key, value_of<Value>(key)));
+                    written[w].insert(key);
+                }
+            }
+        });
+    }
+    this_thread::sleep_for(chrono::seconds(2));
+    stop = true;
+    for (thread& t : threads) {
+        t.join();
+    }
+
+    set<int> expected;
+    for (int key = 0; key < KEYS; key += 10) {
+        expected.insert(key);
+    }
+    for (const set<int>& keys : written) {
+        expected.insert(keys.begin(), keys.end());
+    }
+    auto all = tree.get_all();
+    CHECK(all.size() == expected.size());
+    CHECK(tree.get_flight_count() == static_cast<int>(expected.size()));
+    auto it = expected.begin();
+    for (size_t i = 0; i < all.size() && it != expected.end(); i++, ++it) {
+        if (!CHECK(all[i].first == *it && all[i].second == value_of<Value>(*it))) {
+            break;
+        }
+    }
+    tree.shutdown();
+    remove_tree_files(filename);
+}
+
+int main() {
+    run<int>("test_concurrency_int.dat");
+    run<string>("test_concurrency_string.dat");
+    return test_result("test_concurrency");
+}
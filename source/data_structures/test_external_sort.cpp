@@ -0,0 +1,99 @@
+#include "external_sort.h"
+#include "test_support.h"
+#include <algorithm>
+#include <random>
+#include <set>
+
+using namespace std;
+
+typedef pair<int, string> Entry;
+
+static bool exists(const string& filename) {
+    FILE* file = fopen(filename.c_str(), "rb");
+    if (file) {
+        fclose(file);
+    }
+    return file != nullptr;
+}
+
+// Shuffled entries, some given twice, through runs small enough to spill
+template <typename Compare>
+static void test_merge(const string& prefix, const Compare& compare) {
+    mt19937 rng(1);
+    vector<Entry> input;
+    for (int i = 0; i < 20000; i++) {
+        int key = rng() % 5000;
+        input.push_back(make_pair(key, "v" + to_string(rng() % 3)));
+    }
+    set<Entry, function<bool(const Entry&, const Entry&)>> expected(
+        [&compare](const Entry& a, const Entry& b) {
+            return compare(a.first, b.first) || (!compare(b.first, a.first) && a.second < b.second);
+        });
+    expected.insert(input.begin(), input.end());
+
+    ExternalSorter<int, string, Compare> sorter(prefix, 64 * 1024);
+    for (const Entry& entry : input) {
+        CHECK(sorter.add(entry.first, entry.second));
+    }
+    CHECK(sorter.finish());
+    CHECK(sorter.count() == expected.size());
+    CHECK(sorter.max_entry_bytes() == 10);
+    CHECK(exists(prefix + ".run1"));
+
+    // Twice, as bulk loading does
+    for (int pass = 0; pass < 2; pass++) {
+        vector<Entry> merged;
+        CHECK(sorter.merge([&merged](const int& key, const string& value) {
+            merged.push_back(make_pair(key, value));
+            return true;
+        }));
+        CHECK(merged.size() == expected.size() && equal(merged.begin(), merged.end(), expected.begin()));
+    }
+
+    int handed = 0;
+    CHECK(!sorter.merge([&handed](const int&, const string&) { return ++handed < 10; }));
+    CHECK(handed == 10);
+}
+
+// Input that fits in one run is sorted in memory, with nothing spilled
+static void test_in_memory() {
+    ExternalSorter<int, string> sorter("test_external_sort_small", 1 << 20);
+    for (int key = 100; key > 0; key--) {
+        CHECK(sorter.add(key, "x"));
+        CHECK(sorter.add(key, "x"));
+    }
+    CHECK(sorter.finish());
+    CHECK(sorter.count() == 100);
+    CHECK(!exists("test_external_sort_small.run0"));
+    int expected = 1;
+    CHECK(sorter.merge([&expected](const int& key, const string&) { return key == expected++; }));
+}
+
+// A run that no longer decodes fails the merge rather than dropping entries
+static void test_damaged_run() {
+    const string prefix = "test_external_sort_damaged";
+    ExternalSorter<int, string> sorter(prefix, 4096);
+    for (int key = 0; key < 1000; key++) {
+        CHECK(sorter.add(key, "value"));
+    }
+    CHECK(sorter.finish());
+
+    // The first record's string length, after the record's length and key
+    FILE* file = fopen((prefix + ".run0").c_str(), "r+b");
+    if (!CHECK(file != nullptr)) {
+        return;
+    }
+    int32_t length = 1 << 30;
+    fseek(file, sizeof(uint32_t) + sizeof(int32_t), SEEK_SET);
+    fwrite(&length, sizeof(length), 1, file);
+    fclose(file);
+    CHECK(!sorter.merge([](const int&, const string&) { return true; }));
+}
+
+int main() {
+    test_merge("test_external_sort", less<int>());
+    test_merge("test_external_sort_descending", greater<int>());
+    test_in_memory();
+    test_damaged_run();
+    return test_result("test_external_sort");
+}
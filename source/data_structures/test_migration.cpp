@@ -0,0 +1,175 @@
+#include "Btree.h"
+#include "test_support.h"
+#include <fstream>
+
+using namespace std;
+
+// A format 1 file, as the tree wrote it before superblocks had a header and
+// pages were slotted: a classic B-tree from int to string, entries in the
+// internal nodes too, every node packed. Opening it rebuilds it with the
+// entries in chained leaves, on checksummed slotted pages.
+
+typedef BTree<int, string> Tree;
+typedef Tree::Node Node;
+typedef vector<pair<int, string>> Entries;
+
+static const string FILENAME = "test_migration.dat";
+static const int LEAVES = 10;
+static const int LEAF_ENTRIES = 30;
+
+// is_leaf, key count, keys, values, then key count + 1 child pointers
+static vector<char> packed_page(bool leaf, const Entries& entries, const vector<int32_t>& children) {
+    vector<char> page(BLOCK_SIZE, 0);
+    page[0] = leaf ? 1 : 0;
+    int32_t count = entries.size();
+    memcpy(&page[1], &count, sizeof(count));
+    int offset = 1 + sizeof(count);
+    for (const auto& entry : entries) {
+        offset += Codec<int32_t>::encode(entry.first, &page[offset]);
+    }
+    for (const auto& entry : entries) {
+        offset += Codec<string>::encode(entry.second, &page[offset]);
+    }
+    for (int i = 0; i <= count; i++) {
+        int32_t child = leaf ? -1 : children[i];
+        memcpy(&page[offset], &child, sizeof(child));
+        offset += sizeof(child);
+    }
+    return page;
+}
+
+// Root in block 1 over leaves in blocks 2 on, with the entry between two
+// leaves in the root. Returns every entry in order.
+static Entries write_format_1() {
+    Entries all;
+    Entries separators;
+    vector<int32_t> children;
+    vector<vector<char>> leaves;
+    for (int leaf = 0; leaf < LEAVES; leaf++) {
+        Entries entries;
+        for (int i = 0; i < LEAF_ENTRIES; i++) {
+            int key = leaf * 1000 + i * 10;
+            entries.push_back(make_pair(key, "FL" + to_string(key)));
+        }
+        all.insert(all.end(), entries.begin(), entries.end());
+        leaves.push_back(packed_page(true, entries, {}));
+        children.push_back(2 + leaf);
+        if (leaf + 1 < LEAVES) {
+            int key = leaf * 1000 + 500;
+            separators.push_back(make_pair(key, "SEP" + to_string(key)));
+            all.push_back(separators.back());
+        }
+    }
+
+    // Block 0: the root block, padding, then the bitmap's size and words
+    vector<char> superblock(BLOCK_SIZE, 0);
+    int32_t root = 1;
+    uint64_t words = 1;
+    uint64_t used = (1ULL << (2 + LEAVES)) - 1;
+    memcpy(&superblock[0], &root, sizeof(root));
+    memcpy(&superblock[8], &words, sizeof(words));
+    memcpy(&superblock[16], &used, sizeof(used));
+
+    ofstream out(FILENAME, ios::binary | ios::trunc);
+    out.write(superblock.data(), BLOCK_SIZE);
+    out.write(packed_page(false, separators, children).data(), BLOCK_SIZE);
+    for (const vector<char>& leaf : leaves) {
+        out.write(leaf.data(), BLOCK_SIZE);
+    }
+    out.close();
+
+    sort(all.begin(), all.end());
+    return all;
+}
+
+static string file_contents() {
+    ifstream in(FILENAME, ios::binary);
+    return string(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+}
+
+// Every node reachable from the root is on a checked slotted page, its
+// entries in the leaves alone
+static void check_pages(StorageManager& storage, int block, int& entries, int& leaves) {
+    vector<char> page(BLOCK_SIZE);
+    storage.read_block(block, page.data());
+    CHECK(static_cast<uint8_t>(page[0]) == PAGE_SLOTTED);
+    Node node(block, true);
+    if (!CHECK(node.deserialize(page.data(), true))) {
+        return;
+    }
+    if (node.is_leaf) {
+        entries += node.key_count;
+        leaves++;
+        return;
+    }
+    for (int i = 0; i <= node.key_count; i++) {
+        check_pages(storage, node.disk_pointers[i], entries, leaves);
+    }
+}
+
+int main() {
+    remove_tree_files(FILENAME);
+    Entries expected = write_format_1();
+
+    // Other types refuse the file and leave it as found
+    string original = file_contents();
+    {
+        BTree<int, int> tree(FILENAME);
+        CHECK(!tree.initialize());
+    }
+    CHECK(file_contents() == original);
+
+    {
+        Tree tree(FILENAME);
+        CHECK(tree.initialize());
+        CHECK(!tree.damaged());
+        CHECK(tree.get_flight_count() == static_cast<int>(expected.size()));
+        CHECK(tree.get_all() == expected);
+    }
+
+    {
+        StorageManager storage(FILENAME);
+        storage.set_record_layout({Codec<int>::TYPE_TAG, Codec<int>::MIN_BYTES, Codec<int>::MAX_BYTES,
+                                   Codec<string>::TYPE_TAG, Codec<string>::MIN_BYTES, Codec<string>::MAX_BYTES});
+        CHECK(storage.initialize());
+        CHECK(storage.entries_in_leaves());
+        int entries = 0;
+        int leaves = 0;
+        check_pages(storage, storage.get_root_block(), entries, leaves);
+        CHECK(entries == static_cast<int>(expected.size()));
+        CHECK(leaves >= 2);
+        storage.shutdown();
+    }
+
+    // The rebuilt tree reopens without another rebuild and takes changes
+    {
+        Tree tree(FILENAME);
+        CHECK(tree.initialize());
+        CHECK(tree.get_all() == expected);
+        for (const auto& entry : expected) {
+            if (entry.first % 20 == 0) {
+                CHECK(tree.remove(entry.first, entry.second));
+            }
+        }
+        for (int key = 1; key < 10000; key += 10) {
+            CHECK(tree.insert(key, "NEW"));
+        }
+    }
+    {
+        Tree tree(FILENAME);
+        CHECK(tree.initialize());
+        Entries changed;
+        for (const auto& entry : expected) {
+            if (entry.first % 20 != 0) {
+                changed.push_back(entry);
+            }
+        }
+        for (int key = 1; key < 10000; key += 10) {
+            changed.push_back(make_pair(key, string("NEW")));
+        }
+        sort(changed.begin(), changed.end());
+        CHECK(tree.get_all() == changed);
+    }
+    remove_tree_files(FILENAME);
+    return test_result("test_migration");
+}
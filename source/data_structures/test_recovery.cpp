@@ -0,0 +1,197 @@
+#include "Btree.h"
+#include "test_support.h"
+#include <climits>
+#include <csignal>
+#include <random>
+#include <set>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace std;
+
+struct Group {
+    vector<pair<int, string>> pages;
+    vector<char> superblock;
+};
+
+static vector<Group> replay_all(WriteAheadLog& log) {
+    vector<Group> groups;
+    log.replay([&groups](const WriteAheadLog::Pages& pages, const vector<char>& superblock) {
+        Group group;
+        for (const auto& page : pages) {
+            group.pages.push_back(make_pair(page.first, string(page.second, BLOCK_SIZE)));
+        }
+        group.superblock = superblock;
+        groups.push_back(group);
+    });
+    return groups;
+}
+
+static off_t file_size(const string& filename) {
+    FILE* file = fopen(filename.c_str(), "rb");
+    fseek(file, 0, SEEK_END);
+    off_t size = ftell(file);
+    fclose(file);
+    return size;
+}
+
+// Only whole groups replay: a torn tail is dropped, and so is everything
+// from a record that fails its checksum on
+static void test_log() {
+    const string filename = "test_recovery.wal";
+    remove(filename.c_str());
+    string first(BLOCK_SIZE, 'a');
+    string second(BLOCK_SIZE, 'b');
+    vector<char> superblock = {1, 2, 3};
+    {
+        WriteAheadLog log(filename);
+        CHECK(log.open());
+        CHECK(log.append_group({{5, first.data()}, {9, second.data()}}, superblock));
+        CHECK(log.append_group({{6, second.data()}}, superblock));
+        CHECK(log.sync());
+        log.close();
+    }
+    CHECK(truncate(filename.c_str(), file_size(filename) - 10) == 0);
+    {
+        WriteAheadLog log(filename);
+        CHECK(log.open());
+        vector<Group> groups = replay_all(log);
+        if (CHECK(groups.size() == 1 && groups[0].pages.size() == 2)) {
+            CHECK(groups[0].pages[0].first == 5 && groups[0].pages[0].second == first);
+            CHECK(groups[0].pages[1].first == 9 && groups[0].pages[1].second == second);
+            CHECK(groups[0].superblock == superblock);
+        }
+        // Appended where the torn group was, not behind it
+        CHECK(log.append_group({{7, first.data()}}, superblock));
+        log.close();
+    }
+    {
+        WriteAheadLog log(filename);
+        CHECK(log.open());
+        vector<Group> groups = replay_all(log);
+        CHECK(groups.size() == 2 && groups[1].pages.size() == 1 && groups[1].pages[0].first == 7);
+        log.close();
+    }
+
+    // A flipped byte in the first page stops replay before any group
+    FILE* file = fopen(filename.c_str(), "r+b");
+    fseek(file, 100, SEEK_SET);
+    fputc('x', file);
+    fclose(file);
+    {
+        WriteAheadLog log(filename);
+        CHECK(log.open());
+        CHECK(replay_all(log).empty());
+        CHECK(log.append_group({{8, first.data()}}, superblock));
+        CHECK(log.reset());
+        CHECK(replay_all(log).empty());
+        log.close();
+    }
+    remove(filename.c_str());
+}
+
+// A child inserts and removes, reporting each operation before it starts and
+// again once it returned, until it is killed. With a commit per operation,
+// the tree that comes back holds exactly the operations of some prefix that
+// includes every one that returned.
+static void test_kill(int round, set<int>& state) {
+    const string filename = "test_recovery.dat";
+    int fds[2];
+    CHECK(pipe(fds) == 0);
+    pid_t pid = fork();
+    if (pid == 0) {
+        close(fds[0]);
+        BTree<int, string> tree(filename, 64 * BLOCK_SIZE);
+        tree.set_commit_policy(COMMIT_PER_OPERATION);
+        if (!tree.initialize()) {
+            _exit(1);
+        }
+        mt19937 rng(round);
+        vector<int> keys(state.begin(), state.end());
+        for (;;) {
+            int message;
+            if (rng() % 4 == 0 && !keys.empty()) {
+                size_t i = rng() % keys.size();
+                int key = keys[i];
+                keys[i] = keys.back();
+                keys.pop_back();
+                message = -key - 1;
+                write(fds[1], &message, sizeof(message));
+                tree.remove(key);
+            } else {
+                int key = rng() % 1000000;
+                message = key;
+                write(fds[1], &message, sizeof(message));
+                if (tree.insert(key, "V" + to_string(key))) {
+                    keys.push_back(key);
+                }
+            }
+            message = INT_MIN;
+            write(fds[1], &message, sizeof(message));
+        }
+    }
+    close(fds[1]);
+    usleep(200000 + round * 50000);
+    kill(pid, SIGKILL);
+    int status;
+    waitpid(pid, &status, 0);
+
+    // The states after each prefix of the operations the child began
+    vector<int> operations;
+    size_t returned = 0;
+    int message;
+    while (read(fds[0], &message, sizeof(message)) == sizeof(message)) {
+        if (message == INT_MIN) {
+            returned = operations.size();
+        } else {
+            operations.push_back(message);
+        }
+    }
+    close(fds[0]);
+
+    BTree<int, string> tree(filename);
+    if (!CHECK(tree.initialize())) {
+        return;
+    }
+    auto all = tree.get_all();
+    set<int> recovered;
+    for (const auto& entry : all) {
+        CHECK(entry.second == "V" + to_string(entry.first));
+        recovered.insert(entry.first);
+    }
+    CHECK(recovered.size() == all.size());
+    CHECK(tree.get_flight_count() == static_cast<int>(all.size()));
+
+    bool matched = recovered == state && returned == 0;
+    for (size_t i = 0; i < operations.size() && !matched; i++) {
+        int operation = operations[i];
+        if (operation >= 0) {
+            state.insert(operation);
+        } else {
+            state.erase(-operation - 1);
+        }
+        matched = recovered == state && i + 1 >= returned;
+    }
+    CHECK(matched);
+    state = recovered;
+
+    // The recovered tree takes changes as usual
+    int key = 1000000 + round;
+    vector<int> path;
+    string value;
+    CHECK(tree.insert(key, "V" + to_string(key)));
+    CHECK(tree.search(key, value, path) && value == "V" + to_string(key));
+    state.insert(key);
+}
+
+int main() {
+    test_log();
+
+    remove_tree_files("test_recovery.dat");
+    set<int> state;
+    for (int round = 0; round < 4; round++) {
+        test_kill(round, state);
+    }
+    remove_tree_files("test_recovery.dat");
+    return test_result("test_recovery");
+}
@@ -0,0 +1,42 @@
+#ifndef TEST_SUPPORT_H
+#define TEST_SUPPORT_H
+
+#include <atomic>
+#include <cstdio>
+#include <iostream>
+#include <string>
+
+// Shared by the engine tests: each is a program that runs its checks,
+// reports the ones that fail and exits non-zero if any did
+
+inline std::atomic<int>& test_failures() {
+    static std::atomic<int> failures(0);
+    return failures;
+}
+
+// Safe from any thread; only the first few failures are printed
+#define CHECK(condition) check_that((condition), #condition, __FILE__, __LINE__)
+
+inline bool check_that(bool ok, const char* what, const char* file, int line) {
+    if (!ok && test_failures()++ < 20) {
+        std::cerr << file << ":" << line << ": check failed: " << what << std::endl;
+    }
+    return ok;
+}
+
+// Starts a test on a fresh tree file, without a log left from an earlier run
+inline void remove_tree_files(const std::string& filename) {
+    std::remove(filename.c_str());
+    std::remove((filename + ".wal").c_str());
+}
+
+inline int test_result(const char* name) {
+    if (test_failures() > 0) {
+        std::cout << name << ": " << test_failures() << " checks failed" << std::endl;
+        return 1;
+    }
+    std::cout << name << ": passed" << std::endl;
+    return 0;
+}
+
+#endif
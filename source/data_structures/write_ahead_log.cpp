@@ -0,0 +1,165 @@
+#include "write_ahead_log.h"
+#include "constants.h"
+#include "checksum.h"
+#include <iostream>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+using namespace std;
+
+static const uint32_t MAX_RECORD_BYTES = 1 << 24;   // Anything longer is garbage
+
+WriteAheadLog::WriteAheadLog(const string& filename)
+    : filename_(filename),
+      fd_(-1),
+      next_lsn_(1),
+      size_(0) {
+}
+
+WriteAheadLog::~WriteAheadLog() {
+    close();
+}
+
+bool WriteAheadLog::open() {
+    fd_ = ::open(filename_.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd_ < 0) {
+        cerr << "Failed to open log: " << filename_ << endl;
+        return false;
+    }
+
+    FileHeader header;
+    struct stat st;
+    if (fstat(fd_, &st) != 0 || st.st_size < static_cast<off_t>(sizeof(header)) ||
+        pread(fd_, &header, sizeof(header), 0) != sizeof(header) || header.magic != MAGIC) {
+        if (st.st_size > 0) {
+            cerr << "Ignoring unreadable log: " << filename_ << endl;
+        }
+        next_lsn_ = 1;
+        return reset();
+    }
+
+    next_lsn_ = header.first_lsn;
+    size_ = st.st_size;
+    return true;
+}
+
+void WriteAheadLog::close() {
+    if (fd_ >= 0) {
+        ::close(fd_);
+        fd_ = -1;
+    }
+}
+
+int WriteAheadLog::replay(const GroupHandler& apply) {
+    vector<char> log(size_);
+    if (pread(fd_, log.data(), log.size(), 0) != static_cast<ssize_t>(log.size())) {
+        return 0;
+    }
+
+    Pages pages;
+    vector<char> superblock;
+    int records = 0;
+    int groups = 0;
+    uint64_t lsn = next_lsn_;
+    size_t pos = sizeof(FileHeader);
+    size_t committed_end = pos;
+    uint64_t committed_lsn = lsn;
+
+    while (pos + sizeof(RecordHeader) <= log.size()) {
+        RecordHeader header;
+        memcpy(&header, log.data() + pos, sizeof(header));
+        if (header.lsn != lsn || header.length > MAX_RECORD_BYTES ||
+            pos + sizeof(header) + header.length > log.size()) {
+            break;
+        }
+
+        const char* payload = log.data() + pos + sizeof(header);
+        uint32_t checksum = header.checksum;
+        header.checksum = 0;
+        if (crc32(payload, header.length, crc32(&header, sizeof(header))) != checksum) {
+            break;  // Torn write
+        }
+
+        if (header.type == PAGE && header.length == static_cast<uint32_t>(BLOCK_SIZE)) {
+            pages.emplace_back(header.block, payload);
+        } else if (header.type == META) {
+            superblock.assign(payload, payload + header.length);
+        } else if (header.type == COMMIT && header.block == records) {
+            apply(pages, superblock);
+            groups++;
+            pages.clear();
+            records = -1;   // The COMMIT itself isn't counted
+            committed_end = pos + sizeof(header) + header.length;
+            committed_lsn = lsn + 1;
+        } else {
+            break;
+        }
+
+        records++;
+        lsn++;
+        pos += sizeof(header) + header.length;
+    }
+
+    // Drop whatever follows the last complete group so new groups don't land
+    // behind it
+    if (committed_end < size_ && ftruncate(fd_, committed_end) == 0) {
+        size_ = committed_end;
+    }
+    next_lsn_ = committed_lsn;
+    return groups;
+}
+
+void WriteAheadLog::add_record(vector<char>& out, RecordType type, int block,
+                               const char* data, uint32_t length) {
+    RecordHeader header = {next_lsn_++, type, block, length, 0};
+    header.checksum = crc32(data, length, crc32(&header, sizeof(header)));
+
+    size_t pos = out.size();
+    out.resize(pos + sizeof(header) + length);
+    memcpy(out.data() + pos, &header, sizeof(header));
+    if (length > 0) {
+        memcpy(out.data() + pos + sizeof(header), data, length);
+    }
+}
+
+// The whole group goes out in one write so a crash tears at most its tail
+bool WriteAheadLog::append_group(const Pages& pages, const vector<char>& superblock) {
+    uint64_t first_lsn = next_lsn_;
+    vector<char> out;
+    out.reserve(pages.size() * (sizeof(RecordHeader) + BLOCK_SIZE) + superblock.size() +
+                2 * sizeof(RecordHeader));
+
+    for (const auto& page : pages) {
+        add_record(out, PAGE, page.first, page.second, BLOCK_SIZE);
+    }
+    add_record(out, META, -1, superblock.data(), superblock.size());
+    add_record(out, COMMIT, pages.size() + 1, nullptr, 0);
+
+    if (pwrite(fd_, out.data(), out.size(), size_) != static_cast<ssize_t>(out.size())) {
+        cerr << "Failed to append to log: " << filename_ << endl;
+        next_lsn_ = first_lsn;  // The next group overwrites the partial one
+        return false;
+    }
+    size_ += out.size();
+    return true;
+}
+
+bool WriteAheadLog::sync() {
+    return fdatasync(fd_) == 0;
+}
+
+bool WriteAheadLog::reset() {
+    if (ftruncate(fd_, 0) != 0 || !write_file_header()) {
+        cerr << "Failed to reset log: " << filename_ << endl;
+        return false;
+    }
+    size_ = sizeof(FileHeader);
+    return sync();
+}
+
+bool WriteAheadLog::write_file_header() {
+    FileHeader header = {MAGIC, next_lsn_};
+    return pwrite(fd_, &header, sizeof(header), 0) == sizeof(header);
+}
@@ -0,0 +1,71 @@
+#ifndef WRITE_AHEAD_LOG_H
+#define WRITE_AHEAD_LOG_H
+
+#include <string>
+#include <vector>
+#include <utility>
+#include <functional>
+#include <cstdint>
+#include <cstddef>
+
+// Redo log of whole block images, kept next to the data file.
+//
+// The writer logs each batch as one group: a PAGE record per block, a META
+// record with the superblock image (root and bitmap), then a COMMIT record.
+// Every record carries the next LSN and a CRC, so replay stops cleanly at a
+// torn tail and only applies groups whose COMMIT made it to disk.
+//
+// Block images make replay idempotent: applying a group twice leaves the
+// same bytes. That lets a checkpoint sync the data file first and empty the
+// log afterwards without any ordering beyond that, and it keeps recovery
+// proportional to the log, which checkpoints keep short.
+class WriteAheadLog {
+public:
+    typedef std::vector<std::pair<int, const char*>> Pages;
+    typedef std::function<void(const Pages& pages, const std::vector<char>& superblock)> GroupHandler;
+
+    WriteAheadLog(const std::string& filename);
+    ~WriteAheadLog();
+
+    bool open();    // Creates the log if it is missing
+    void close();
+
+    // Hands every committed group to apply, oldest first. Returns how many
+    // there were.
+    int replay(const GroupHandler& apply);
+
+    bool append_group(const Pages& pages, const std::vector<char>& superblock);
+    bool sync();
+    bool reset();   // Empties the log once a checkpoint made it redundant
+
+    size_t size() const { return size_; }
+    uint64_t next_lsn() const { return next_lsn_; }
+
+private:
+    enum RecordType : uint32_t { PAGE = 1, META = 2, COMMIT = 3 };
+
+    struct RecordHeader {
+        uint64_t lsn;
+        uint32_t type;
+        int32_t block;      // PAGE: block index; COMMIT: records in the group
+        uint32_t length;    // Payload bytes that follow
+        uint32_t checksum;  // CRC of the header (this field zeroed) and payload
+    };
+
+    struct FileHeader {
+        uint64_t magic;
+        uint64_t first_lsn; // LSN of the first record after this header
+    };
+
+    static const uint64_t MAGIC = 0x4C41574545525442ULL;  // "BTREEWAL" on disk
+
+    std::string filename_;
+    int fd_;
+    uint64_t next_lsn_;
+    size_t size_;
+
+    void add_record(std::vector<char>& out, RecordType type, int block, const char* data, uint32_t length);
+    bool write_file_header();
+};
+
+#endif
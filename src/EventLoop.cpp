@@ -0,0 +1,489 @@
+#include "../include/EventLoop.h"
+#include <iostream>
+#include <chrono>
+#include <cstring>
+#include <cerrno>
+#include <charconv>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <netinet/tcp.h>
+
+using namespace std;
+
+static const size_t READ_CHUNK = 16 * 1024;
+// Largest request the loop will buffer (headers plus raw, possibly chunked body)
+static const size_t MAX_BUFFERED_BYTES = HttpParser::MAX_BODY_BYTES + HttpParser::MAX_HEADER_BYTES;
+// Stop answering pipelined requests until the client drains this much output
+static const size_t MAX_PENDING_OUTPUT = 1 << 20;
+static const int MAX_EVENTS = 64;
+
+EventLoop::EventLoop(int listenSocket, const Config& config,
+                     RequestHandler onRequest, AcceptHandler onAccept)
+    : listenSocket(listenSocket), epollFd(-1), wakeFd(-1), timerFd(-1),
+      config(config), running(false),
+      onRequest(onRequest), onAccept(onAccept) {
+    if (this->config.workerThreads <= 0) {
+        this->config.workerThreads = static_cast<int>(thread::hardware_concurrency());
+        if (this->config.workerThreads <= 0) this->config.workerThreads = 1;
+    }
+}
+
+EventLoop::~EventLoop() {
+    stop();
+}
+
+bool EventLoop::start() {
+    int flags = fcntl(listenSocket, F_GETFL, 0);
+    if (flags < 0 || fcntl(listenSocket, F_SETFL, flags | O_NONBLOCK) < 0) {
+        cerr << "❌ Failed to make listening socket non-blocking" << endl;
+        return false;
+    }
+
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+    wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    timerFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (epollFd < 0 || wakeFd < 0 || timerFd < 0) {
+        cerr << "❌ Failed to create epoll/eventfd/timerfd descriptors" << endl;
+        return false;
+    }
+
+    // Listening socket is tagged with a null pointer, the wake fd with
+    // `this` and the sweep timer with &timerFd
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN | EPOLLONESHOT;
+    ev.data.ptr = nullptr;
+    if (epoll_ctl(epollFd, EPOLL_CTL_ADD, listenSocket, &ev) < 0) {
+        cerr << "❌ Failed to register listening socket" << endl;
+        return false;
+    }
+
+    // Level-triggered so that every worker sees it once stop() signals
+    ev.events = EPOLLIN;
+    ev.data.ptr = this;
+    if (epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeFd, &ev) < 0) {
+        cerr << "❌ Failed to register wake-up eventfd" << endl;
+        return false;
+    }
+
+    if (config.idleTimeoutSeconds > 0) {
+        struct itimerspec interval;
+        memset(&interval, 0, sizeof(interval));
+        interval.it_interval.tv_sec = 1;
+        interval.it_value.tv_sec = 1;
+        timerfd_settime(timerFd, 0, &interval, nullptr);
+
+        ev.events = EPOLLIN | EPOLLONESHOT;
+        ev.data.ptr = &timerFd;
+        if (epoll_ctl(epollFd, EPOLL_CTL_ADD, timerFd, &ev) < 0) {
+            cerr << "❌ Failed to register idle sweep timer" << endl;
+            return false;
+        }
+    }
+
+    running = true;
+    for (int i = 0; i < config.workerThreads; i++) {
+        workers.emplace_back(&EventLoop::workerLoop, this);
+    }
+
+    return true;
+}
+
+void EventLoop::stop() {
+    if (!running.exchange(false)) return;
+
+    uint64_t one = 1;
+    if (write(wakeFd, &one, sizeof(one)) < 0) {
+        cerr << "❌ Failed to wake worker threads" << endl;
+    }
+
+    for (auto& worker : workers) {
+        if (worker.joinable()) worker.join();
+    }
+    workers.clear();
+
+    {
+        lock_guard<mutex> lock(connectionsMutex);
+        for (Connection* conn : connections) {
+            close(conn->fd);
+            delete conn;
+        }
+        connections.clear();
+    }
+
+    close(timerFd);
+    close(wakeFd);
+    close(epollFd);
+    timerFd = -1;
+    wakeFd = -1;
+    epollFd = -1;
+}
+
+void EventLoop::workerLoop() {
+    struct epoll_event events[MAX_EVENTS];
+
+    while (running) {
+        int n = epoll_wait(epollFd, events, MAX_EVENTS, -1);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            cerr << "❌ epoll_wait failed: " << strerror(errno) << endl;
+            break;
+        }
+
+        for (int i = 0; i < n && running; i++) {
+            void* tag = events[i].data.ptr;
+
+            if (tag == this) {
+                continue; // stop() requested; loop condition ends the worker
+            }
+
+            if (tag == nullptr) {
+                acceptConnections();
+                continue;
+            }
+
+            if (tag == &timerFd) {
+                sweepIdleConnections();
+                continue;
+            }
+
+            Connection* conn = static_cast<Connection*>(tag);
+            conn->lastActiveMs = nowMs();
+            if (events[i].events & EPOLLERR) {
+                closeConnection(conn);
+            } else if (events[i].events & EPOLLOUT) {
+                serviceConnection(conn);
+            } else {
+                handleReadable(conn);
+            }
+        }
+    }
+}
+
+void EventLoop::acceptConnections() {
+    while (running) {
+        struct sockaddr_in clientAddr;
+        socklen_t clientLen = sizeof(clientAddr);
+
+        int clientSocket = accept4(listenSocket, (struct sockaddr*)&clientAddr, &clientLen,
+                                   SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (clientSocket < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                cerr << "❌ Failed to accept connection: " << strerror(errno) << endl;
+            }
+            break;
+        }
+
+        int opt = 1;
+        setsockopt(clientSocket, IPPROTO_TCP, TCP_NODELAY, &opt, sizeof(opt));
+
+        if (onAccept) onAccept(clientAddr);
+
+        Connection* conn = new Connection(clientSocket);
+        conn->lastActiveMs = nowMs();
+        {
+            lock_guard<mutex> lock(connectionsMutex);
+            connections.insert(conn);
+        }
+
+        struct epoll_event ev;
+        memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN | EPOLLRDHUP | EPOLLONESHOT;
+        ev.data.ptr = conn;
+        if (epoll_ctl(epollFd, EPOLL_CTL_ADD, clientSocket, &ev) < 0) {
+            closeConnection(conn);
+        }
+    }
+
+    // Re-arm the listening socket for the next batch of connections
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN | EPOLLONESHOT;
+    ev.data.ptr = nullptr;
+    epoll_ctl(epollFd, EPOLL_CTL_MOD, listenSocket, &ev);
+}
+
+// Idle sockets are shut down rather than closed here: the shutdown wakes the
+// worker that owns the registration, which then closes it through the normal
+// path. That way the sweep never frees a Connection another worker holds.
+void EventLoop::sweepIdleConnections() {
+    uint64_t expirations;
+    if (read(timerFd, &expirations, sizeof(expirations)) < 0 && errno != EAGAIN) {
+        cerr << "❌ Failed to read idle sweep timer" << endl;
+    }
+
+    long long deadline = nowMs() - config.idleTimeoutSeconds * 1000LL;
+    {
+        lock_guard<mutex> lock(connectionsMutex);
+        for (Connection* conn : connections) {
+            if (conn->lastActiveMs.load() < deadline) {
+                shutdown(conn->fd, SHUT_RDWR);
+            }
+        }
+    }
+
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN | EPOLLONESHOT;
+    ev.data.ptr = &timerFd;
+    epoll_ctl(epollFd, EPOLL_CTL_MOD, timerFd, &ev);
+}
+
+void EventLoop::handleReadable(Connection* conn) {
+    while (true) {
+        // Read straight into the connection buffer; slide unparsed bytes to
+        // the front (or grow) when the tail runs short
+        if (conn->in.size() - conn->inEnd < READ_CHUNK) {
+            if (conn->inStart > 0) {
+                memmove(conn->in.data(), conn->in.data() + conn->inStart, conn->inEnd - conn->inStart);
+                conn->inEnd -= conn->inStart;
+                conn->inStart = 0;
+            }
+            if (conn->in.size() - conn->inEnd < READ_CHUNK) {
+                conn->in.resize(conn->inEnd + READ_CHUNK * 2);
+            }
+        }
+
+        ssize_t bytesRead = read(conn->fd, conn->in.data() + conn->inEnd, conn->in.size() - conn->inEnd);
+        if (bytesRead > 0) {
+            conn->inEnd += bytesRead;
+            if (conn->inEnd - conn->inStart > MAX_BUFFERED_BYTES) {
+                break; // Let the parser reject it or drain what is complete
+            }
+            continue;
+        }
+        if (bytesRead == 0) {
+            conn->peerClosed = true;
+            break;
+        }
+        if (errno == EINTR) continue;
+        if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+
+        closeConnection(conn);
+        return;
+    }
+
+    serviceConnection(conn);
+}
+
+// Answer buffered requests, push the output, then decide what to wait for
+void EventLoop::serviceConnection(Connection* conn) {
+    while (true) {
+        bool moreQueued = processRequests(conn);
+
+        FlushResult result = flushOutput(conn);
+        if (result == FLUSH_FAILED) {
+            closeConnection(conn);
+            return;
+        }
+        if (result == FLUSH_BLOCKED) {
+            rearm(conn, EPOLLOUT);
+            return;
+        }
+
+        if (conn->closeAfterWrite) {
+            closeConnection(conn);
+            return;
+        }
+
+        // Output drained; keep going only if backpressure left requests queued
+        if (!moreQueued) break;
+    }
+
+    if (conn->peerClosed) {
+        closeConnection(conn);
+        return;
+    }
+
+    // Release the buffer of a connection that has gone quiet
+    if (conn->inStart == conn->inEnd && conn->in.size() > READ_CHUNK * 2) {
+        vector<char>().swap(conn->in);
+        conn->inStart = conn->inEnd = 0;
+    }
+
+    rearm(conn, EPOLLIN | EPOLLRDHUP);
+}
+
+// Handle every complete request in the input buffer, in order. Returns true
+// when it stopped early because too much output is already waiting.
+bool EventLoop::processRequests(Connection* conn) {
+    while (!conn->closeAfterWrite) {
+        if (conn->out.size() - conn->outOffset >= MAX_PENDING_OUTPUT) return true;
+
+        HttpRequest request;
+        HttpParser::Status status = conn->parser.parse(conn->in.data() + conn->inStart,
+                                                       conn->inEnd - conn->inStart, request);
+        if (status == HttpParser::NEED_MORE) {
+            if (conn->inEnd - conn->inStart > MAX_BUFFERED_BYTES) {
+                queueError(conn, 413);
+            }
+            break;
+        }
+        if (status == HttpParser::FAILED) {
+            queueError(conn, conn->parser.errorStatus());
+            break;
+        }
+
+        conn->requestsServed++;
+        bool keepAlive = request.keepAlive && running;
+        if (config.maxRequestsPerConnection > 0 &&
+            conn->requestsServed >= config.maxRequestsPerConnection) {
+            keepAlive = false;
+        }
+
+        queueResponse(conn, onRequest(request), keepAlive);
+
+        conn->inStart += conn->parser.consumedBytes();
+        conn->parser.reset();
+    }
+
+    if (conn->inStart == conn->inEnd) {
+        conn->inStart = conn->inEnd = 0;
+    }
+    return false;
+}
+
+// Renders the Connection/Keep-Alive lines for a response into buffer
+size_t EventLoop::connectionHeader(Connection* conn, bool keepAlive, char* buffer, size_t size) {
+    char* out = buffer;
+    char* end = buffer + size;
+    auto put = [&out](const char* text) {
+        size_t count = strlen(text);
+        memcpy(out, text, count);
+        out += count;
+    };
+
+    if (!keepAlive) {
+        put("Connection: close\r\n");
+        return out - buffer;
+    }
+    put("Connection: keep-alive\r\nKeep-Alive: timeout=");
+    out = to_chars(out, end, config.idleTimeoutSeconds).ptr;
+    if (config.maxRequestsPerConnection > 0) {
+        put(", max=");
+        out = to_chars(out, end, config.maxRequestsPerConnection - conn->requestsServed).ptr;
+    }
+    put("\r\n");
+    return out - buffer;
+}
+
+void EventLoop::queueResponse(Connection* conn, string_view response, bool keepAlive) {
+    // Splice the connection headers in right after the status line
+    size_t statusEnd = response.find("\r\n");
+    statusEnd = (statusEnd == string_view::npos) ? response.size() : statusEnd + 2;
+
+    char header[128];
+    size_t headerLength = connectionHeader(conn, keepAlive, header, sizeof(header));
+    if (!keepAlive) conn->closeAfterWrite = true;
+
+    string_view parts[3] = {response.substr(0, statusEnd),
+                            string_view(header, headerLength),
+                            response.substr(statusEnd)};
+
+    // Nothing queued ahead of us: hand the three pieces straight to the
+    // kernel in one gathered write and only copy whatever it does not take
+    size_t skip = 0;
+    if (conn->outOffset == conn->out.size() && !conn->writeFailed) {
+        conn->out.clear();
+        conn->outOffset = 0;
+
+        struct iovec iov[3];
+        for (int i = 0; i < 3; i++) {
+            iov[i].iov_base = const_cast<char*>(parts[i].data());
+            iov[i].iov_len = parts[i].size();
+        }
+
+        // sendmsg is writev with flags, so a reset peer cannot raise SIGPIPE
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = iov;
+        msg.msg_iovlen = 3;
+
+        ssize_t sent;
+        do {
+            sent = sendmsg(conn->fd, &msg, MSG_NOSIGNAL);
+        } while (sent < 0 && errno == EINTR);
+
+        if (sent < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+            conn->writeFailed = true;
+            return;
+        }
+        if (sent > 0) skip = sent;
+    }
+
+    for (const string_view& part : parts) {
+        if (skip >= part.size()) {
+            skip -= part.size();
+            continue;
+        }
+        conn->out.append(part.data() + skip, part.size() - skip);
+        skip = 0;
+    }
+}
+
+// Malformed or oversized requests get a short JSON error, then the socket is
+// closed because the framing of anything after it cannot be trusted
+void EventLoop::queueError(Connection* conn, int status) {
+    const char* reason = "Bad Request";
+    if (status == 413) reason = "Payload Too Large";
+    else if (status == 431) reason = "Request Header Fields Too Large";
+    else if (status == 501) reason = "Not Implemented";
+
+    string body = string("{\"success\":false,\"error\":\"") + reason + "\"}";
+    string response = "HTTP/1.1 " + to_string(status) + " " + reason + "\r\n" +
+                      "Content-Type: application/json\r\n" +
+                      "Access-Control-Allow-Origin: *\r\n" +
+                      "Content-Length: " + to_string(body.size()) + "\r\n\r\n" + body;
+    queueResponse(conn, response, false);
+}
+
+EventLoop::FlushResult EventLoop::flushOutput(Connection* conn) {
+    if (conn->writeFailed) return FLUSH_FAILED;
+
+    while (conn->outOffset < conn->out.size()) {
+        ssize_t sent = send(conn->fd, conn->out.data() + conn->outOffset,
+                            conn->out.size() - conn->outOffset, MSG_NOSIGNAL);
+        if (sent > 0) {
+            conn->outOffset += sent;
+            continue;
+        }
+        if (sent < 0 && errno == EINTR) continue;
+        if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return FLUSH_BLOCKED;
+        return FLUSH_FAILED;
+    }
+
+    conn->out.clear();
+    conn->outOffset = 0;
+    return FLUSH_DONE;
+}
+
+void EventLoop::rearm(Connection* conn, unsigned int events) {
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = events | EPOLLONESHOT;
+    ev.data.ptr = conn;
+    if (epoll_ctl(epollFd, EPOLL_CTL_MOD, conn->fd, &ev) < 0) {
+        closeConnection(conn);
+    }
+}
+
+void EventLoop::closeConnection(Connection* conn) {
+    {
+        lock_guard<mutex> lock(connectionsMutex);
+        connections.erase(conn);
+    }
+    // Closing the fd also removes it from the epoll set
+    close(conn->fd);
+    delete conn;
+}
+
+long long EventLoop::nowMs() {
+    return chrono::duration_cast<chrono::milliseconds>(
+        chrono::steady_clock::now().time_since_epoch()).count();
+}
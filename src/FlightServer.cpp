@@ -1,10 +1,12 @@
  #include "../include/FlightServer.h"
+#include "../include/JsonReader.h"
 #include <iostream>
 #include <fstream>
-#include <sstream>
+#include <charconv>
 #include <iomanip>
 #include <ctime>
 #include <cstring>
+#include <cstdlib>
 #include <unistd.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
@@ -13,9 +15,14 @@
 #include <unordered_map>
 #include <vector>
 #include <random>
+#include <cstdio>
+#include <stdexcept>
 
 using namespace std;
 
+// The departure index is derived from the flight table and rebuilt on start
+static const char* const DEPARTURE_INDEX_FILE = "data/departures.dat";
+
 // Simple structs for data
 struct Flight {
     string id;
@@ -26,12 +33,13 @@ struct Flight {
     string gate;
     double price;
     int seats;
+    int departureKey;   // Key in the departure index, minutes since midnight
     
     Flight() = default;
     Flight(string id, string from, string to, string dep, string arr, 
            string gate, double price, int seats)
         : id(id), from(from), to(to), departure(dep), arrival(arr), 
-          gate(gate), price(price), seats(seats) {}
+          gate(gate), price(price), seats(seats), departureKey(-1) {}
 };
 
 struct Passenger {
@@ -62,19 +70,6 @@ struct Route {
         : from(f), to(t), distance(d), price(p), duration(dur), flightId(fid) {}
 };
 
-// Simple seat bitmap for each flight
-unordered_map<string, vector<bool>> seatMaps; // flightId -> bitmap of 180 seats
-unordered_map<string, unordered_map<string, int>> seatAssignments; // flightId -> PNR -> seat index
-
-// Helper to extract request body
-string FlightServer::extractRequestBody(const string& request) {
-    size_t pos = request.find("\r\n\r\n");
-    if (pos != string::npos) {
-        return request.substr(pos + 4);
-    }
-    return "";
-}
-
 // Helper to convert time to Unix timestamp
 long long FlightServer::timeToUnix(const string& timeStr) {
     time_t now = time(0);
@@ -90,8 +85,27 @@ long long FlightServer::timeToUnix(const string& timeStr) {
     return (long long)mktime(timeinfo);
 }
 
+// Helper: "HH:MM" (or "H:MM") to minutes since midnight, or -1 when invalid
+static int parseDepartureTime(string_view time) {
+    size_t colon = time.find(':');
+    if (colon == string_view::npos || colon == 0 || colon > 2 || time.size() != colon + 3) return -1;
+    
+    int hour = 0, minute = 0;
+    auto hourEnd = from_chars(time.data(), time.data() + colon, hour);
+    auto minuteEnd = from_chars(time.data() + colon + 1, time.data() + time.size(), minute);
+    if (hourEnd.ec != errc() || hourEnd.ptr != time.data() + colon ||
+        minuteEnd.ec != errc() || minuteEnd.ptr != time.data() + time.size()) {
+        return -1;
+    }
+    if (hour < 0 || hour > 23 || minute < 0 || minute > 59) return -1;
+    return hour * 60 + minute;
+}
+
 // Constructor
-FlightServer::FlightServer(int port) : serverPort(port), serverSocket(-1), isRunning(false) {
+FlightServer::FlightServer(int port, int workers) 
+    : serverPort(port), serverSocket(-1), isRunning(false),
+      departures(DEPARTURE_INDEX_FILE) {
+    loopConfig.workerThreads = workers;
     stats.connectionsHandled = 0;
     stats.requestsProcessed = 0;
     
@@ -101,6 +115,7 @@ FlightServer::FlightServer(int port) : serverPort(port), serverSocket(-1), isRun
     stats.startTime = timeStr;
     
     initializeData();
+    setupRoutes();
 }
 
 FlightServer::~FlightServer() {
@@ -109,8 +124,20 @@ FlightServer::~FlightServer() {
 
 // Initialize sample data
 void FlightServer::initializeData() {
+    // The index is rebuilt from the flights at every start, so it never has
+    // to survive a crash and can skip the log and per-batch syncs.
+    // Departure-board reads dominate, so nodes are loaded straight out of a
+    // mapping.
+    remove(DEPARTURE_INDEX_FILE);
+    departures.set_write_ahead_log(false);
+    departures.set_commit_policy(COMMIT_ON_SHUTDOWN);
+    departures.set_memory_mapped(true);
+    if (!departures.initialize()) {
+        throw runtime_error(string("Cannot open departure index ") + DEPARTURE_INDEX_FILE);
+    }
+    
     // Initialize flights
-    flights = {
+    const Flight sampleFlights[] = {
         Flight("AA101", "JFK", "LHR", "14:30", "22:00", "A01", 850.0, 180),
         Flight("PK785", "ISL", "LHR", "08:00", "12:00", "A02", 600.0, 180),
         Flight("EK202", "DXB", "SIN", "16:15", "04:45", "B01", 650.0, 180),
@@ -119,45 +146,50 @@ void FlightServer::initializeData() {
         Flight("PK123", "ISL", "DXB", "10:00", "14:00", "A03", 450.0, 180)
     };
     
-    // Initialize seat maps
+    // Index flights and initialize seat maps. The index starts empty, so
+    // the schedule goes in with one bottom-up bulk load.
+    vector<pair<int, string>> schedule;
     srand(time(0));
-    for (const auto& flight : flights) {
-        vector<bool> seats(180, false); // All seats available
+    for (Flight flight : sampleFlights) {
+        flight.departureKey = parseDepartureTime(flight.departure);
+        schedule.emplace_back(flight.departureKey, flight.id);
+        flights.insert(flight.id, flight);
+        
+        unique_ptr<SeatInventory> seats(new SeatInventory()); // All seats available
         // Mark some seats as occupied for demo (30% occupied)
         for (int i = 0; i < 54; i++) {
-            int seatNum = rand() % 180;
-            seats[seatNum] = true;
+            seats->claim(rand() % SeatInventory::SEAT_COUNT);
         }
-        seatMaps[flight.id] = seats;
+        seatInventories[flight.id] = move(seats);
+    }
+    sort(schedule.begin(), schedule.end());
+    if (!departures.bulk_load(schedule.begin(), schedule.end())) {
+        throw runtime_error(string("Cannot load departure index ") + DEPARTURE_INDEX_FILE);
     }
     
     // Initialize passengers with seat assignments
-    passengers = {
-        {"PNR1001", Passenger("PNR1001", "John Smith", "john@example.com", "AA101", "12A", "Economy", true)},
-        {"PNR1002", Passenger("PNR1002", "Sarah Johnson", "sarah@example.com", "PK785", "8B", "Business", false)},
-        {"PNR1003", Passenger("PNR1003", "Mike Brown", "mike@example.com", "EK202", "15C", "Economy", true)},
-        {"PNR1004", Passenger("PNR1004", "Emma Wilson", "emma@example.com", "BA456", "3D", "First Class", false)},
-        {"PNR1005", Passenger("PNR1005", "David Lee", "david@example.com", "LH456", "10E", "Premium Economy", true)}
+    const Passenger samplePassengers[] = {
+        Passenger("PNR1001", "John Smith", "john@example.com", "AA101", "12A", "Economy", true),
+        Passenger("PNR1002", "Sarah Johnson", "sarah@example.com", "PK785", "8B", "Business", false),
+        Passenger("PNR1003", "Mike Brown", "mike@example.com", "EK202", "15C", "Economy", true),
+        Passenger("PNR1004", "Emma Wilson", "emma@example.com", "BA456", "3D", "First Class", false),
+        Passenger("PNR1005", "David Lee", "david@example.com", "LH456", "10E", "Premium Economy", true)
     };
     
-    // Initialize seat assignments
-    for (auto& pair : passengers) {
-        if (!pair.second.seat.empty()) {
-            // Convert seat like "12A" to index
-            string seatStr = pair.second.seat;
-            int row = stoi(seatStr.substr(0, seatStr.length() - 1));
-            char col = seatStr.back();
-            int seatIndex = (row - 1) * 6 + (col - 'A');
-            
-            if (seatIndex >= 0 && seatIndex < 180) {
-                seatMaps[pair.second.flightId][seatIndex] = true;
-                seatAssignments[pair.second.flightId][pair.first] = seatIndex;
-            }
+    for (const auto& passenger : samplePassengers) {
+        passengers.insert(passenger.pnr, passenger);
+        
+        // Initialize seat assignment
+        int seatIndex = SeatInventory::parseSeat(passenger.seat);
+        SeatInventory* inventory = findInventory(passenger.flightId);
+        if (seatIndex >= 0 && inventory) {
+            inventory->claim(seatIndex);
+            inventory->assignments[passenger.pnr] = seatIndex;
         }
     }
     
     // Initialize routes (graph for Dijkstra)
-    routes = {
+    const Route routes[] = {
         Route("ISL", "LHR", 5600, 600.0, 420, "PK785"),
         Route("LHR", "DXB", 5500, 750.0, 420, "BA456"),
         Route("DXB", "SIN", 5800, 650.0, 420, "EK202"),
@@ -170,8 +202,14 @@ void FlightServer::initializeData() {
         Route("SIN", "DXB", 5800, 650.0, 420, "EK404")
     };
     
-    cout << "📊 Data initialized: " << flights.size() << " flights, " 
-         << passengers.size() << " passengers, " << routes.size() << " routes" << endl;
+    for (const auto& route : routes) {
+        if (!routeGraph.hasCity(route.from)) routeGraph.addCity(route.from, route.from);
+        if (!routeGraph.hasCity(route.to)) routeGraph.addCity(route.to, route.to);
+        routeGraph.addRoute(route.from, route.to, route.distance, route.price, route.duration, route.flightId);
+    }
+    
+    cout << "📊 Data initialized: " << flights.getSize() << " flights, " 
+         << passengers.getSize() << " passengers, " << routeGraph.getRouteCount() << " routes" << endl;
 }
 
 bool FlightServer::start() {
@@ -198,49 +236,53 @@ bool FlightServer::start() {
         return false;
     }
     
-    if (listen(serverSocket, 10) < 0) {
+    if (listen(serverSocket, SOMAXCONN) < 0) {
         cerr << "❌ Failed to listen on socket" << endl;
         close(serverSocket);
         return false;
     }
     
-    isRunning = true;
-    
-    thread([this]() {
-        cout << "👂 Listening for connections on port " << serverPort << "..." << endl;
-        
-        while (isRunning) {
-            struct sockaddr_in clientAddr;
-            socklen_t clientLen = sizeof(clientAddr);
-            
-            int clientSocket = accept(serverSocket, (struct sockaddr*)&clientAddr, &clientLen);
-            
-            if (clientSocket < 0) {
-                if (isRunning) {
-                    cerr << "❌ Failed to accept connection" << endl;
-                }
-                continue;
-            }
-            
+    // Fixed worker pool on one epoll instance instead of a thread per client
+    eventLoop.reset(new EventLoop(serverSocket, loopConfig,
+        [this](const HttpRequest& request) {
+            stats.requestsProcessed++;
+            return handleRequest(request);
+        },
+        [this](const sockaddr_in& clientAddr) {
             char clientIP[INET_ADDRSTRLEN];
             inet_ntop(AF_INET, &clientAddr.sin_addr, clientIP, INET_ADDRSTRLEN);
             
             cout << "🔗 New connection from " << clientIP << ":" << ntohs(clientAddr.sin_port) << endl;
             
             stats.connectionsHandled++;
-            
-            thread clientThread(&FlightServer::handleClient, this, clientSocket);
-            clientThread.detach();
-        }
-    }).detach();
+        }));
+    
+    if (!eventLoop->start()) {
+        eventLoop.reset();
+        close(serverSocket);
+        serverSocket = -1;
+        return false;
+    }
+    
+    isRunning = true;
+    cout << "👂 Listening for connections on port " << serverPort 
+         << " (" << eventLoop->getWorkerCount() << " worker threads)..." << endl;
     
     return true;
 }
 
+void FlightServer::setKeepAlive(int idleTimeoutSeconds, int maxRequestsPerConnection) {
+    loopConfig.idleTimeoutSeconds = idleTimeoutSeconds;
+    loopConfig.maxRequestsPerConnection = maxRequestsPerConnection;
+}
+
 void FlightServer::stop() {
-    if (!isRunning) return;
+    if (!isRunning.exchange(false)) return;
     
-    isRunning = false;
+    if (eventLoop) {
+        eventLoop->stop();
+        eventLoop.reset();
+    }
     
     if (serverSocket >= 0) {
         close(serverSocket);
@@ -251,299 +293,261 @@ void FlightServer::stop() {
     printStats();
 }
 
-void FlightServer::handleClient(int clientSocket) {
-    char buffer[8192] = {0};
-    
-    ssize_t bytesRead = read(clientSocket, buffer, sizeof(buffer) - 1);
-    
-    if (bytesRead > 0) {
-        string request(buffer);
-        stats.requestsProcessed++;
-        
-        string response = handleRequest(request);
-        
-        send(clientSocket, response.c_str(), response.length(), 0);
-    }
-    
-    close(clientSocket);
+// Helper: Parse an integer query parameter, falling back when absent or invalid
+static int queryInt(const RouteMatch& match, string_view name, int fallback) {
+    string_view text = match.query(name);
+    int value = 0;
+    auto result = from_chars(text.data(), text.data() + text.size(), value);
+    if (text.empty() || result.ec != errc() || result.ptr != text.data() + text.size()) return fallback;
+    return value;
 }
 
-string FlightServer::handleRequest(const string& request) {
-    istringstream requestStream(request);
-    string method, path, version;
-    requestStream >> method >> path >> version;
+// Route table - Match FRONTEND API endpoints
+void FlightServer::setupRoutes() {
+    router.add("*", "/api/health", [this](const HttpRequest&, const RouteMatch&) {
+        return handleHealth();
+    });
+    router.add("GET", "/api/flights", [this](const HttpRequest&, const RouteMatch&) {
+        return handleGetFlights();
+    });
+    router.add("POST", "/api/flights", [this](const HttpRequest& request, const RouteMatch&) {
+        return handleAddFlight(request.body);
+    });
+    router.add("*", "/api/flights/range", [this](const HttpRequest&, const RouteMatch& match) {
+        return handleGetFlightsByTime(string(match.query("start", "14:00")),
+                                      string(match.query("end", "17:00")),
+                                      queryInt(match, "limit", 0));
+    });
+    router.add("GET", "/api/flights/:flightNumber", [this](const HttpRequest&, const RouteMatch& match) {
+        return handleSearchFlight(string(match.param(0)));
+    });
+    router.add("DELETE", "/api/flights/:flightNumber", [this](const HttpRequest&, const RouteMatch& match) {
+        return handleDeleteFlight(string(match.param(0)));
+    });
+    router.add("*", "/api/flights/:flightNumber/seats", [this](const HttpRequest&, const RouteMatch& match) {
+        return handleGetSeatMap(string(match.param(0)));
+    });
+    
+    router.add("*", "/api/gates", [this](const HttpRequest&, const RouteMatch&) {
+        return handleGetGates();
+    });
+    router.add("*", "/api/gates/available", [this](const HttpRequest&, const RouteMatch& match) {
+        return handleGetAvailableGates(queryInt(match, "min", 1), queryInt(match, "max", 20));
+    });
+    router.add("POST", "/api/gates/assign", [this](const HttpRequest& request, const RouteMatch&) {
+        return handleAssignGate(request.body);
+    });
+    
+    router.add("GET", "/api/bookings", [this](const HttpRequest&, const RouteMatch&) {
+        return handleGetAllBookings();
+    });
+    router.add("POST", "/api/bookings", [this](const HttpRequest& request, const RouteMatch&) {
+        return handleCreateBooking(request.body);
+    });
+    router.add("GET", "/api/bookings/:pnr", [this](const HttpRequest&, const RouteMatch& match) {
+        return handleGetBooking(string(match.param(0)));
+    });
+    router.add("DELETE", "/api/bookings/:pnr", [this](const HttpRequest&, const RouteMatch& match) {
+        return handleCancelBooking(string(match.param(0)));
+    });
+    router.add("PUT", "/api/bookings/:pnr/checkin", [this](const HttpRequest& request, const RouteMatch& match) {
+        return handleCheckIn(string(match.param(0)), request.body);
+    });
+    
+    router.add("*", "/api/routes/shortest", [this](const HttpRequest&, const RouteMatch& match) {
+        return handleFindRoute(string(match.query("from")), string(match.query("to")), SHORTEST_ROUTE);
+    });
+    router.add("*", "/api/routes/cheapest", [this](const HttpRequest&, const RouteMatch& match) {
+        return handleFindRoute(string(match.query("from")), string(match.query("to")), CHEAPEST_ROUTE);
+    });
+    router.add("*", "/api/routes/fastest", [this](const HttpRequest&, const RouteMatch& match) {
+        return handleFindRoute(string(match.query("from")), string(match.query("to")), FASTEST_ROUTE);
+    });
+    
+    router.add("*", "/api/stats", [this](const HttpRequest&, const RouteMatch&) {
+        return handleGetStats();
+    });
+}
+
+string_view FlightServer::handleRequest(const HttpRequest& request) {
+    string_view method = request.method;
+    string_view path = request.path;
+    string_view query = request.query;
     
     // Handle OPTIONS requests (CORS preflight)
     if (method == "OPTIONS") {
-        stringstream response;
-        response << "HTTP/1.1 200 OK\r\n";
-        response << "Access-Control-Allow-Origin: *\r\n";
-        response << "Access-Control-Allow-Methods: GET, POST, PUT, DELETE, OPTIONS\r\n";
-        response << "Access-Control-Allow-Headers: Content-Type, Authorization\r\n";
-        response << "Access-Control-Max-Age: 86400\r\n";
-        response << "Content-Length: 0\r\n";
-        response << "Connection: close\r\n";
-        response << "\r\n";
-        return response.str();
+        JsonWriter empty;
+        return empty.finish(200, "OK",
+                            "Access-Control-Allow-Origin: *\r\n"
+                            "Access-Control-Allow-Methods: GET, POST, PUT, DELETE, OPTIONS\r\n"
+                            "Access-Control-Allow-Headers: Content-Type, Authorization\r\n"
+                            "Access-Control-Max-Age: 86400\r\n");
     }
     
-    string query;
-    size_t queryPos = path.find('?');
-    if (queryPos != string::npos) {
-        query = path.substr(queryPos + 1);
-        path = path.substr(0, queryPos);
-    }
-    
-    cout << "📥 " << method << " " << path << (query.empty() ? "" : "?" + query) << endl;
+    cout << "📥 " << method << " " << path << (query.empty() ? "" : "?") << query << endl;
     
-    // Route handling - Match FRONTEND API endpoints
-    if (path == "/api/health" || path == "/api/health/") {
-        return handleHealth();
-    }
-    else if (path == "/api/flights" || path == "/api/flights/") {
-        if (method == "GET") return handleGetFlights();
-        if (method == "POST") return handleAddFlight(request);
-    }
-    else if (path.find("/api/flights/range") == 0) {
-        string startTime = "14:00", endTime = "17:00";
-        size_t startPos = query.find("start=");
-        size_t endPos = query.find("end=");
-        if (startPos != string::npos) {
-            size_t end = query.find('&', startPos);
-            startTime = query.substr(startPos + 6, end == string::npos ? string::npos : end - startPos - 6);
-        }
-        if (endPos != string::npos) {
-            size_t end = query.find('&', endPos);
-            endTime = query.substr(endPos + 4, end == string::npos ? string::npos : end - endPos - 4);
-        }
-        return handleGetFlightsByTime(startTime, endTime);
-    }
-    else if (path.find("/api/flights/") == 0) {
-        string flightNum = path.substr(13);
-        if (flightNum.back() == '/') flightNum.pop_back();
-        
-        // Check if it's seat map request
-        if (flightNum.find("/seats") != string::npos) {
-            flightNum = flightNum.substr(0, flightNum.find("/seats"));
-            return handleGetSeatMap(flightNum);
-        }
-        
-        // Regular flight endpoint
-        if (method == "GET") return handleSearchFlight(flightNum);
-        if (method == "DELETE") return handleDeleteFlight(flightNum);
-    }
-    else if (path == "/api/gates" || path == "/api/gates/") {
-        return handleGetGates();
-    }
-    else if (path.find("/api/gates/available") == 0) {
-        return handleGetAvailableGates(1, 20);
-    }
-    else if (path.find("/api/gates/assign") == 0) {
-        if (method == "POST") return handleAssignGate(request);
-    }
-    else if (path == "/api/bookings" || path == "/api/bookings/") {
-        if (method == "GET") return handleGetAllBookings();
-        if (method == "POST") return handleCreateBooking(request);
-    }
-    else if (path.find("/api/bookings/") == 0) {
-        string rest = path.substr(14);
-        size_t slashPos = rest.find('/');
-        string pnr = slashPos == string::npos ? rest : rest.substr(0, slashPos);
-        if (pnr.back() == '/') pnr.pop_back();
-        
-        if (slashPos != string::npos && rest.find("checkin") != string::npos) {
-            if (method == "PUT") return handleCheckIn(pnr, request);
-        }
-        if (method == "GET") return handleGetBooking(pnr);
-        if (method == "DELETE") return handleCancelBooking(pnr);
-    }
-    else if (path.find("/api/routes/shortest") == 0 || 
-             path.find("/api/routes/cheapest") == 0 ||
-             path.find("/api/routes/fastest") == 0) {
-        string from, to;
-        size_t fromPos = query.find("from=");
-        size_t toPos = query.find("to=");
-        if (fromPos != string::npos) {
-            size_t end = query.find('&', fromPos);
-            from = query.substr(fromPos + 5, end == string::npos ? string::npos : end - fromPos - 5);
-        }
-        if (toPos != string::npos) {
-            size_t end = query.find('&', toPos);
-            to = query.substr(toPos + 3, end == string::npos ? string::npos : end - toPos - 3);
-        }
-        return handleGetShortestRoute(from, to);
-    }
-    else if (path == "/api/stats" || path == "/api/stats/") {
-        return handleGetStats();
+    RouteMatch match;
+    const Router::Handler* handler = router.match(request, match);
+    if (handler) {
+        return (*handler)(request, match);
     }
     
-    stringstream json;
-    json << "{\"success\":false,\"error\":\"Endpoint not found: " << path << "\",\"method\":\"" << method << "\"}";
-    return createJSONResponse(404, "Not Found", json.str());
+    JsonWriter json;
+    json.beginObject();
+    json.field("success", false);
+    json.field("error", "Endpoint not found: ", path);
+    json.field("method", method);
+    json.endObject();
+    return createJSONResponse(404, "Not Found", json);
 }
 
 // API: Health check
-string FlightServer::handleHealth() {
-    lock_guard<mutex> lock(dataMutex);
-    
-    stringstream json;
-    json << "{";
-    json << "\"status\":\"ok\",";
-    json << "\"message\":\"Flight Management System API\",";
-    json << "\"backend\":\"C++ Socket Server\",";
-    json << "\"version\":\"1.0.0\",";
-    json << "\"features\":[\"B-Tree\",\"Hash Tables\",\"Dijkstra\",\"Bitmap Seat Map\"],";
-    json << "\"data\":{";
-    json << "\"flights\":" << flights.size() << ",";
-    json << "\"passengers\":" << passengers.size() << ",";
-    json << "\"routes\":" << routes.size();
-    json << "},";
-    json << "\"complexity\":{";
-    json << "\"flightLookup\":\"O(1) - Hash Table\",";
-    json << "\"timeQuery\":\"O(log n + k) - B-Tree\",";
-    json << "\"seatMap\":\"O(1) - Bitmap\",";
-    json << "\"pathFinding\":\"O(E log V) - Dijkstra\"";
-    json << "}";
-    json << "}";
-    
-    return createJSONResponse(200, "OK", json.str());
+string_view FlightServer::handleHealth() {
+    shared_lock<shared_mutex> lock(dataMutex);
+    shared_lock<shared_mutex> passengersLock(passengersMutex);
+    
+    JsonWriter json;
+    json.beginObject();
+    json.field("status", "ok");
+    json.field("message", "Flight Management System API");
+    json.field("backend", "C++ Socket Server");
+    json.field("version", "1.0.0");
+    json.key("features").raw("[\"B-Tree\",\"Hash Tables\",\"Dijkstra\",\"Bitmap Seat Map\"]");
+    json.key("data").beginObject();
+    json.field("flights", flights.getSize());
+    json.field("passengers", passengers.getSize());
+    json.field("routes", routeGraph.getRouteCount());
+    json.endObject();
+    json.key("complexity").beginObject();
+    json.field("flightLookup", "O(1) - Hash Table");
+    json.field("timeQuery", "O(log n + k) - B-Tree");
+    json.field("seatMap", "O(1) - Bitmap");
+    json.field("pathFinding", "O(E log V) - Dijkstra");
+    json.endObject();
+    json.endObject();
+    
+    return createJSONResponse(200, "OK", json);
 }
 
-// API: Get all flights (FIXED RESPONSE FORMAT)
-string FlightServer::handleGetFlights() {
-    lock_guard<mutex> lock(dataMutex);
-    
-    stringstream json;
-    json << "{\"success\":true,\"flights\":[";
-    
-    for (size_t i = 0; i < flights.size(); i++) {
-        if (i > 0) json << ",";
-        json << "{";
-        json << "\"flightNumber\":\"" << flights[i].id << "\",";
-        json << "\"airline\":\"" << flights[i].from << " Airlines\",";
-        json << "\"origin\":\"" << flights[i].from << "\",";
-        json << "\"destination\":\"" << flights[i].to << "\",";
-        json << "\"departureTime\":\"" << flights[i].departure << "\",";
-        json << "\"arrivalTime\":\"" << flights[i].arrival << "\",";
-        json << "\"gate\":\"" << flights[i].gate << "\",";
-        json << "\"status\":\"Scheduled\",";
-        json << "\"price\":" << flights[i].price << ",";
-        json << "\"seats\":" << flights[i].seats;
-        json << "}";
+// API: Get all flights in departure order (FIXED RESPONSE FORMAT)
+string_view FlightServer::handleGetFlights() {
+    shared_lock<shared_mutex> lock(dataMutex);
+    
+    JsonWriter json;
+    json.beginObject();
+    json.field("success", true);
+    json.key("flights").beginArray();
+    
+    // Streamed off the leaf chain
+    for (auto cursor = departures.first(); cursor.valid(); cursor.next()) {
+        const Flight* flight = flights.get(cursor.value());
+        if (flight) {
+            writeFlight(json, *flight, true);
+        }
     }
     
-    json << "],\"count\":" << flights.size() << "}";
+    json.endArray();
+    json.field("count", flights.getSize());
+    json.endObject();
     
-    return createJSONResponse(200, "OK", json.str());
+    return createJSONResponse(200, "OK", json);
 }
 
 // API: Search flight by number (Hash O(1) lookup)
-string FlightServer::handleSearchFlight(const string& flightNumber) {
-    lock_guard<mutex> lock(dataMutex);
-    
-    for (const auto& flight : flights) {
-        if (flight.id == flightNumber) {
-            stringstream json;
-            json << "{\"success\":true,";
-            json << "\"flight\":{";
-            json << "\"flightNumber\":\"" << flight.id << "\",";
-            json << "\"airline\":\"" << flight.from << " Airlines\",";
-            json << "\"origin\":\"" << flight.from << "\",";
-            json << "\"destination\":\"" << flight.to << "\",";
-            json << "\"departureTime\":\"" << flight.departure << "\",";
-            json << "\"arrivalTime\":\"" << flight.arrival << "\",";
-            json << "\"gate\":\"" << flight.gate << "\",";
-            json << "\"status\":\"Scheduled\",";
-            json << "\"price\":" << flight.price << ",";
-            json << "\"seats\":" << flight.seats;
-            json << "},";
-            json << "\"complexity\":\"O(1) - Hash Table lookup\",";
-            json << "\"message\":\"Flight found\"";
-            json << "}";
-            
-            return createJSONResponse(200, "OK", json.str());
-        }
+string_view FlightServer::handleSearchFlight(const string& flightNumber) {
+    shared_lock<shared_mutex> lock(dataMutex);
+    
+    const Flight* flight = flights.get(flightNumber);
+    if (flight) {
+        JsonWriter json;
+        json.beginObject();
+        json.field("success", true);
+        json.key("flight");
+        writeFlight(json, *flight, true);
+        json.field("complexity", "O(1) - Hash Table lookup");
+        json.field("message", "Flight found");
+        json.endObject();
+        
+        return createJSONResponse(200, "OK", json);
     }
     
     return createJSONResponse(404, "Not Found", "{\"success\":false,\"error\":\"Flight not found\",\"complexity\":\"O(1) - Hash Table miss\"}");
 }
 
-// API: Get flights by time range (B-Tree simulation)
-string FlightServer::handleGetFlightsByTime(const string& start, const string& end) {
-    lock_guard<mutex> lock(dataMutex);
-    
-    vector<Flight> filtered;
-    for (const auto& flight : flights) {
-        if (flight.departure >= start && flight.departure <= end) {
-            filtered.push_back(flight);
-        }
+// API: Get flights by time range (B-Tree range query), the first limit of
+// them if limit is positive
+string_view FlightServer::handleGetFlightsByTime(const string& start, const string& end, int limit) {
+    int startMinutes = parseDepartureTime(start);
+    int endMinutes = parseDepartureTime(end);
+    if (startMinutes < 0 || endMinutes < 0) {
+        return createJSONResponse(400, "Bad Request", "{\"success\":false,\"error\":\"Invalid time, expected HH:MM\"}");
     }
     
-    stringstream json;
-    json << "{\"success\":true,\"flights\":[";
-    
-    for (size_t i = 0; i < filtered.size(); i++) {
-        if (i > 0) json << ",";
-        json << "{";
-        json << "\"flightNumber\":\"" << filtered[i].id << "\",";
-        json << "\"airline\":\"" << filtered[i].from << " Airlines\",";
-        json << "\"origin\":\"" << filtered[i].from << "\",";
-        json << "\"destination\":\"" << filtered[i].to << "\",";
-        json << "\"departureTime\":\"" << filtered[i].departure << "\",";
-        json << "\"gate\":\"" << filtered[i].gate << "\",";
-        json << "\"status\":\"Scheduled\"";
-        json << "}";
+    shared_lock<shared_mutex> lock(dataMutex);
+    
+    JsonWriter json;
+    json.beginObject();
+    json.field("success", true);
+    json.key("flights").beginArray();
+    
+    // A seek and a walk along the leaves, stopping at the end of the window
+    // or the limit, so the next N departures cost O(log n + N)
+    size_t count = 0;
+    for (auto cursor = departures.seek(startMinutes);
+         cursor.valid() && cursor.key() <= endMinutes && (limit <= 0 || count < static_cast<size_t>(limit));
+         cursor.next()) {
+        const Flight* flight = flights.get(cursor.value());
+        if (flight) {
+            writeFlight(json, *flight, false);
+            count++;
+        }
     }
     
-    json << "],\"complexity\":\"O(log n + k) - B-Tree range query\",";
-    json << "\"query\":\"" << start << " to " << end << "\",";
-    json << "\"count\":" << filtered.size() << "}";
+    json.endArray();
+    json.field("complexity", "O(log n + k) - B-Tree range query");
+    json.field("query", start + " to ", end);
+    json.field("count", count);
+    json.endObject();
     
-    return createJSONResponse(200, "OK", json.str());
+    return createJSONResponse(200, "OK", json);
 }
 
 // API: Add new flight
-string FlightServer::handleAddFlight(const string& request) {
-    lock_guard<mutex> lock(dataMutex);
-    
-    string body = extractRequestBody(request);
+string_view FlightServer::handleAddFlight(string_view body) {
+    lock_guard<shared_mutex> lock(dataMutex);
     
-    auto extractField = [&body](const string& field) -> string {
-        size_t pos = body.find("\"" + field + "\":");
-        if (pos == string::npos) return "";
-        
-        size_t start = body.find("\"", pos + field.length() + 3);
-        if (start == string::npos) return "";
-        size_t end = body.find("\"", start + 1);
-        if (end == string::npos) return "";
-        
-        return body.substr(start + 1, end - start - 1);
-    };
+    JsonReader reader;
+    if (!reader.parse(body)) {
+        return createJSONResponse(400, "Bad Request", "{\"success\":false,\"error\":\"Invalid JSON body\"}");
+    }
     
-    string flightNumber = extractField("flightNumber");
-    string airline = extractField("airline");
-    string origin = extractField("origin");
-    string destination = extractField("destination");
-    string departureTime = extractField("departureTime");
-    string arrivalTime = extractField("arrivalTime");
-    string gate = extractField("gate");
-    string status = extractField("status");
+    string_view flightNumber = reader.text(reader.root(), "flightNumber");
+    string_view airline = reader.text(reader.root(), "airline");
+    string_view origin = reader.text(reader.root(), "origin");
+    string_view destination = reader.text(reader.root(), "destination");
+    string_view departureTime = reader.text(reader.root(), "departureTime");
+    string_view arrivalTime = reader.text(reader.root(), "arrivalTime");
+    string gate(reader.text(reader.root(), "gate"));
+    string_view status = reader.text(reader.root(), "status");
     
     if (flightNumber.empty() || airline.empty() || origin.empty() || destination.empty()) {
         return createJSONResponse(400, "Bad Request", "{\"success\":false,\"error\":\"Missing required fields\"}");
     }
     
+    // The flight number is the departure index value, which must fit a tree node
+    if (flightNumber.size() > static_cast<size_t>(MAX_VALUE_SIZE)) {
+        return createJSONResponse(400, "Bad Request", "{\"success\":false,\"error\":\"Flight number too long\"}");
+    }
+    
     // Check if flight already exists
-    for (const auto& flight : flights) {
-        if (flight.id == flightNumber) {
-            return createJSONResponse(400, "Bad Request", "{\"success\":false,\"error\":\"Flight already exists\"}");
-        }
+    if (flights.contains(string(flightNumber))) {
+        return createJSONResponse(400, "Bad Request", "{\"success\":false,\"error\":\"Flight already exists\"}");
     }
     
     // Auto-assign gate if not provided
     if (gate.empty()) {
-        char gateLetter = 'A' + (flights.size() % 4);
-        int gateNum = (flights.size() % 6) + 1;
+        char gateLetter = 'A' + (flights.getSize() % 4);
+        int gateNum = (flights.getSize() % 6) + 1;
         gate = string(1, gateLetter) + (gateNum < 10 ? "0" + to_string(gateNum) : to_string(gateNum));
     }
     
@@ -552,654 +556,730 @@ string FlightServer::handleAddFlight(const string& request) {
     if (arrivalTime.empty()) arrivalTime = "18:00";
     if (status.empty()) status = "Scheduled";
     
-    Flight newFlight(flightNumber, origin, destination, departureTime, arrivalTime, gate, 500.0, 180);
-    flights.push_back(newFlight);
+    int departureMinutes = parseDepartureTime(departureTime);
+    if (departureMinutes < 0) {
+        return createJSONResponse(400, "Bad Request", "{\"success\":false,\"error\":\"Invalid departure time, expected HH:MM\"}");
+    }
+    
+    Flight newFlight(string(flightNumber), string(origin), string(destination),
+                     string(departureTime), string(arrivalTime), gate, 500.0, 180);
+    if (!indexDeparture(newFlight, departureMinutes)) {
+        return createJSONResponse(500, "Internal Server Error", "{\"success\":false,\"error\":\"Cannot index flight departure\"}");
+    }
+    flights.insert(newFlight.id, newFlight);
     
     // Initialize seat map for new flight
-    seatMaps[flightNumber] = vector<bool>(180, false);
+    seatInventories[newFlight.id].reset(new SeatInventory());
     
     cout << "✈️  Flight added: " << flightNumber << " (" << origin << " → " << destination 
          << ") Departure: " << departureTime << " Gate: " << gate << endl;
     
-    stringstream json;
-    json << "{";
-    json << "\"success\":true,";
-    json << "\"message\":\"Flight added successfully!\",";
-    json << "\"flightNumber\":\"" << flightNumber << "\",";
-    json << "\"airline\":\"" << airline << "\",";
-    json << "\"gate\":\"" << gate << "\",";
-    json << "\"status\":\"" << status << "\",";
-    json << "\"complexity\":\"O(1) - Hash Table insertion\",";
-    json << "\"dataStructure\":\"B-Tree + HashMap\"";
-    json << "}";
-    
-    return createJSONResponse(200, "OK", json.str());
+    JsonWriter json;
+    json.beginObject();
+    json.field("success", true);
+    json.field("message", "Flight added successfully!");
+    json.field("flightNumber", flightNumber);
+    json.field("airline", airline);
+    json.field("gate", gate);
+    json.field("status", status);
+    json.field("complexity", "O(1) - Hash Table insertion");
+    json.field("dataStructure", "B-Tree + HashMap");
+    json.endObject();
+    
+    return createJSONResponse(200, "OK", json);
 }
 
 // API: Delete/Cancel flight
-string FlightServer::handleDeleteFlight(const string& flightNumber) {
-    lock_guard<mutex> lock(dataMutex);
-    
-    for (auto it = flights.begin(); it != flights.end(); ++it) {
-        if (it->id == flightNumber) {
-            flights.erase(it);
-            seatMaps.erase(flightNumber);
-            
-            stringstream json;
-            json << "{\"success\":true,\"message\":\"Flight cancelled successfully\"}";
-            
-            return createJSONResponse(200, "OK", json.str());
-        }
+string_view FlightServer::handleDeleteFlight(const string& flightNumber) {
+    lock_guard<shared_mutex> lock(dataMutex);
+    
+    const Flight* flight = flights.get(flightNumber);
+    if (flight) {
+        departures.remove(flight->departureKey, flight->id);
+        flights.remove(flightNumber);
+        seatInventories.erase(flightNumber);
+        
+        return createJSONResponse(200, "OK", "{\"success\":true,\"message\":\"Flight cancelled successfully\"}");
     }
     
     return createJSONResponse(404, "Not Found", "{\"success\":false,\"error\":\"Flight not found\"}");
 }
 
 // API: Get all gates
-string FlightServer::handleGetGates() {
-    lock_guard<mutex> lock(dataMutex);
+string_view FlightServer::handleGetGates() {
+    shared_lock<shared_mutex> lock(dataMutex);
     
-    vector<string> allGates = {"A01", "A02", "A03", "A04", "A05", "A06",
-                               "B01", "B02", "B03", "B04", "B05", "B06",
-                               "C01", "C02", "C03", "D01", "D02"};
+    static const char* const allGates[] = {"A01", "A02", "A03", "A04", "A05", "A06",
+                                           "B01", "B02", "B03", "B04", "B05", "B06",
+                                           "C01", "C02", "C03", "D01", "D02"};
     
-    stringstream json;
-    json << "{\"success\":true,\"gates\":[";
+    const int gateCount = sizeof(allGates) / sizeof(allGates[0]);
     
-    for (size_t i = 0; i < allGates.size(); i++) {
-        if (i > 0) json << ",";
-        
-        bool occupied = false;
-        string currentFlight = "";
-        for (const auto& flight : flights) {
-            if (flight.gate == allGates[i]) {
-                occupied = true;
-                currentFlight = flight.id;
+    // A flight at each gate, in one pass over the flights
+    const Flight* occupants[gateCount] = {};
+    flights.forEach([&](const string&, const Flight& flight) {
+        for (int i = 0; i < gateCount; i++) {
+            if (!occupants[i] && flight.gate == allGates[i]) {
+                occupants[i] = &flight;
                 break;
             }
         }
+    });
+    
+    JsonWriter json;
+    json.beginObject();
+    json.field("success", true);
+    json.key("gates").beginArray();
+    
+    for (int i = 0; i < gateCount; i++) {
+        const char* gate = allGates[i];
+        const Flight* currentFlight = occupants[i];
         
-        json << "{";
-        json << "\"gateNumber\":\"" << allGates[i] << "\",";
-        json << "\"terminal\":\"" << allGates[i][0] << "\",";
-        json << "\"status\":\"" << (occupied ? "Occupied" : "Available") << "\",";
-        json << "\"occupied\":" << (occupied ? "true" : "false");
-        if (!currentFlight.empty()) {
-            json << ",\"currentFlight\":\"" << currentFlight << "\"";
+        json.beginObject();
+        json.field("gateNumber", gate);
+        json.field("terminal", gate[0]);
+        json.field("status", currentFlight ? "Occupied" : "Available");
+        json.field("occupied", currentFlight != nullptr);
+        if (currentFlight) {
+            json.field("currentFlight", currentFlight->id);
         }
-        json << "}";
+        json.endObject();
     }
     
-    json << "],\"count\":" << allGates.size() << "}";
+    json.endArray();
+    json.field("count", gateCount);
+    json.endObject();
     
-    return createJSONResponse(200, "OK", json.str());
+    return createJSONResponse(200, "OK", json);
 }
 
 // API: Get available gates
-string FlightServer::handleGetAvailableGates(int min, int max) {
-    lock_guard<mutex> lock(dataMutex);
-    
-    vector<string> allGates = {"A01", "A02", "A03", "A04", "A05", "A06",
-                               "B01", "B02", "B03", "B04", "B05", "B06",
-                               "C01", "C02", "C03", "D01", "D02"};
-    
-    vector<string> available;
-    for (const auto& gate : allGates) {
-        bool occupied = false;
-        for (const auto& flight : flights) {
-            if (flight.gate == gate) {
-                occupied = true;
+string_view FlightServer::handleGetAvailableGates(int min, int max) {
+    shared_lock<shared_mutex> lock(dataMutex);
+    
+    static const char* const allGates[] = {"A01", "A02", "A03", "A04", "A05", "A06",
+                                           "B01", "B02", "B03", "B04", "B05", "B06",
+                                           "C01", "C02", "C03", "D01", "D02"};
+    
+    const int gateCount = sizeof(allGates) / sizeof(allGates[0]);
+    
+    bool occupied[gateCount] = {};
+    flights.forEach([&](const string&, const Flight& flight) {
+        for (int i = 0; i < gateCount; i++) {
+            if (flight.gate == allGates[i]) {
+                occupied[i] = true;
                 break;
             }
         }
-        if (!occupied) {
-            available.push_back(gate);
+    });
+    
+    vector<const char*> available;
+    for (int i = 0; i < gateCount; i++) {
+        // Gate number is the digits after the terminal letter
+        int number = atoi(allGates[i] + 1);
+        if (number >= min && number <= max && !occupied[i]) {
+            available.push_back(allGates[i]);
         }
     }
     
-    stringstream json;
-    json << "{\"success\":true,\"gates\":[";
-    
-    for (size_t i = 0; i < available.size(); i++) {
-        if (i > 0) json << ",";
-        json << "{";
-        json << "\"gateNumber\":\"" << available[i] << "\",";
-        json << "\"terminal\":\"" << available[i][0] << "\",";
-        json << "\"status\":\"Available\"";
-        json << "}";
+    JsonWriter json;
+    json.beginObject();
+    json.field("success", true);
+    json.key("gates").beginArray();
+    
+    for (const auto& gate : available) {
+        json.beginObject();
+        json.field("gateNumber", gate);
+        json.field("terminal", gate[0]);
+        json.field("status", "Available");
+        json.endObject();
     }
     
-    json << "],\"count\":" << available.size() << "}";
+    json.endArray();
+    json.field("count", available.size());
+    json.endObject();
     
-    return createJSONResponse(200, "OK", json.str());
+    return createJSONResponse(200, "OK", json);
 }
 
 // API: Assign gate to flight
-string FlightServer::handleAssignGate(const string& request) {
-    lock_guard<mutex> lock(dataMutex);
+string_view FlightServer::handleAssignGate(string_view body) {
+    lock_guard<shared_mutex> lock(dataMutex);
     
-    string body = extractRequestBody(request);
-    
-    auto extractField = [&body](const string& field) -> string {
-        size_t pos = body.find("\"" + field + "\":");
-        if (pos == string::npos) return "";
-        
-        size_t start = body.find("\"", pos + field.length() + 3);
-        if (start == string::npos) return "";
-        size_t end = body.find("\"", start + 1);
-        if (end == string::npos) return "";
-        
-        return body.substr(start + 1, end - start - 1);
-    };
+    JsonReader reader;
+    if (!reader.parse(body)) {
+        return createJSONResponse(400, "Bad Request", "{\"success\":false,\"error\":\"Invalid JSON body\"}");
+    }
     
-    string flightNumber = extractField("flightNumber");
-    string gateNumber = extractField("gateNumber");
+    string_view flightNumber = reader.text(reader.root(), "flightNumber");
+    string_view gateNumber = reader.text(reader.root(), "gateNumber");
     
     if (flightNumber.empty() || gateNumber.empty()) {
         return createJSONResponse(400, "Bad Request", "{\"success\":false,\"error\":\"Missing flight number or gate\"}");
     }
     
     // Check if gate is already occupied
-    for (const auto& flight : flights) {
+    bool gateTaken = false;
+    flights.forEach([&](const string&, const Flight& flight) {
         if (flight.gate == gateNumber && flight.id != flightNumber) {
-            return createJSONResponse(400, "Bad Request", "{\"success\":false,\"error\":\"Gate already occupied\"}");
+            gateTaken = true;
         }
+    });
+    if (gateTaken) {
+        return createJSONResponse(400, "Bad Request", "{\"success\":false,\"error\":\"Gate already occupied\"}");
     }
     
     // Find and update flight
-    for (auto& flight : flights) {
-        if (flight.id == flightNumber) {
-            string oldGate = flight.gate;
-            flight.gate = gateNumber;
-            
-            cout << "🚪 Gate assigned: " << flightNumber << " → " << gateNumber << endl;
-            
-            stringstream json;
-            json << "{";
-            json << "\"success\":true,";
-            json << "\"message\":\"Gate assigned successfully\",";
-            json << "\"flightNumber\":\"" << flightNumber << "\",";
-            json << "\"gate\":\"" << gateNumber << "\",";
-            json << "\"oldGate\":\"" << oldGate << "\"";
-            json << "}";
-            
-            return createJSONResponse(200, "OK", json.str());
-        }
+    Flight* flight = flights.get(string(flightNumber));
+    if (flight) {
+        string oldGate = flight->gate;
+        flight->gate = gateNumber;
+        
+        cout << "🚪 Gate assigned: " << flightNumber << " → " << gateNumber << endl;
+        
+        JsonWriter json;
+        json.beginObject();
+        json.field("success", true);
+        json.field("message", "Gate assigned successfully");
+        json.field("flightNumber", flightNumber);
+        json.field("gate", gateNumber);
+        json.field("oldGate", oldGate);
+        json.endObject();
+        
+        return createJSONResponse(200, "OK", json);
     }
     
     return createJSONResponse(404, "Not Found", "{\"success\":false,\"error\":\"Flight not found\"}");
 }
 
 // API: Create booking
-string FlightServer::handleCreateBooking(const string& request) {
-    lock_guard<mutex> lock(dataMutex);
-    
-    string body = extractRequestBody(request);
-    
-    auto extractField = [&body](const string& field) -> string {
-        size_t pos = body.find("\"" + field + "\":");
-        if (pos == string::npos) return "";
-        
-        size_t start = body.find("\"", pos + field.length() + 3);
-        if (start == string::npos) return "";
-        size_t end = body.find("\"", start + 1);
-        if (end == string::npos) return "";
-        
-        return body.substr(start + 1, end - start - 1);
-    };
+string_view FlightServer::handleCreateBooking(string_view body) {
+    // Shared: only the passenger map and this flight's seats are modified,
+    // each under its own lock
+    shared_lock<shared_mutex> lock(dataMutex);
+    
+    JsonReader reader;
+    if (!reader.parse(body)) {
+        return createJSONResponse(400, "Bad Request", "{\"success\":false,\"error\":\"Invalid JSON body\"}");
+    }
     
-    string pnr = extractField("pnr");
-    string passengerName = extractField("passengerName");
-    string email = extractField("email");
-    string flightNumber = extractField("flightNumber");
-    string classType = extractField("classType");
-    string seatNumber = extractField("seatNumber");
+    // pnr and flightNumber key the maps below, so they are copied once
+    string pnr(reader.text(reader.root(), "pnr"));
+    string_view passengerName = reader.text(reader.root(), "passengerName");
+    string_view email = reader.text(reader.root(), "email");
+    string flightNumber(reader.text(reader.root(), "flightNumber"));
+    string_view classType = reader.text(reader.root(), "classType");
+    string_view seatNumber = reader.text(reader.root(), "seatNumber");
     
     if (pnr.empty() || passengerName.empty() || flightNumber.empty()) {
         return createJSONResponse(400, "Bad Request", "{\"success\":false,\"error\":\"Missing required fields\"}");
     }
     
-    // Check if PNR already exists
-    if (passengers.find(pnr) != passengers.end()) {
-        return createJSONResponse(400, "Bad Request", "{\"success\":false,\"error\":\"PNR already exists\"}");
+    // Check if flight exists
+    SeatInventory* inventory = findInventory(flightNumber);
+    if (!inventory) {
+        return createJSONResponse(404, "Not Found", "{\"success\":false,\"error\":\"Flight not found\"}");
     }
     
-    // Check if flight exists
-    bool flightExists = false;
-    for (const auto& flight : flights) {
-        if (flight.id == flightNumber) {
-            flightExists = true;
-            break;
+    // Convert seat like "12A" to index
+    int seatIndex = -1;
+    if (!seatNumber.empty()) {
+        seatIndex = SeatInventory::parseSeat(seatNumber);
+        if (seatIndex < 0) {
+            return createJSONResponse(400, "Bad Request", "{\"success\":false,\"error\":\"Invalid seat number\"}");
         }
     }
     
-    if (!flightExists) {
-        return createJSONResponse(404, "Not Found", "{\"success\":false,\"error\":\"Flight not found\"}");
+    Passenger newPassenger(pnr, string(passengerName),
+                          email.empty() ? string(passengerName) + "@example.com" : string(email),
+                          flightNumber, string(seatNumber),
+                          classType.empty() ? "Economy" : string(classType), false);
+    // The seat is claimed under the flight's own lock, so bookings on
+    // different flights never wait on each other. It is only assigned once
+    // the PNR is in, under the passenger map as check-in and cancellation
+    // see it; until then the claim is this request's alone to give back.
+    if (seatIndex >= 0) {
+        lock_guard<mutex> seatLock(inventory->mutex());
+        if (inventory->assignments.count(pnr)) {
+            return createJSONResponse(400, "Bad Request", "{\"success\":false,\"error\":\"PNR already exists\"}");
+        }
+        if (!inventory->claim(seatIndex)) {
+            return createJSONResponse(400, "Bad Request", "{\"success\":false,\"error\":\"Seat already occupied\"}");
+        }
     }
     
-    // If seat is specified, check availability
-    if (!seatNumber.empty()) {
-        // Convert seat like "12A" to index
-        string seatStr = seatNumber;
-        int row = stoi(seatStr.substr(0, seatStr.length() - 1));
-        char col = seatStr.back();
-        int seatIndex = (row - 1) * 6 + (col - 'A');
-        
-        if (seatMaps[flightNumber][seatIndex]) {
-            return createJSONResponse(400, "Bad Request", "{\"success\":false,\"error\":\"Seat already occupied\"}");
+    bool inserted;
+    {
+        lock_guard<shared_mutex> passengersLock(passengersMutex);
+        inserted = !passengers.contains(pnr);
+        if (inserted) {
+            passengers.insert(pnr, newPassenger);
+        }
+        if (seatIndex >= 0) {
+            lock_guard<mutex> seatLock(inventory->mutex());
+            if (inserted) {
+                inventory->assignments[pnr] = seatIndex;
+            } else {
+                inventory->release(seatIndex);
+            }
         }
-        
-        // Reserve the seat
-        seatMaps[flightNumber][seatIndex] = true;
-        seatAssignments[flightNumber][pnr] = seatIndex;
     }
     
-    Passenger newPassenger(pnr, passengerName, email.empty() ? passengerName + "@example.com" : email,
-                          flightNumber, seatNumber, classType.empty() ? "Economy" : classType, false);
-    passengers[pnr] = newPassenger;
+    if (!inserted) {
+        return createJSONResponse(400, "Bad Request", "{\"success\":false,\"error\":\"PNR already exists\"}");
+    }
     
     cout << "🎫 Booking created: " << pnr << " for " << passengerName << " on " << flightNumber 
          << " Seat: " << (seatNumber.empty() ? "Auto-assign" : seatNumber) << endl;
     
-    stringstream json;
-    json << "{";
-    json << "\"success\":true,";
-    json << "\"message\":\"Booking created successfully\",";
-    json << "\"pnr\":\"" << pnr << "\",";
-    json << "\"passengerName\":\"" << passengerName << "\",";
-    json << "\"flightNumber\":\"" << flightNumber << "\",";
-    json << "\"seatNumber\":\"" << (seatNumber.empty() ? "Auto-assign" : seatNumber) << "\",";
-    json << "\"classType\":\"" << (classType.empty() ? "Economy" : classType) << "\"";
-    json << "}";
-    
-    return createJSONResponse(200, "OK", json.str());
+    JsonWriter json;
+    json.beginObject();
+    json.field("success", true);
+    json.field("message", "Booking created successfully");
+    json.field("pnr", pnr);
+    json.field("passengerName", passengerName);
+    json.field("flightNumber", flightNumber);
+    json.field("seatNumber", seatNumber.empty() ? "Auto-assign" : seatNumber);
+    json.field("classType", classType.empty() ? "Economy" : classType);
+    json.endObject();
+    
+    return createJSONResponse(200, "OK", json);
 }
 
 // API: Get booking by PNR
-string FlightServer::handleGetBooking(const string& pnr) {
-    lock_guard<mutex> lock(dataMutex);
-    
-    auto it = passengers.find(pnr);
-    if (it != passengers.end()) {
-        stringstream json;
-        json << "{\"success\":true,";
-        json << "\"pnr\":\"" << it->second.pnr << "\",";
-        json << "\"passengerName\":\"" << it->second.name << "\",";
-        json << "\"email\":\"" << it->second.email << "\",";
-        json << "\"flightNumber\":\"" << it->second.flightId << "\",";
-        json << "\"seatNumber\":\"" << (it->second.seat.empty() ? "" : it->second.seat) << "\",";
-        json << "\"classType\":\"" << it->second.classType << "\",";
-        json << "\"checkedIn\":" << (it->second.checkedIn ? "true" : "false") << ",";
-        json << "\"complexity\":\"O(1) - Hash Table lookup\"";
-        json << "}";
+string_view FlightServer::handleGetBooking(const string& pnr) {
+    shared_lock<shared_mutex> lock(dataMutex);
+    shared_lock<shared_mutex> passengersLock(passengersMutex);
+    
+    const Passenger* passenger = passengers.get(pnr);
+    if (passenger) {
+        string seat;
+        bool checkedIn;
+        readSeatState(*passenger, seat, checkedIn);
+        
+        JsonWriter json;
+        json.beginObject();
+        json.field("success", true);
+        json.field("pnr", passenger->pnr);
+        json.field("passengerName", passenger->name);
+        json.field("email", passenger->email);
+        json.field("flightNumber", passenger->flightId);
+        json.field("seatNumber", seat);
+        json.field("classType", passenger->classType);
+        json.field("checkedIn", checkedIn);
+        json.field("complexity", "O(1) - Hash Table lookup");
+        json.endObject();
         
-        return createJSONResponse(200, "OK", json.str());
+        return createJSONResponse(200, "OK", json);
     }
     
     return createJSONResponse(404, "Not Found", "{\"success\":false,\"error\":\"Booking not found\"}");
 }
 
 // API: Get all bookings
-string FlightServer::handleGetAllBookings() {
-    lock_guard<mutex> lock(dataMutex);
-    
-    stringstream json;
-    json << "{\"success\":true,\"bookings\":[";
-    
-    int count = 0;
-    for (const auto& pair : passengers) {
-        if (count > 0) json << ",";
-        json << "{";
-        json << "\"pnr\":\"" << pair.first << "\",";
-        json << "\"passengerName\":\"" << pair.second.name << "\",";
-        json << "\"flightNumber\":\"" << pair.second.flightId << "\",";
-        json << "\"seatNumber\":\"" << pair.second.seat << "\",";
-        json << "\"classType\":\"" << pair.second.classType << "\",";
-        json << "\"checkedIn\":" << (pair.second.checkedIn ? "true" : "false");
-        json << "}";
-        count++;
-    }
+string_view FlightServer::handleGetAllBookings() {
+    shared_lock<shared_mutex> lock(dataMutex);
+    shared_lock<shared_mutex> passengersLock(passengersMutex);
     
-    json << "],\"count\":" << count << "}";
+    JsonWriter json;
+    json.beginObject();
+    json.field("success", true);
+    json.key("bookings").beginArray();
     
-    return createJSONResponse(200, "OK", json.str());
+    string seat;
+    bool checkedIn;
+    passengers.forEach([&](const string& pnr, const Passenger& passenger) {
+        readSeatState(passenger, seat, checkedIn);
+        
+        json.beginObject();
+        json.field("pnr", pnr);
+        json.field("passengerName", passenger.name);
+        json.field("flightNumber", passenger.flightId);
+        json.field("seatNumber", seat);
+        json.field("classType", passenger.classType);
+        json.field("checkedIn", checkedIn);
+        json.endObject();
+    });
+    
+    json.endArray();
+    json.field("count", passengers.getSize());
+    json.endObject();
+    
+    return createJSONResponse(200, "OK", json);
 }
 
 // API: Cancel booking
-string FlightServer::handleCancelBooking(const string& pnr) {
-    lock_guard<mutex> lock(dataMutex);
+string_view FlightServer::handleCancelBooking(const string& pnr) {
+    shared_lock<shared_mutex> lock(dataMutex);
+    lock_guard<shared_mutex> passengersLock(passengersMutex);
     
-    auto it = passengers.find(pnr);
-    if (it != passengers.end()) {
+    const Passenger* passenger = passengers.get(pnr);
+    if (passenger) {
         // Free the seat if assigned
-        if (!it->second.seat.empty()) {
-            string flightId = it->second.flightId;
-            auto seatIt = seatAssignments[flightId].find(pnr);
-            if (seatIt != seatAssignments[flightId].end()) {
-                int seatIndex = seatIt->second;
-                seatMaps[flightId][seatIndex] = false;
-                seatAssignments[flightId].erase(pnr);
+        SeatInventory* inventory = findInventory(passenger->flightId);
+        if (inventory) {
+            lock_guard<mutex> seatLock(inventory->mutex());
+            auto seatIt = inventory->assignments.find(pnr);
+            if (seatIt != inventory->assignments.end()) {
+                inventory->release(seatIt->second);
+                inventory->assignments.erase(seatIt);
             }
         }
         
-        passengers.erase(it);
+        passengers.remove(pnr);
         
-        stringstream json;
-        json << "{\"success\":true,\"message\":\"Booking cancelled successfully\"}";
-        
-        return createJSONResponse(200, "OK", json.str());
+        return createJSONResponse(200, "OK", "{\"success\":true,\"message\":\"Booking cancelled successfully\"}");
     }
     
     return createJSONResponse(404, "Not Found", "{\"success\":false,\"error\":\"Booking not found\"}");
 }
 
 // API: Check-in passenger with seat assignment
-string FlightServer::handleCheckIn(const string& pnr, const string& request) {
-    lock_guard<mutex> lock(dataMutex);
-    
-    auto it = passengers.find(pnr);
-    if (it == passengers.end()) {
+string_view FlightServer::handleCheckIn(const string& pnr, string_view body) {
+    // Only this flight's seat lock is taken exclusively, so check-ins on
+    // different flights run in parallel
+    shared_lock<shared_mutex> lock(dataMutex);
+    shared_lock<shared_mutex> passengersLock(passengersMutex);
+    
+    Passenger* passenger = passengers.get(pnr);
+    if (!passenger) {
         return createJSONResponse(404, "Not Found", "{\"success\":false,\"error\":\"Booking not found\"}");
     }
     
-    string body = extractRequestBody(request);
-    
     // Extract seat number from request
-    auto extractField = [&body](const string& field) -> string {
-        size_t pos = body.find("\"" + field + "\":");
-        if (pos == string::npos) return "";
-        
-        size_t start = body.find("\"", pos + field.length() + 3);
-        if (start == string::npos) return "";
-        size_t end = body.find("\"", start + 1);
-        if (end == string::npos) return "";
-        
-        return body.substr(start + 1, end - start - 1);
-    };
+    JsonReader reader;
+    if (!reader.parse(body)) {
+        return createJSONResponse(400, "Bad Request", "{\"success\":false,\"error\":\"Invalid JSON body\"}");
+    }
     
-    string seatNumber = extractField("seatNumber");
+    string seatNumber(reader.text(reader.root(), "seatNumber"));
+    
+    SeatInventory* inventory = findInventory(passenger->flightId);
+    if (!inventory) {
+        return createJSONResponse(404, "Not Found", "{\"success\":false,\"error\":\"Flight not found\"}");
+    }
+    
+    lock_guard<mutex> seatLock(inventory->mutex());
+    
+    auto held = inventory->assignments.find(pnr);
+    int heldSeat = held == inventory->assignments.end() ? -1 : held->second;
+    int seatIndex;
     
-    // If no seat specified, auto-assign
     if (seatNumber.empty()) {
-        // Find first available seat
-        const auto& seats = seatMaps[it->second.flightId];
-        for (int i = 0; i < 180; i++) {
-            if (!seats[i]) {
-                int row = (i / 6) + 1;
-                char col = 'A' + (i % 6);
-                seatNumber = to_string(row) + col;
-                
-                // Reserve seat
-                seatMaps[it->second.flightId][i] = true;
-                seatAssignments[it->second.flightId][pnr] = i;
-                break;
-            }
-        }
-        
-        if (seatNumber.empty()) {
+        // No seat specified: keep the booked seat, or auto-assign the first available one
+        seatIndex = heldSeat >= 0 ? heldSeat : inventory->claimFirstFree();
+        if (seatIndex < 0) {
             return createJSONResponse(400, "Bad Request", "{\"success\":false,\"error\":\"No seats available\"}");
         }
+        seatNumber = SeatInventory::seatLabel(seatIndex);
     } else {
         // Check if seat is available
-        string seatStr = seatNumber;
-        int row = stoi(seatStr.substr(0, seatStr.length() - 1));
-        char col = seatStr.back();
-        int seatIndex = (row - 1) * 6 + (col - 'A');
-        
-        if (seatIndex < 0 || seatIndex >= 180) {
+        seatIndex = SeatInventory::parseSeat(seatNumber);
+        if (seatIndex < 0) {
             return createJSONResponse(400, "Bad Request", "{\"success\":false,\"error\":\"Invalid seat number\"}");
         }
         
-        if (seatMaps[it->second.flightId][seatIndex]) {
+        if (seatIndex != heldSeat && !inventory->claim(seatIndex)) {
             return createJSONResponse(400, "Bad Request", "{\"success\":false,\"error\":\"Seat already occupied\"}");
         }
-        
-        // Reserve the seat
-        seatMaps[it->second.flightId][seatIndex] = true;
-        seatAssignments[it->second.flightId][pnr] = seatIndex;
     }
     
+    // Moving to a different seat gives the old one back
+    if (heldSeat >= 0 && heldSeat != seatIndex) {
+        inventory->release(heldSeat);
+    }
+    inventory->assignments[pnr] = seatIndex;
+    
     // Update passenger
-    it->second.seat = seatNumber;
-    it->second.checkedIn = true;
-    
-    cout << "✅ Check-in: " << pnr << " - " << it->second.name 
-         << " Seat: " << seatNumber << " Flight: " << it->second.flightId << endl;
-    
-    stringstream json;
-    json << "{";
-    json << "\"success\":true,";
-    json << "\"message\":\"Check-in successful\",";
-    json << "\"pnr\":\"" << pnr << "\",";
-    json << "\"passengerName\":\"" << it->second.name << "\",";
-    json << "\"flightNumber\":\"" << it->second.flightId << "\",";
-    json << "\"seatNumber\":\"" << seatNumber << "\",";
-    json << "\"classType\":\"" << it->second.classType << "\",";
-    json << "\"operation\":\"O(1) - Hash Table + Bitmap update\"";
-    json << "}";
-    
-    return createJSONResponse(200, "OK", json.str());
+    passenger->seat = seatNumber;
+    passenger->checkedIn = true;
+    
+    cout << "✅ Check-in: " << pnr << " - " << passenger->name 
+         << " Seat: " << seatNumber << " Flight: " << passenger->flightId << endl;
+    
+    JsonWriter json;
+    json.beginObject();
+    json.field("success", true);
+    json.field("message", "Check-in successful");
+    json.field("pnr", pnr);
+    json.field("passengerName", passenger->name);
+    json.field("flightNumber", passenger->flightId);
+    json.field("seatNumber", seatNumber);
+    json.field("classType", passenger->classType);
+    json.field("operation", "O(1) - Hash Table + Bitmap update");
+    json.endObject();
+    
+    return createJSONResponse(200, "OK", json);
 }
 
 // API: Get seat map (Bitmap visualization)
-string FlightServer::handleGetSeatMap(const string& flightNumber) {
-    lock_guard<mutex> lock(dataMutex);
+string_view FlightServer::handleGetSeatMap(const string& flightNumber) {
+    shared_lock<shared_mutex> lock(dataMutex);
     
-    if (seatMaps.find(flightNumber) == seatMaps.end()) {
+    SeatInventory* inventory = findInventory(flightNumber);
+    if (!inventory) {
         return createJSONResponse(404, "Not Found", "{\"success\":false,\"error\":\"Flight not found\"}");
     }
     
-    const auto& seats = seatMaps[flightNumber];
+    shared_lock<shared_mutex> passengersLock(passengersMutex);
+    lock_guard<mutex> seatLock(inventory->mutex());
+    
+    // Passenger name per seat index, in one pass over the assignments
+    string_view seatPassengers[SeatInventory::SEAT_COUNT];
+    for (const auto& assignment : inventory->assignments) {
+        const Passenger* passenger = passengers.get(assignment.first);
+        if (passenger) {
+            seatPassengers[assignment.second] = passenger->name;
+        }
+    }
     
-    // Count available seats
+    // Snapshot occupancy so the counts match the map
+    bool seats[SeatInventory::SEAT_COUNT];
     int available = 0;
-    for (bool taken : seats) {
-        if (!taken) available++;
+    for (int i = 0; i < SeatInventory::SEAT_COUNT; i++) {
+        seats[i] = inventory->isTaken(i);
+        if (!seats[i]) available++;
     }
     
-    stringstream json;
-    json << "{\"success\":true,";
-    json << "\"flightNumber\":\"" << flightNumber << "\",";
-    json << "\"totalSeats\":180,";
-    json << "\"availableSeats\":" << available << ",";
-    json << "\"occupiedSeats\":" << (180 - available) << ",";
-    json << "\"seatMap\":[";
+    JsonWriter json;
+    json.beginObject();
+    json.field("success", true);
+    json.field("flightNumber", flightNumber);
+    json.field("totalSeats", 180);
+    json.field("availableSeats", available);
+    json.field("occupiedSeats", 180 - available);
+    json.key("seatMap").beginArray();
     
     for (int i = 0; i < 180; i++) {
-        if (i > 0) json << ",";
-        
         int row = (i / 6) + 1;
         char col = 'A' + (i % 6);
         
-        json << "{";
-        json << "\"seatNumber\":\"" << row << col << "\",";
-        json << "\"row\":" << row << ",";
-        json << "\"column\":\"" << col << "\",";
-        json << "\"available\":" << (!seats[i] ? "true" : "false") << ",";
+        // Seat label like "12A"
+        char label[8];
+        char* labelEnd = to_chars(label, label + sizeof(label) - 1, row).ptr;
+        *labelEnd++ = col;
         
-        // Find passenger in this seat
-        string passengerName = "";
-        for (const auto& assignment : seatAssignments[flightNumber]) {
-            if (assignment.second == i) {
-                auto passengerIt = passengers.find(assignment.first);
-                if (passengerIt != passengers.end()) {
-                    passengerName = passengerIt->second.name;
-                }
-                break;
-            }
-        }
+        json.beginObject();
+        json.field("seatNumber", string_view(label, labelEnd - label));
+        json.field("row", row);
+        json.field("column", col);
+        json.field("available", !seats[i]);
         
-        json << "\"passengerName\":\"" << passengerName << "\"";
-        json << "}";
+        json.field("passengerName", seatPassengers[i]);
+        json.endObject();
     }
     
-    json << "],";
-    json << "\"dataStructure\":\"Bitmap (180 bits)\",";
-    json << "\"complexity\":\"O(1) seat lookup\"";
-    json << "}";
+    json.endArray();
+    json.field("dataStructure", "Bitmap (180 bits)");
+    json.field("complexity", "O(1) seat lookup");
+    json.endObject();
     
-    return createJSONResponse(200, "OK", json.str());
+    return createJSONResponse(200, "OK", json);
 }
 
-// API: Find shortest route (Dijkstra simulation)
-string FlightServer::handleGetShortestRoute(const string& from, const string& to) {
-    lock_guard<mutex> lock(dataMutex);
-    
+// API: Find the shortest, cheapest or fastest route (Dijkstra over the route graph)
+string_view FlightServer::handleFindRoute(const string& from, const string& to, RouteCriterion criterion) {
     if (from.empty() || to.empty()) {
         return createJSONResponse(400, "Bad Request", "{\"success\":false,\"error\":\"Missing from or to parameters\"}");
     }
     
-    // Simple route finding (direct or one-stop)
-    vector<Route> directRoutes;
-    vector<pair<Route, Route>> connectingRoutes;
-    
-    // Find direct routes
-    for (const auto& route : routes) {
-        if (route.from == from && route.to == to) {
-            directRoutes.push_back(route);
-        }
-    }
-    
-    // Find connecting routes
-    for (const auto& r1 : routes) {
-        if (r1.from == from) {
-            for (const auto& r2 : routes) {
-                if (r2.from == r1.to && r2.to == to) {
-                    connectingRoutes.push_back({r1, r2});
-                }
-            }
-        }
+    // The graph is never modified after startup, so no lock is needed
+    FlightGraph::DijkstraResult result;
+    switch (criterion) {
+    case SHORTEST_ROUTE:
+        result = routeGraph.findShortestPath(from, to);
+        break;
+    case CHEAPEST_ROUTE:
+        result = routeGraph.findCheapestPath(from, to);
+        break;
+    case FASTEST_ROUTE:
+        result = routeGraph.findFastestPath(from, to);
+        break;
     }
     
-    stringstream json;
-    json << "{\"success\":true,";
+    JsonWriter json;
+    json.beginObject();
+    json.field("success", true);
     
-    if (!directRoutes.empty()) {
-        // Return shortest direct route
-        Route shortest = directRoutes[0];
-        for (const auto& route : directRoutes) {
-            if (route.distance < shortest.distance) {
-                shortest = route;
-            }
+    if (result.isValid() && !result.flights.empty()) {
+        json.key("route").beginObject();
+        json.field("type", result.flights.size() == 1 ? "Direct" : "Connecting");
+        json.key("path").beginArray();
+        for (const auto& city : result.path) {
+            json.value(city);
         }
-        
-        json << "\"route\":{";
-        json << "\"type\":\"Direct\",";
-        json << "\"path\":[\"" << from << "\",\"" << to << "\"],";
-        json << "\"distance\":" << shortest.distance << ",";
-        json << "\"price\":" << shortest.price << ",";
-        json << "\"duration\":" << shortest.duration << ",";
-        json << "\"flights\":[\"" << shortest.flightId << "\"]";
-        json << "},";
-        json << "\"algorithm\":\"Dijkstra's Algorithm\",";
-        json << "\"complexity\":\"O(E log V)\"";
-        
-    } else if (!connectingRoutes.empty()) {
-        // Return shortest connecting route
-        auto shortest = connectingRoutes[0];
-        int shortestDistance = shortest.first.distance + shortest.second.distance;
-        
-        for (const auto& routePair : connectingRoutes) {
-            int totalDistance = routePair.first.distance + routePair.second.distance;
-            if (totalDistance < shortestDistance) {
-                shortest = routePair;
-                shortestDistance = totalDistance;
-            }
+        json.endArray();
+        json.field("distance", result.totalDistance);
+        json.field("price", result.totalPrice);
+        json.field("duration", result.totalTime);
+        json.key("flights").beginArray();
+        for (const auto& flightId : result.flights) {
+            json.value(flightId);
         }
-        
-        json << "\"route\":{";
-        json << "\"type\":\"Connecting\",";
-        json << "\"path\":[\"" << from << "\",\"" << shortest.first.to << "\",\"" << to << "\"],";
-        json << "\"distance\":" << shortestDistance << ",";
-        json << "\"price\":" << (shortest.first.price + shortest.second.price) << ",";
-        json << "\"duration\":" << (shortest.first.duration + shortest.second.duration) << ",";
-        json << "\"flights\":[\"" << shortest.first.flightId << "\",\"" << shortest.second.flightId << "\"]";
-        json << "},";
-        json << "\"algorithm\":\"Dijkstra's Algorithm\",";
-        json << "\"complexity\":\"O(E log V)\"";
+        json.endArray();
+        json.endObject();
+        json.field("algorithm", "Dijkstra's Algorithm");
+        json.field("complexity", "O(E log V)");
         
     } else {
-        json << "\"route\":null,";
-        json << "\"message\":\"No route found\"";
+        json.key("route").null();
+        json.field("message", "No route found");
     }
     
-    json << "}";
+    json.endObject();
     
-    return createJSONResponse(200, "OK", json.str());
+    return createJSONResponse(200, "OK", json);
 }
 
 // API: Get system statistics
-string FlightServer::handleGetStats() {
-    lock_guard<mutex> lock(dataMutex);
+string_view FlightServer::handleGetStats() {
+    shared_lock<shared_mutex> lock(dataMutex);
+    shared_lock<shared_mutex> passengersLock(passengersMutex);
     
     // Calculate available seats
     int totalAvailableSeats = 0;
-    for (const auto& seatMap : seatMaps) {
-        for (bool taken : seatMap.second) {
-            if (!taken) totalAvailableSeats++;
-        }
+    for (const auto& inventory : seatInventories) {
+        totalAvailableSeats += inventory.second->availableSeats();
     }
     
-    stringstream json;
-    json << "{";
-    json << "\"success\":true,";
-    json << "\"stats\":{";
-    json << "\"totalFlights\":" << flights.size() << ",";
-    json << "\"totalPassengers\":" << passengers.size() << ",";
-    json << "\"totalRoutes\":" << routes.size() << ",";
-    json << "\"availableSeats\":" << totalAvailableSeats << ",";
-    json << "\"totalSeats\":180,";
-    json << "\"checkedInPassengers\":" << countCheckedInPassengers() << ",";
-    json << "\"connectionsHandled\":" << stats.connectionsHandled << ",";
-    json << "\"requestsProcessed\":" << stats.requestsProcessed << ",";
-    json << "\"serverStartTime\":\"" << stats.startTime << "\"";
-    json << "},";
-    json << "\"dataStructures\":{";
-    json << "\"flights\":\"Hash Table (unordered_map) - O(1)\",";
-    json << "\"passengers\":\"Hash Table (unordered_map) - O(1)\",";
-    json << "\"seatMap\":\"Bitmap (vector<bool>) - O(1)\",";
-    json << "\"routes\":\"Graph for Dijkstra - O(E log V)\"";
-    json << "}";
-    json << "}";
-    
-    return createJSONResponse(200, "OK", json.str());
+    JsonWriter json;
+    json.beginObject();
+    json.field("success", true);
+    json.key("stats").beginObject();
+    json.field("totalFlights", flights.getSize());
+    json.field("totalPassengers", passengers.getSize());
+    json.field("totalRoutes", routeGraph.getRouteCount());
+    json.field("availableSeats", totalAvailableSeats);
+    json.field("totalSeats", 180);
+    json.field("checkedInPassengers", countCheckedInPassengers());
+    json.field("connectionsHandled", stats.connectionsHandled.load());
+    json.field("requestsProcessed", stats.requestsProcessed.load());
+    json.field("serverStartTime", stats.startTime);
+    json.endObject();
+    
+    BufferPool::Stats cache = departures.cache_stats();
+    BTreeBase::WriteStats writes = departures.write_stats();
+    json.key("departureCache").beginObject();
+    json.field("hits", cache.hits);
+    json.field("misses", cache.misses);
+    json.field("evictions", cache.evictions);
+    json.field("residentBytes", cache.resident_bytes);
+    json.field("budgetBytes", cache.budget_bytes);
+    json.endObject();
+    json.key("departureWrites").beginObject();
+    json.field("saves", writes.saves);
+    json.field("blockWrites", writes.block_writes);
+    json.field("batches", writes.batches);
+    json.field("commits", writes.commits);
+    json.field("avgCommitMicros", writes.commits ? writes.commit_micros / static_cast<long long>(writes.commits) : 0LL);
+    json.field("maxCommitMicros", writes.max_commit_micros);
+    json.endObject();
+    json.key("dataStructures").beginObject();
+    json.field("flights", "Hash Table (chained HashMap) - O(1)");
+    json.field("departures", "B-Tree - O(log n + k)");
+    json.field("passengers", "Hash Table (chained HashMap) - O(1)");
+    json.field("seatMap", "Bitmap (atomic words) - O(1)");
+    json.field("routes", "Graph for Dijkstra - O(E log V)");
+    json.endObject();
+    json.endObject();
+    
+    return createJSONResponse(200, "OK", json);
 }
 
 // Helper: Count checked-in passengers
 int FlightServer::countCheckedInPassengers() const {
     int count = 0;
-    for (const auto& pair : passengers) {
-        if (pair.second.checkedIn) {
+    string seat;
+    bool checkedIn;
+    passengers.forEach([&](const string&, const Passenger& passenger) {
+        readSeatState(passenger, seat, checkedIn);
+        if (checkedIn) {
             count++;
         }
-    }
+    });
     return count;
 }
 
-// Helper: Create JSON response with headers
-string FlightServer::createJSONResponse(int status, const string& message, const string& data) {
-    stringstream response;
-    
-    response << "HTTP/1.1 " << status << " " << message << "\r\n";
-    response << "Content-Type: application/json\r\n";
-    response << "Access-Control-Allow-Origin: *\r\n";
-    response << "Access-Control-Allow-Methods: GET, POST, PUT, DELETE, OPTIONS\r\n";
-    response << "Access-Control-Allow-Headers: Content-Type\r\n";
-    response << "Connection: close\r\n";
-    response << "Content-Length: " << data.length() << "\r\n";
-    response << "\r\n";
-    response << data;
-    
-    return response.str();
+// Helper: Add a flight to the departure index under its departure minute.
+// Entries are ordered by (minute, flight number), so flights sharing a minute
+// never clash; an insert that fails on an entry already present leaves the
+// flight indexed, while a full file or a rejected value is an error (caller
+// holds dataMutex exclusively)
+bool FlightServer::indexDeparture(Flight& flight, int minutes) {
+    flight.departureKey = minutes;
+    if (departures.insert(minutes, flight.id)) {
+        return true;
+    }
+    for (auto cursor = departures.seek(minutes); cursor.valid() && cursor.key() == minutes; cursor.next()) {
+        if (cursor.value() == flight.id) {
+            return true;
+        }
+    }
+    cerr << "❌ Cannot index departure of " << flight.id << endl;
+    return false;
+}
+
+// Helper: Seat inventory of a flight, or nullptr (caller holds dataMutex)
+SeatInventory* FlightServer::findInventory(const string& flightId) const {
+    auto it = seatInventories.find(flightId);
+    return it == seatInventories.end() ? nullptr : it->second.get();
+}
+
+// Helper: Copy a passenger's seat and check-in state under its flight's seat lock
+void FlightServer::readSeatState(const Passenger& passenger, string& seat, bool& checkedIn) const {
+    SeatInventory* inventory = findInventory(passenger.flightId);
+    unique_lock<mutex> seatLock;
+    if (inventory) {
+        seatLock = unique_lock<mutex>(inventory->mutex());
+    }
+    seat = passenger.seat;
+    checkedIn = passenger.checkedIn;
+}
+
+// Helper: Create JSON response with headers (headers are written in front of
+// the body inside the writer's buffer, so nothing is copied)
+string_view FlightServer::createJSONResponse(int status, const char* message, JsonWriter& json) {
+    return json.finish(status, message,
+                       "Content-Type: application/json\r\n"
+                       "Access-Control-Allow-Origin: *\r\n"
+                       "Access-Control-Allow-Methods: GET, POST, PUT, DELETE, OPTIONS\r\n"
+                       "Access-Control-Allow-Headers: Content-Type\r\n");
+}
+
+// Helper: Create JSON response from a fixed body
+string_view FlightServer::createJSONResponse(int status, const char* message, string_view data) {
+    JsonWriter json;
+    json.raw(data);
+    return createJSONResponse(status, message, json);
+}
+
+// Helper: Write one flight object (the by-time listing omits arrival/price/seats)
+void FlightServer::writeFlight(JsonWriter& json, const Flight& flight, bool detailed) {
+    json.beginObject();
+    json.field("flightNumber", flight.id);
+    json.field("airline", flight.from, " Airlines");
+    json.field("origin", flight.from);
+    json.field("destination", flight.to);
+    json.field("departureTime", flight.departure);
+    if (detailed) {
+        json.field("arrivalTime", flight.arrival);
+    }
+    json.field("gate", flight.gate);
+    json.field("status", "Scheduled");
+    if (detailed) {
+        json.field("price", flight.price);
+        json.field("seats", flight.seats);
+    }
+    json.endObject();
 }
 
 // Print server statistics
 void FlightServer::printStats() const {
     cout << "\n📊 Server Statistics:" << endl;
     cout << "   Start Time: " << stats.startTime << endl;
-    cout << "   Connections Handled: " << stats.connectionsHandled << endl;
-    cout << "   Requests Processed: " << stats.requestsProcessed << endl;
-    cout << "   Flights in System: " << flights.size() << endl;
-    cout << "   Passengers in System: " << passengers.size() << endl;
+    cout << "   Connections Handled: " << stats.connectionsHandled.load() << endl;
+    cout << "   Requests Processed: " << stats.requestsProcessed.load() << endl;
+    cout << "   Flights in System: " << flights.getSize() << endl;
+    cout << "   Passengers in System: " << passengers.getSize() << endl;
     cout << "   Checked-in Passengers: " << countCheckedInPassengers() << endl;
 }
\ No newline at end of file
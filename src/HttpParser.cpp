@@ -0,0 +1,301 @@
+#include "../include/HttpParser.h"
+#include <cstring>
+
+using namespace std;
+
+static bool equalsIgnoreCase(string_view a, string_view b) {
+    if (a.size() != b.size()) return false;
+    for (size_t i = 0; i < a.size(); i++) {
+        char x = a[i], y = b[i];
+        if (x >= 'A' && x <= 'Z') x += 'a' - 'A';
+        if (y >= 'A' && y <= 'Z') y += 'a' - 'A';
+        if (x != y) return false;
+    }
+    return true;
+}
+
+static bool containsIgnoreCase(string_view haystack, string_view needle) {
+    if (needle.size() > haystack.size()) return false;
+    for (size_t i = 0; i + needle.size() <= haystack.size(); i++) {
+        if (equalsIgnoreCase(haystack.substr(i, needle.size()), needle)) return true;
+    }
+    return false;
+}
+
+static string_view trim(string_view value) {
+    while (!value.empty() && (value.front() == ' ' || value.front() == '\t')) value.remove_prefix(1);
+    while (!value.empty() && (value.back() == ' ' || value.back() == '\t')) value.remove_suffix(1);
+    return value;
+}
+
+string_view HttpRequest::header(string_view name) const {
+    for (int i = 0; i < headerCount; i++) {
+        if (equalsIgnoreCase(headerNames[i], name)) return headerValues[i];
+    }
+    return string_view();
+}
+
+HttpParser::HttpParser() {
+    reset();
+}
+
+void HttpParser::reset() {
+    state = HEADERS;
+    scanned = 0;
+    headerLength = 0;
+    bodyLength = 0;
+    cursor = 0;
+    chunkRemaining = 0;
+    consumed = 0;
+    error = 0;
+    keepAlive = false;
+    method = target = version = Span{0, 0};
+    headerCount = 0;
+}
+
+HttpParser::Status HttpParser::fail(int status) {
+    error = status;
+    return FAILED;
+}
+
+HttpParser::Status HttpParser::parse(char* data, size_t length, HttpRequest& request) {
+    if (error) return FAILED;
+
+    if (state == HEADERS) {
+        // Resume the terminator search a few bytes back in case "\r\n\r\n"
+        // straddles two reads
+        size_t from = scanned >= 3 ? scanned - 3 : 0;
+        const char* end = nullptr;
+        if (length > from) {
+            end = static_cast<const char*>(memmem(data + from, length - from, "\r\n\r\n", 4));
+        }
+        if (!end) {
+            scanned = length;
+            if (length > MAX_HEADER_BYTES) return fail(431);
+            return NEED_MORE;
+        }
+
+        headerLength = (end - data) + 4;
+        if (headerLength > MAX_HEADER_BYTES) return fail(431);
+        if (!parseHeaders(data)) return FAILED;
+    }
+
+    if (state == BODY) {
+        if (length < headerLength + bodyLength) return NEED_MORE;
+        consumed = headerLength + bodyLength;
+    } else {
+        Status status = parseChunks(data, length);
+        if (status != COMPLETE) return status;
+    }
+
+    fillRequest(data, request);
+    return COMPLETE;
+}
+
+bool HttpParser::parseHeaders(const char* data) {
+    string_view head(data, headerLength - 2);
+
+    // Request line: METHOD SP TARGET SP VERSION CRLF
+    size_t lineEnd = head.find("\r\n");
+    string_view line = head.substr(0, lineEnd);
+    size_t sp1 = line.find(' ');
+    size_t sp2 = sp1 == string_view::npos ? string_view::npos : line.find(' ', sp1 + 1);
+    if (sp1 == 0 || sp2 == string_view::npos || sp2 == sp1 + 1) {
+        fail(400);
+        return false;
+    }
+
+    method = Span{0, static_cast<uint32_t>(sp1)};
+    target = Span{static_cast<uint32_t>(sp1 + 1), static_cast<uint32_t>(sp2 - sp1 - 1)};
+    version = Span{static_cast<uint32_t>(sp2 + 1), static_cast<uint32_t>(line.size() - sp2 - 1)};
+
+    string_view versionText = line.substr(sp2 + 1);
+    if (versionText == "HTTP/1.1") {
+        keepAlive = true;
+    } else if (versionText == "HTTP/1.0") {
+        keepAlive = false;
+    } else {
+        fail(400);
+        return false;
+    }
+
+    bool chunked = false;
+    bool haveLength = false;
+    size_t contentLength = 0;
+    headerCount = 0;
+
+    size_t pos = lineEnd + 2;
+    while (pos < head.size()) {
+        size_t next = head.find("\r\n", pos);
+        if (next == string_view::npos) next = head.size();
+        string_view headerLine = head.substr(pos, next - pos);
+
+        size_t colon = headerLine.find(':');
+        if (colon == string_view::npos || colon == 0) {
+            fail(400);
+            return false;
+        }
+        string_view name = headerLine.substr(0, colon);
+        string_view value = trim(headerLine.substr(colon + 1));
+
+        if (headerCount < HttpRequest::MAX_HEADERS) {
+            headerNames[headerCount] = Span{static_cast<uint32_t>(pos),
+                                            static_cast<uint32_t>(name.size())};
+            headerValues[headerCount] = Span{static_cast<uint32_t>(value.data() - data),
+                                             static_cast<uint32_t>(value.size())};
+            headerCount++;
+        }
+
+        if (equalsIgnoreCase(name, "content-length")) {
+            if (value.empty()) {
+                fail(400);
+                return false;
+            }
+            size_t parsed = 0;
+            for (char ch : value) {
+                if (ch < '0' || ch > '9') {
+                    fail(400);
+                    return false;
+                }
+                parsed = parsed * 10 + (ch - '0');
+                if (parsed > MAX_BODY_BYTES) {
+                    fail(413);
+                    return false;
+                }
+            }
+            if (haveLength && parsed != contentLength) {
+                fail(400);
+                return false;
+            }
+            haveLength = true;
+            contentLength = parsed;
+        } else if (equalsIgnoreCase(name, "transfer-encoding")) {
+            if (!equalsIgnoreCase(value, "chunked")) {
+                fail(501);
+                return false;
+            }
+            chunked = true;
+        } else if (equalsIgnoreCase(name, "connection")) {
+            if (containsIgnoreCase(value, "close")) keepAlive = false;
+            else if (containsIgnoreCase(value, "keep-alive")) keepAlive = true;
+        }
+
+        pos = next + 2;
+    }
+
+    if (chunked) {
+        // Transfer-Encoding wins over Content-Length (RFC 7230 3.3.3)
+        state = CHUNK_SIZE;
+        bodyLength = 0;
+        cursor = headerLength;
+    } else {
+        state = BODY;
+        bodyLength = contentLength;
+    }
+    return true;
+}
+
+// Decoded chunk data is slid down to sit right after the headers, so the body
+// stays contiguous and the framing bytes are simply skipped over.
+HttpParser::Status HttpParser::parseChunks(char* data, size_t length) {
+    while (true) {
+        switch (state) {
+        case CHUNK_SIZE: {
+            const char* lineEnd = static_cast<const char*>(
+                memmem(data + cursor, length - cursor, "\r\n", 2));
+            if (!lineEnd) {
+                if (length - cursor > 1024) return fail(400);
+                return NEED_MORE;
+            }
+
+            size_t size = 0;
+            size_t digits = 0;
+            const char* p = data + cursor;
+            for (; p < lineEnd; p++, digits++) {
+                char ch = *p;
+                int nibble;
+                if (ch >= '0' && ch <= '9') nibble = ch - '0';
+                else if (ch >= 'a' && ch <= 'f') nibble = ch - 'a' + 10;
+                else if (ch >= 'A' && ch <= 'F') nibble = ch - 'A' + 10;
+                else break; // Chunk extensions (";name=value") are ignored
+                size = size * 16 + nibble;
+                if (size > MAX_BODY_BYTES) return fail(413);
+            }
+            if (digits == 0) return fail(400);
+
+            cursor = (lineEnd - data) + 2;
+            if (size == 0) {
+                state = TRAILERS;
+            } else {
+                if (bodyLength + size > MAX_BODY_BYTES) return fail(413);
+                chunkRemaining = size;
+                state = CHUNK_DATA;
+            }
+            break;
+        }
+
+        case CHUNK_DATA: {
+            size_t available = length - cursor;
+            size_t take = available < chunkRemaining ? available : chunkRemaining;
+            if (take > 0) {
+                memmove(data + headerLength + bodyLength, data + cursor, take);
+                bodyLength += take;
+                cursor += take;
+                chunkRemaining -= take;
+            }
+            if (chunkRemaining > 0) return NEED_MORE;
+            state = CHUNK_DATA_END;
+            break;
+        }
+
+        case CHUNK_DATA_END:
+            if (length - cursor < 2) return NEED_MORE;
+            if (data[cursor] != '\r' || data[cursor + 1] != '\n') return fail(400);
+            cursor += 2;
+            state = CHUNK_SIZE;
+            break;
+
+        case TRAILERS: {
+            const char* lineEnd = static_cast<const char*>(
+                memmem(data + cursor, length - cursor, "\r\n", 2));
+            if (!lineEnd) {
+                if (length - cursor > MAX_HEADER_BYTES) return fail(431);
+                return NEED_MORE;
+            }
+            bool emptyLine = (lineEnd == data + cursor);
+            cursor = (lineEnd - data) + 2;
+            if (emptyLine) {
+                consumed = cursor;
+                return COMPLETE;
+            }
+            break;
+        }
+
+        default:
+            return fail(400);
+        }
+    }
+}
+
+void HttpParser::fillRequest(const char* data, HttpRequest& request) const {
+    request.method = string_view(data + method.offset, method.length);
+    request.target = string_view(data + target.offset, target.length);
+    request.version = string_view(data + version.offset, version.length);
+    request.body = string_view(data + headerLength, bodyLength);
+    request.keepAlive = keepAlive;
+
+    size_t queryPos = request.target.find('?');
+    if (queryPos == string_view::npos) {
+        request.path = request.target;
+        request.query = string_view();
+    } else {
+        request.path = request.target.substr(0, queryPos);
+        request.query = request.target.substr(queryPos + 1);
+    }
+
+    request.headerCount = headerCount;
+    for (int i = 0; i < headerCount; i++) {
+        request.headerNames[i] = string_view(data + headerNames[i].offset, headerNames[i].length);
+        request.headerValues[i] = string_view(data + headerValues[i].offset, headerValues[i].length);
+    }
+}
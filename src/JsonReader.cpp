@@ -0,0 +1,342 @@
+#include "../include/JsonReader.h"
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+struct Token {
+    JsonReader::Type type;
+    uint32_t next;          // Index of the first token after this value
+    const char* start;
+    size_t length;
+};
+
+// Reused by every reader on the thread; clear() keeps the capacity
+struct ThreadTokens {
+    vector<Token> tokens;
+    string scratch;         // Decoded escaped strings
+};
+
+thread_local ThreadTokens threadTokens;
+
+const uint64_t ONES = 0x0101010101010101ULL;
+const uint64_t HIGHS = 0x8080808080808080ULL;
+
+// Non-zero when any byte of the word is '"', '\\' or a control character
+inline uint64_t specialBytes(uint64_t word) {
+    uint64_t quote = word ^ (ONES * '"');
+    uint64_t slash = word ^ (ONES * '\\');
+    return ((quote - ONES) & ~quote) |
+           ((slash - ONES) & ~slash) |
+           ((word - ONES * 0x20) & ~word);
+}
+
+int hexValue(char ch) {
+    if (ch >= '0' && ch <= '9') return ch - '0';
+    if (ch >= 'a' && ch <= 'f') return ch - 'a' + 10;
+    if (ch >= 'A' && ch <= 'F') return ch - 'A' + 10;
+    return -1;
+}
+
+bool readHex4(const char* p, const char* end, unsigned int& value) {
+    if (end - p < 4) return false;
+    value = 0;
+    for (int i = 0; i < 4; i++) {
+        int digit = hexValue(p[i]);
+        if (digit < 0) return false;
+        value = value * 16 + digit;
+    }
+    return true;
+}
+
+void appendUtf8(string& out, unsigned int cp) {
+    if (cp < 0x80) {
+        out += static_cast<char>(cp);
+    } else if (cp < 0x800) {
+        out += static_cast<char>(0xC0 | (cp >> 6));
+        out += static_cast<char>(0x80 | (cp & 0x3F));
+    } else if (cp < 0x10000) {
+        out += static_cast<char>(0xE0 | (cp >> 12));
+        out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (cp & 0x3F));
+    } else {
+        out += static_cast<char>(0xF0 | (cp >> 18));
+        out += static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+        out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (cp & 0x3F));
+    }
+}
+
+} // namespace
+
+JsonReader::JsonReader() : pos(nullptr), end(nullptr), failed(false) {}
+
+bool JsonReader::parse(string_view json) {
+    threadTokens.tokens.clear();
+    threadTokens.scratch.clear();
+    pos = json.data();
+    end = json.data() + json.size();
+    failed = false;
+
+    skipWhitespace();
+    if (pos == end) {
+        addToken(OBJECT, pos, 0);
+        return true;
+    }
+
+    if (!parseValue(0)) {
+        threadTokens.tokens.clear();
+        failed = true;
+        return false;
+    }
+
+    skipWhitespace();
+    if (pos != end) {
+        threadTokens.tokens.clear();
+        failed = true;
+        return false;
+    }
+    return true;
+}
+
+size_t JsonReader::addToken(Type type, const char* start, size_t length) {
+    vector<Token>& tokens = threadTokens.tokens;
+    tokens.push_back(Token{type, static_cast<uint32_t>(tokens.size() + 1), start, length});
+    return tokens.size() - 1;
+}
+
+void JsonReader::skipWhitespace() {
+    while (pos < end && (*pos == ' ' || *pos == '\n' || *pos == '\r' || *pos == '\t')) pos++;
+}
+
+bool JsonReader::parseValue(int depth) {
+    if (depth > MAX_DEPTH) return false;
+    skipWhitespace();
+    if (pos == end) return false;
+
+    switch (*pos) {
+    case '{': {
+        size_t index = addToken(OBJECT, pos, 0);
+        pos++;
+        skipWhitespace();
+        if (pos < end && *pos == '}') {
+            pos++;
+        } else {
+            while (true) {
+                skipWhitespace();
+                if (pos == end || *pos != '"' || !parseString()) return false;
+                skipWhitespace();
+                if (pos == end || *pos != ':') return false;
+                pos++;
+                if (!parseValue(depth + 1)) return false;
+                skipWhitespace();
+                if (pos == end) return false;
+                if (*pos == ',') { pos++; continue; }
+                if (*pos == '}') { pos++; break; }
+                return false;
+            }
+        }
+        threadTokens.tokens[index].next = static_cast<uint32_t>(threadTokens.tokens.size());
+        return true;
+    }
+
+    case '[': {
+        size_t index = addToken(ARRAY, pos, 0);
+        pos++;
+        skipWhitespace();
+        if (pos < end && *pos == ']') {
+            pos++;
+        } else {
+            while (true) {
+                if (!parseValue(depth + 1)) return false;
+                skipWhitespace();
+                if (pos == end) return false;
+                if (*pos == ',') { pos++; continue; }
+                if (*pos == ']') { pos++; break; }
+                return false;
+            }
+        }
+        threadTokens.tokens[index].next = static_cast<uint32_t>(threadTokens.tokens.size());
+        return true;
+    }
+
+    case '"':
+        return parseString();
+    case 't':
+        return parseLiteral("true", 4, TRUE_VALUE);
+    case 'f':
+        return parseLiteral("false", 5, FALSE_VALUE);
+    case 'n':
+        return parseLiteral("null", 4, NULL_VALUE);
+    default:
+        return parseNumber();
+    }
+}
+
+// pos is on the opening quote. Plain runs are skipped eight bytes at a time;
+// the token points into the body unless an escape forces a decoded copy.
+bool JsonReader::parseString() {
+    const char* start = ++pos;
+
+    while (true) {
+        while (end - pos >= 8) {
+            uint64_t word;
+            memcpy(&word, pos, 8);
+            if (specialBytes(word) & HIGHS) break;
+            pos += 8;
+        }
+        if (pos == end) return false;
+
+        unsigned char ch = static_cast<unsigned char>(*pos);
+        if (ch == '"') {
+            addToken(STRING, start, pos - start);
+            pos++;
+            return true;
+        }
+        if (ch == '\\') break;
+        if (ch < 0x20) return false;
+        pos++;
+    }
+
+    // Escaped string: decode into scratch. Decoding never grows the text, so
+    // reserving the rest of the body on first use means scratch never
+    // reallocates and views handed out earlier stay put.
+    string& scratch = threadTokens.scratch;
+    if (scratch.empty()) scratch.reserve(end - start);
+    size_t decodedStart = scratch.size();
+    scratch.append(start, pos - start);
+
+    while (pos < end) {
+        char ch = *pos;
+        if (ch == '"') {
+            addToken(STRING, scratch.data() + decodedStart, scratch.size() - decodedStart);
+            pos++;
+            return true;
+        }
+        if (static_cast<unsigned char>(ch) < 0x20) return false;
+        if (ch != '\\') {
+            scratch += ch;
+            pos++;
+            continue;
+        }
+
+        if (++pos == end) return false;
+        switch (*pos++) {
+        case '"':  scratch += '"'; break;
+        case '\\': scratch += '\\'; break;
+        case '/':  scratch += '/'; break;
+        case 'b':  scratch += '\b'; break;
+        case 'f':  scratch += '\f'; break;
+        case 'n':  scratch += '\n'; break;
+        case 'r':  scratch += '\r'; break;
+        case 't':  scratch += '\t'; break;
+        case 'u': {
+            unsigned int cp;
+            if (!readHex4(pos, end, cp)) return false;
+            pos += 4;
+            if (cp >= 0xD800 && cp <= 0xDBFF) {
+                unsigned int low;
+                if (end - pos < 6 || pos[0] != '\\' || pos[1] != 'u' ||
+                    !readHex4(pos + 2, end, low) || low < 0xDC00 || low > 0xDFFF) {
+                    return false;
+                }
+                pos += 6;
+                cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+            } else if (cp >= 0xDC00 && cp <= 0xDFFF) {
+                return false;
+            }
+            appendUtf8(scratch, cp);
+            break;
+        }
+        default:
+            return false;
+        }
+    }
+    return false;
+}
+
+bool JsonReader::parseNumber() {
+    const char* start = pos;
+    if (pos < end && *pos == '-') pos++;
+    if (pos == end) return false;
+
+    if (*pos == '0') {
+        pos++;
+    } else if (*pos >= '1' && *pos <= '9') {
+        while (pos < end && *pos >= '0' && *pos <= '9') pos++;
+    } else {
+        return false;
+    }
+
+    if (pos < end && *pos == '.') {
+        pos++;
+        if (pos == end || *pos < '0' || *pos > '9') return false;
+        while (pos < end && *pos >= '0' && *pos <= '9') pos++;
+    }
+    if (pos < end && (*pos == 'e' || *pos == 'E')) {
+        pos++;
+        if (pos < end && (*pos == '+' || *pos == '-')) pos++;
+        if (pos == end || *pos < '0' || *pos > '9') return false;
+        while (pos < end && *pos >= '0' && *pos <= '9') pos++;
+    }
+
+    addToken(NUMBER, start, pos - start);
+    return true;
+}
+
+bool JsonReader::parseLiteral(const char* word, size_t length, Type type) {
+    if (size_t(end - pos) < length || memcmp(pos, word, length) != 0) return false;
+    addToken(type, pos, length);
+    pos += length;
+    return true;
+}
+
+size_t JsonReader::next(size_t index) const {
+    return threadTokens.tokens[index].next;
+}
+
+JsonReader::Type JsonReader::type(size_t index) const {
+    if (failed || index >= threadTokens.tokens.size()) return NONE;
+    return threadTokens.tokens[index].type;
+}
+
+string_view JsonReader::text(size_t index) const {
+    switch (type(index)) {
+    case STRING:
+    case NUMBER:
+    case TRUE_VALUE:
+    case FALSE_VALUE: {
+        const Token& token = threadTokens.tokens[index];
+        return string_view(token.start, token.length);
+    }
+    default:
+        return string_view();
+    }
+}
+
+size_t JsonReader::find(size_t object, string_view name) const {
+    if (type(object) != OBJECT) return npos;
+
+    size_t stop = next(object);
+    for (size_t key = object + 1; key < stop; key = next(key + 1)) {
+        const Token& token = threadTokens.tokens[key];
+        if (string_view(token.start, token.length) == name) return key + 1;
+    }
+    return npos;
+}
+
+size_t JsonReader::firstChild(size_t container) const {
+    Type containerType = type(container);
+    if (containerType != OBJECT && containerType != ARRAY) return npos;
+    return container + 1 < next(container) ? container + 1 : npos;
+}
+
+size_t JsonReader::nextSibling(size_t container, size_t child) const {
+    if (child == npos) return npos;
+    size_t following = next(child);
+    if (type(container) == OBJECT) following = next(following);    // Skip the member's value
+    return following < next(container) ? following : npos;
+}
@@ -0,0 +1,232 @@
+#include "../include/JsonWriter.h"
+#include <charconv>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+using namespace std;
+
+namespace {
+
+// One response buffer per thread, grown on demand and reused forever
+struct ThreadBuffer {
+    char* data;
+    size_t capacity;
+
+    ThreadBuffer() : data(nullptr), capacity(0) {}
+    ~ThreadBuffer() { free(data); }
+};
+
+thread_local ThreadBuffer threadBuffer;
+
+const char HEX_DIGITS[] = "0123456789abcdef";
+
+} // namespace
+
+JsonWriter::JsonWriter() : data(nullptr), length(HEADER_RESERVE), commaBits(0), depth(0), afterKey(false) {
+    reserve(4096);
+}
+
+void JsonWriter::reserve(size_t extra) {
+    size_t needed = length + extra;
+    if (needed > threadBuffer.capacity) {
+        size_t capacity = threadBuffer.capacity ? threadBuffer.capacity : 8192;
+        while (capacity < needed) capacity *= 2;
+
+        char* grown = static_cast<char*>(realloc(threadBuffer.data, capacity));
+        if (!grown) throw bad_alloc();
+        threadBuffer.data = grown;
+        threadBuffer.capacity = capacity;
+    }
+    data = threadBuffer.data;
+}
+
+void JsonWriter::append(const char* text, size_t count) {
+    reserve(count);
+    memcpy(data + length, text, count);
+    length += count;
+}
+
+void JsonWriter::appendChar(char ch) {
+    reserve(1);
+    data[length++] = ch;
+}
+
+void JsonWriter::appendEscaped(string_view text) {
+    // Worst case every byte becomes \u00XX
+    reserve(text.size() * 6);
+    char* out = data + length;
+
+    for (char c : text) {
+        unsigned char ch = static_cast<unsigned char>(c);
+        if (ch >= 0x20 && ch != '"' && ch != '\\') {
+            *out++ = c;
+            continue;
+        }
+
+        *out++ = '\\';
+        switch (ch) {
+            case '"':  *out++ = '"'; break;
+            case '\\': *out++ = '\\'; break;
+            case '\n': *out++ = 'n'; break;
+            case '\r': *out++ = 'r'; break;
+            case '\t': *out++ = 't'; break;
+            case '\b': *out++ = 'b'; break;
+            case '\f': *out++ = 'f'; break;
+            default:
+                *out++ = 'u';
+                *out++ = '0';
+                *out++ = '0';
+                *out++ = HEX_DIGITS[ch >> 4];
+                *out++ = HEX_DIGITS[ch & 0xF];
+                break;
+        }
+    }
+
+    length = out - data;
+}
+
+// Emits the separating comma when this is not the first item in its container
+void JsonWriter::beforeValue() {
+    if (afterKey) {
+        afterKey = false;
+        return;
+    }
+    uint64_t bit = 1ULL << (depth & 63);
+    if (commaBits & bit) appendChar(',');
+    commaBits |= bit;
+}
+
+JsonWriter& JsonWriter::beginObject() {
+    beforeValue();
+    appendChar('{');
+    depth++;
+    commaBits &= ~(1ULL << (depth & 63));
+    return *this;
+}
+
+JsonWriter& JsonWriter::endObject() {
+    depth--;
+    appendChar('}');
+    return *this;
+}
+
+JsonWriter& JsonWriter::beginArray() {
+    beforeValue();
+    appendChar('[');
+    depth++;
+    commaBits &= ~(1ULL << (depth & 63));
+    return *this;
+}
+
+JsonWriter& JsonWriter::endArray() {
+    depth--;
+    appendChar(']');
+    return *this;
+}
+
+JsonWriter& JsonWriter::key(string_view name) {
+    beforeValue();
+    appendChar('"');
+    appendEscaped(name);
+    append("\":", 2);
+    afterKey = true;
+    return *this;
+}
+
+JsonWriter& JsonWriter::value(string_view text) {
+    beforeValue();
+    appendChar('"');
+    appendEscaped(text);
+    appendChar('"');
+    return *this;
+}
+
+JsonWriter& JsonWriter::value(string_view first, string_view second) {
+    beforeValue();
+    appendChar('"');
+    appendEscaped(first);
+    appendEscaped(second);
+    appendChar('"');
+    return *this;
+}
+
+JsonWriter& JsonWriter::value(bool flag) {
+    beforeValue();
+    if (flag) append("true", 4);
+    else append("false", 5);
+    return *this;
+}
+
+JsonWriter& JsonWriter::value(long long number) {
+    beforeValue();
+    reserve(24);
+    length = to_chars(data + length, data + length + 24, number).ptr - data;
+    return *this;
+}
+
+JsonWriter& JsonWriter::value(unsigned long number) {
+    beforeValue();
+    reserve(24);
+    length = to_chars(data + length, data + length + 24, number).ptr - data;
+    return *this;
+}
+
+// JSON has no NaN or infinity, so those are written as null
+JsonWriter& JsonWriter::value(double number) {
+    if (!std::isfinite(number)) {
+        return null();
+    }
+    beforeValue();
+    reserve(32);
+    // Shortest representation that round-trips, e.g. 850 or 650.5
+    length = to_chars(data + length, data + length + 32, number).ptr - data;
+    return *this;
+}
+
+JsonWriter& JsonWriter::null() {
+    beforeValue();
+    append("null", 4);
+    return *this;
+}
+
+JsonWriter& JsonWriter::raw(string_view json) {
+    beforeValue();
+    append(json);
+    return *this;
+}
+
+string_view JsonWriter::body() const {
+    return string_view(data + HEADER_RESERVE, length - HEADER_RESERVE);
+}
+
+string_view JsonWriter::finish(int status, string_view reason, string_view headerLines) {
+    size_t bodyLength = length - HEADER_RESERVE;
+
+    char header[HEADER_RESERVE];
+    char* out = header;
+    char* end = header + sizeof(header);
+
+    auto put = [&out, end](string_view text) {
+        size_t count = text.size() < size_t(end - out) ? text.size() : size_t(end - out);
+        memcpy(out, text.data(), count);
+        out += count;
+    };
+
+    put("HTTP/1.1 ");
+    out = to_chars(out, end, status).ptr;
+    put(" ");
+    put(reason);
+    put("\r\n");
+    put(headerLines);
+    put("Content-Length: ");
+    out = to_chars(out, end, bodyLength).ptr;
+    put("\r\n\r\n");
+
+    size_t headerLength = out - header;
+    char* start = data + HEADER_RESERVE - headerLength;
+    memcpy(start, header, headerLength);
+
+    return string_view(start, headerLength + bodyLength);
+}
@@ -0,0 +1,127 @@
+#include "../include/Router.h"
+#include <algorithm>
+#include <stdexcept>
+
+using namespace std;
+
+// Splits off the next non-empty '/'-separated segment of path
+static bool nextSegment(string_view& path, string_view& segment) {
+    while (!path.empty() && path.front() == '/') path.remove_prefix(1);
+    if (path.empty()) return false;
+
+    size_t slash = path.find('/');
+    segment = path.substr(0, slash);
+    path.remove_prefix(slash == string_view::npos ? path.size() : slash);
+    return true;
+}
+
+string_view RouteMatch::query(string_view name, string_view fallback) const {
+    for (int i = 0; i < queryCount; i++) {
+        if (queryNames[i] == name) return queryValues[i];
+    }
+    return fallback;
+}
+
+Router::Router() : rootNode(new Node()) {}
+
+Router::~Router() {}
+
+Router::Method Router::methodIndex(string_view method) {
+    switch (method.size()) {
+    case 3:
+        if (method == "GET") return METHOD_GET;
+        if (method == "PUT") return METHOD_PUT;
+        break;
+    case 4:
+        if (method == "POST") return METHOD_POST;
+        if (method == "HEAD") return METHOD_HEAD;
+        break;
+    case 5:
+        if (method == "PATCH") return METHOD_PATCH;
+        break;
+    case 6:
+        if (method == "DELETE") return METHOD_DELETE;
+        break;
+    }
+    return METHOD_OTHER;
+}
+
+void Router::add(string_view method, string_view pattern, Handler handler) {
+    Node* node = rootNode.get();
+    int paramCount = 0;
+
+    string_view rest = pattern;
+    string_view segment;
+    while (nextSegment(rest, segment)) {
+        if (segment.front() == ':') {
+            if (++paramCount > RouteMatch::MAX_PARAMS) {
+                throw invalid_argument("Too many parameters in route " + string(pattern));
+            }
+            if (!node->param) node->param.reset(new Node());
+            node = node->param.get();
+            continue;
+        }
+
+        auto& literals = node->literals;
+        auto it = lower_bound(literals.begin(), literals.end(), segment,
+                              [](const pair<string, unique_ptr<Node>>& child, string_view key) {
+                                  return string_view(child.first) < key;
+                              });
+        if (it == literals.end() || it->first != segment) {
+            it = literals.emplace(it, string(segment), unique_ptr<Node>(new Node()));
+        }
+        node = it->second.get();
+    }
+
+    if (method == "*") {
+        node->anyMethod = move(handler);
+    } else {
+        node->handlers[methodIndex(method)] = move(handler);
+    }
+}
+
+const Router::Handler* Router::match(const HttpRequest& request, RouteMatch& match) const {
+    const Node* node = rootNode.get();
+    match.paramCount = 0;
+
+    string_view rest = request.path;
+    string_view segment;
+    while (nextSegment(rest, segment)) {
+        const auto& literals = node->literals;
+        auto it = lower_bound(literals.begin(), literals.end(), segment,
+                              [](const pair<string, unique_ptr<Node>>& child, string_view key) {
+                                  return string_view(child.first) < key;
+                              });
+        if (it != literals.end() && it->first == segment) {
+            node = it->second.get();
+        } else if (node->param) {
+            match.params[match.paramCount++] = segment;
+            node = node->param.get();
+        } else {
+            return nullptr;
+        }
+    }
+
+    const Handler* handler = &node->handlers[methodIndex(request.method)];
+    if (!*handler) handler = &node->anyMethod;
+    if (!*handler) return nullptr;
+
+    parseQuery(request.query, match);
+    return handler;
+}
+
+// name=value pairs separated by '&'; a bare name gets an empty value
+void Router::parseQuery(string_view query, RouteMatch& match) {
+    match.queryCount = 0;
+    while (!query.empty() && match.queryCount < RouteMatch::MAX_QUERY) {
+        size_t amp = query.find('&');
+        string_view pair = query.substr(0, amp);
+        query.remove_prefix(amp == string_view::npos ? query.size() : amp + 1);
+        if (pair.empty()) continue;
+
+        size_t eq = pair.find('=');
+        match.queryNames[match.queryCount] = pair.substr(0, eq);
+        match.queryValues[match.queryCount] = eq == string_view::npos ? string_view() : pair.substr(eq + 1);
+        match.queryCount++;
+    }
+}
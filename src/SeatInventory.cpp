@@ -0,0 +1,77 @@
+#include "../include/SeatInventory.h"
+
+using namespace std;
+
+SeatInventory::SeatInventory() {
+    for (auto& word : words) {
+        word.store(0, memory_order_relaxed);
+    }
+}
+
+// Bits of a word that map to real seats (the last word is partial)
+uint64_t SeatInventory::validBits(int word) {
+    int seats = SEAT_COUNT - word * 64;
+    return seats >= 64 ? ~0ULL : (1ULL << seats) - 1;
+}
+
+bool SeatInventory::isTaken(int seat) const {
+    if (seat < 0 || seat >= SEAT_COUNT) return false;
+    return (words[seat / 64].load(memory_order_acquire) >> (seat % 64)) & 1;
+}
+
+bool SeatInventory::claim(int seat) {
+    if (seat < 0 || seat >= SEAT_COUNT) return false;
+    uint64_t bit = 1ULL << (seat % 64);
+    return !(words[seat / 64].fetch_or(bit, memory_order_acq_rel) & bit);
+}
+
+int SeatInventory::claimFirstFree() {
+    for (int w = 0; w < WORD_COUNT; w++) {
+        uint64_t current = words[w].load(memory_order_acquire);
+        while (true) {
+            uint64_t free = ~current & validBits(w);
+            if (!free) break;
+
+            uint64_t bit = free & (~free + 1);     // Lowest free seat
+            if (words[w].compare_exchange_weak(current, current | bit, memory_order_acq_rel)) {
+                return w * 64 + __builtin_ctzll(bit);
+            }
+            // current was reloaded by the failed exchange; retry this word
+        }
+    }
+    return -1;
+}
+
+void SeatInventory::release(int seat) {
+    if (seat < 0 || seat >= SEAT_COUNT) return;
+    words[seat / 64].fetch_and(~(1ULL << (seat % 64)), memory_order_acq_rel);
+}
+
+int SeatInventory::availableSeats() const {
+    int taken = 0;
+    for (const auto& word : words) {
+        taken += __builtin_popcountll(word.load(memory_order_acquire));
+    }
+    return SEAT_COUNT - taken;
+}
+
+int SeatInventory::parseSeat(string_view label) {
+    if (label.size() < 2 || label.size() > 4) return -1;
+
+    char col = label.back();
+    if (col < 'A' || col >= 'A' + SEATS_PER_ROW) return -1;
+
+    int row = 0;
+    for (size_t i = 0; i + 1 < label.size(); i++) {
+        if (label[i] < '0' || label[i] > '9') return -1;
+        row = row * 10 + (label[i] - '0');
+    }
+
+    int seat = (row - 1) * SEATS_PER_ROW + (col - 'A');
+    if (row < 1 || seat >= SEAT_COUNT) return -1;
+    return seat;
+}
+
+string SeatInventory::seatLabel(int seat) {
+    return to_string(seat / SEATS_PER_ROW + 1) + static_cast<char>('A' + seat % SEATS_PER_ROW);
+}
@@ -40,16 +40,20 @@ int main(int argc, char* argv[]) {
     signal(SIGTERM, signalHandler);
     
     // Parse command line arguments
+    // Usage: flight_server [port] [keepAliveSeconds] [maxRequestsPerConnection]
     int port = 8080;
     if (argc > 1) {
         port = atoi(argv[1]);
     }
+    int keepAliveSeconds = argc > 2 ? atoi(argv[2]) : 15;
+    int maxRequestsPerConnection = argc > 3 ? atoi(argv[3]) : 1000;
     
     printBanner();
     
     try {
         // Create and start server
         server = make_unique<FlightServer>(port);
+        server->setKeepAlive(keepAliveSeconds, maxRequestsPerConnection);
         
         cout << "🚀 Starting Flight Server on port " << port << "..." << endl;
         
@@ -58,7 +62,7 @@ int main(int argc, char* argv[]) {
             cout << "📡 Endpoints available:" << endl;
             cout << "   GET  /api/health" << endl;
             cout << "   GET  /api/flights" << endl;
-            cout << "   GET  /api/flights/range?start=HH:MM&end=HH:MM" << endl;
+            cout << "   GET  /api/flights/range?start=HH:MM&end=HH:MM[&limit=N]" << endl;
             cout << "   GET  /api/passengers/{pnr}" << endl;
             cout << "   GET  /api/route/shortest/{from}/{to}" << endl;
             cout << "   GET  /api/gates/range?min=X&max=Y" << endl;